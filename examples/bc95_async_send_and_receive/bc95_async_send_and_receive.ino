@@ -0,0 +1,73 @@
+#include "Arduino.h"
+
+#include <NBIoT_BC95.h>
+
+#define BC95_BAUDRATE               (9600)
+#define PIN_ENABLE                  (1)
+
+#define BUFFER_SIZE                 (128)
+#define SEND_PERIOD                 (10000)
+
+// debug serial
+extern HardwareSerial Serial;
+// module communication serial
+extern HardwareSerial Serial1;
+
+NBIoT_BC95 bc95(&Serial1, &Serial);
+
+char dest_ip[15]  = "127.0.0.1";
+uint16_t dest_port = 12321;
+
+uint8_t send_buffer[BUFFER_SIZE];
+uint8_t send_buffer_size = 0;
+
+uint8_t receive_buffer[BC95_MAX_PACKET_SIZE];
+uint16_t receive_buffer_size = 0;
+
+uint16_t pending_bytes  = 0;
+uint32_t last_send      = 0;
+
+void bc95_op_done(bc95_op_type_t op, bc95_op_status_t status, uint16_t result, void *ctx);
+
+void setup() {
+    Serial.begin(BC95_BAUDRATE);
+
+    pinMode(PIN_ENABLE, OUTPUT);
+    digitalWrite(PIN_ENABLE, HIGH);
+
+    bc95.initialize();
+    bc95.config_psm();
+
+    // check if the module is functional
+    if (bc95.is_assigned_ip()) {
+        // open socket with random port number and receive incoming messages
+        bc95.open_socket();
+    }
+
+    bc95.set_op_callback(bc95_op_done);
+}
+
+void loop() {
+    // never blocks, parses whatever the modem has sent so far
+    bc95.poll();
+
+    if (bc95.get_op_status() != BC95_OP_PENDING && millis() - last_send > SEND_PERIOD) {
+        last_send = millis();
+        bc95.begin_send_UDP_datagram(dest_ip, dest_port, send_buffer, send_buffer_size, &pending_bytes);
+    }
+
+    // sample sensors, service other peripherals, etc.
+}
+
+void bc95_op_done(bc95_op_type_t op, bc95_op_status_t status, uint16_t result, void *ctx) {
+    if (op == BC95_OP_SEND && status == BC95_OP_DONE) {
+        Serial.printf("Sent bytes %u\r\n", result);
+
+        if (pending_bytes > 0) {
+            // chain the read of the answer
+            bc95.begin_receive_UDP_datagram(receive_buffer, &receive_buffer_size);
+        }
+    } else if (op == BC95_OP_RECEIVE && status == BC95_OP_DONE) {
+        Serial.printf("Received message of size %u stored in 'receive_buffer'\r\n", result);
+    }
+}
@@ -0,0 +1,68 @@
+#include "Arduino.h"
+
+#include <NBIoT_BC95.h>
+#include <NBIoT_BC95_Batch.h>
+
+#define BC95_BAUDRATE               (9600)
+#define PIN_ENABLE                  (1)
+
+#define SAMPLE_PERIOD               (10000)
+// send at least every 10 minutes even if the datagram is not full
+#define MAX_RECORD_AGE              (600000)
+
+// debug serial
+extern HardwareSerial Serial;
+// module communication serial
+extern HardwareSerial Serial1;
+
+NBIoT_BC95 bc95(&Serial1, &Serial);
+
+char dest_ip[15]  = "127.0.0.1";
+uint16_t dest_port = 12321;
+
+NBIoT_BC95_Batch batch(&bc95, dest_ip, dest_port);
+
+typedef struct {
+    uint32_t timestamp;
+    int16_t  temperature;
+    uint16_t humidity;
+} sensor_record_t;
+
+void record_sent(uint16_t record_id, bc95_op_status_t status, void *ctx);
+
+void setup() {
+    Serial.begin(BC95_BAUDRATE);
+
+    pinMode(PIN_ENABLE, OUTPUT);
+    digitalWrite(PIN_ENABLE, HIGH);
+
+    bc95.initialize();
+    bc95.config_psm();
+
+    // check if the module is functional
+    if (bc95.is_assigned_ip()) {
+        // open socket with random port number and ignore incoming messages
+        bc95.open_socket(0, 0);
+    }
+
+    batch.set_max_age(MAX_RECORD_AGE);
+    batch.set_record_callback(record_sent);
+}
+
+void loop() {
+    sensor_record_t record;
+
+    record.timestamp = millis();
+    record.temperature = 215;
+    record.humidity = 480;
+
+    // sent along with the next records once the datagram is full or the oldest one is too old
+    batch.add((const uint8_t *)&record, sizeof(record));
+    batch.poll();
+
+    delay(SAMPLE_PERIOD);
+}
+
+void record_sent(uint16_t record_id, bc95_op_status_t status, void *ctx) {
+    Serial.printf("Record %u %s\r\n", record_id, status == BC95_OP_DONE ? "sent" : "failed");
+}
@@ -0,0 +1,68 @@
+#include "Arduino.h"
+
+#include <NBIoT_BC95.h>
+#include <NBIoT_BC95_CoAP.h>
+
+#define BC95_BAUDRATE               (9600)
+#define PIN_ENABLE                  (1)
+
+#define CHECK_PERIOD                (3600000)
+
+// debug serial
+extern HardwareSerial Serial;
+// module communication serial
+extern HardwareSerial Serial1;
+
+NBIoT_BC95 bc95(&Serial1, &Serial);
+
+char server_ip[15] = "127.0.0.1";
+
+NBIoT_BC95_CoAP coap(&bc95, server_ip);
+
+const char status_report[] = "{\"fw\":\"1.0.0\",\"battery\":3.61}";
+
+void image_block(const bc95_coap_response_t *response, void *ctx);
+
+void setup() {
+    Serial.begin(BC95_BAUDRATE);
+
+    pinMode(PIN_ENABLE, OUTPUT);
+    digitalWrite(PIN_ENABLE, HIGH);
+
+    bc95.initialize();
+    bc95.config_psm();
+
+    // check if the module is functional
+    if (bc95.is_assigned_ip()) {
+        // open socket with random port number and receive incoming messages
+        bc95.open_socket();
+    }
+
+    coap.set_response_handler(image_block);
+}
+
+void loop() {
+    // payloads above BC95_COAP_BLOCK_SIZE would go out block by block
+    coap.request(BC95_COAP_POST, "status", (const uint8_t *)status_report, sizeof(status_report) - 1,
+                 BC95_COAP_FORMAT_JSON);
+
+    // the image comes in blocks, each written out as it arrives
+    if (coap.request(BC95_COAP_GET, "fw/image?current=1.0.0") == BC95_OP_DONE &&
+        coap.get_response_code() == BC95_COAP_CODE(2, 5))
+    {
+        Serial.printf("Image received\r\n");
+    }
+
+    delay(CHECK_PERIOD);
+}
+
+void image_block(const bc95_coap_response_t *response, void *ctx) {
+    if (BC95_COAP_CODE_CLASS(response->code) != 2) {
+        Serial.printf("Response %u.%02u\r\n", BC95_COAP_CODE_CLASS(response->code), BC95_COAP_CODE_DETAIL(response->code));
+        return;
+    }
+
+    // write response->payload to flash at response->offset here
+    Serial.printf("Block at %lu, %u bytes%s\r\n", (unsigned long)response->offset, response->payload_size,
+                  response->more ? "" : ", last");
+}
@@ -48,7 +48,7 @@ void loop() {
     Serial.printf("Sent bytes %u\r\n", sent_bytes);
 
     if (pending_bytes > 0) {
-        bc95.receive_UDP_datagram(receive_buffer, &receive_buffer_size);
+        bc95.receive_UDP_datagram(receive_buffer, &receive_buffer_size, BUFFER_SIZE);
 
         Serial.printf("Received message of size %u stored in 'receive_buffer'\r\n", receive_buffer_size);
     }
@@ -0,0 +1,64 @@
+#include "Arduino.h"
+
+#include <NBIoT_BC95.h>
+#include <NBIoT_BC95_Store.h>
+
+#define BC95_BAUDRATE               (9600)
+#define PIN_ENABLE                  (1)
+
+#define READING_PERIOD              (60000)
+
+// debug serial
+extern HardwareSerial Serial;
+// module communication serial
+extern HardwareSerial Serial1;
+
+NBIoT_BC95 bc95(&Serial1, &Serial);
+
+char server_ip[15] = "127.0.0.1";
+uint16_t server_port = 5000;
+
+// the first 1 kB of EEPROM keeps the readings made out of coverage
+NBIoT_BC95_EEPROM_Storage eeprom(0, 1024);
+NBIoT_BC95_Store store(&bc95, &eeprom, server_ip, server_port);
+
+uint32_t last_reading = 0;
+
+void setup() {
+    Serial.begin(BC95_BAUDRATE);
+
+    pinMode(PIN_ENABLE, OUTPUT);
+    digitalWrite(PIN_ENABLE, HIGH);
+
+    bc95.initialize();
+    bc95.config_psm();
+
+    // check if the module is functional
+    if (bc95.is_assigned_ip()) {
+        // open socket with random port number and receive incoming messages
+        bc95.open_socket();
+    }
+
+    // readings left over from before the reset go out with the next poll()
+    store.begin();
+}
+
+void loop() {
+    if (millis() - last_reading >= READING_PERIOD) {
+        uint8_t reading[6];
+        uint32_t now = millis();
+        uint16_t value = analogRead(A0);
+
+        last_reading = now;
+        memcpy(reading, &now, sizeof(now));
+        memcpy(&reading[4], &value, sizeof(value));
+
+        // sent now, or kept until the modem is attached again
+        store.send(reading, sizeof(reading));
+    }
+
+    if (store.poll() > 0 || store.get_depth() > 0) {
+        Serial.printf("Backlog %u readings, oldest %lu s\r\n", store.get_depth(),
+                      (unsigned long)(store.get_oldest_age() / 1000));
+    }
+}
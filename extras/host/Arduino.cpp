@@ -0,0 +1,67 @@
+#include <Arduino.h>
+
+/* Virtual clock. Advanced by delay() and by the simulated modem. */
+static uint64_t _host_clock = 0;
+
+uint64_t host_clock_us(void) {
+    return _host_clock;
+}
+
+void host_clock_advance_us(uint64_t us) {
+    _host_clock += us;
+}
+
+void host_clock_reset(void) {
+    _host_clock = 0;
+}
+
+unsigned long millis(void) {
+    return (unsigned long)(_host_clock / 1000);
+}
+
+unsigned long micros(void) {
+    return (unsigned long)_host_clock;
+}
+
+void delay(unsigned long ms) {
+    _host_clock += (uint64_t)ms * 1000;
+}
+
+void yield(void) {
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+
+    while (size--) {
+        n += write(*buffer++);
+    }
+
+    return n;
+}
+
+size_t Print::print(unsigned long n, int base) {
+    char buf[8 * sizeof(long) + 1];
+    char *str = &buf[sizeof(buf) - 1];
+
+    if (base < 2) {
+        base = 10;
+    }
+
+    *str = '\0';
+    do {
+        char c = n % base;
+        n /= base;
+        *--str = c < 10 ? c + '0' : c + 'A' - 10;
+    } while (n);
+
+    return write(str);
+}
+
+size_t Print::print(long n, int base) {
+    if (n < 0 && base == DEC) {
+        return print('-') + print((unsigned long)-n, base);
+    }
+
+    return print((unsigned long)n, base);
+}
@@ -0,0 +1,85 @@
+#ifndef __ARDUINO_HOST_H__
+#define __ARDUINO_HOST_H__
+
+/*
+ * Minimal Arduino core replacement used to build the library on a Linux host.
+ * Only the pieces NBIoT_BC95 relies on are provided: Print/Stream, the AVR
+ * PROGMEM string helpers (mapped onto plain libc) and a virtual clock.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/******* PROGMEM *******/
+#define PROGMEM
+#define PGM_P                           const char *
+#define PSTR(s)                         (s)
+
+class __FlashStringHelper;
+#define F(s)                            (reinterpret_cast<const __FlashStringHelper *>(PSTR(s)))
+
+#define pgm_read_byte(addr)             (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)             (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr)            (*(const uint32_t *)(addr))
+#define pgm_read_ptr(addr)              (*(void * const *)(addr))
+
+#define strlen_P                        strlen
+#define strcpy_P                        strcpy
+#define strncpy_P                       strncpy
+#define strcat_P                        strcat
+#define strcmp_P                        strcmp
+#define strncmp_P                       strncmp
+#define strstr_P                        strstr
+#define strtok_P                        strtok
+#define memcpy_P                        memcpy
+#define sprintf_P                       sprintf
+#define snprintf_P                      snprintf
+
+#define DEC                             (10)
+#define HEX                             (16)
+
+/******* Time *******/
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void yield(void);
+
+/* Host only: virtual clock driven by the simulator and delay() */
+uint64_t host_clock_us(void);
+void host_clock_advance_us(uint64_t us);
+void host_clock_reset(void);
+
+/******* Print / Stream *******/
+class Print {
+    public:
+        virtual ~Print() { }
+
+        virtual size_t write(uint8_t c) = 0;
+        virtual size_t write(const uint8_t *buffer, size_t size);
+        size_t write(const char *str) { return str == NULL ? 0 : write((const uint8_t *)str, strlen(str)); }
+        virtual void flush(void) { }
+
+        size_t print(const __FlashStringHelper *str) { return write(reinterpret_cast<const char *>(str)); }
+        size_t print(const char *str) { return write(str); }
+        size_t print(char c) { return write((uint8_t)c); }
+        size_t print(unsigned long n, int base = DEC);
+        size_t print(long n, int base = DEC);
+        size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+        size_t print(int n, int base = DEC) { return print((long)n, base); }
+        size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+
+        size_t println(void) { return write((const uint8_t *)"\r\n", 2); }
+        template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+};
+
+class Stream : public Print {
+    public:
+        virtual int available(void) = 0;
+        virtual int read(void) = 0;
+        virtual int peek(void) = 0;
+};
+
+#endif // __ARDUINO_HOST_H__
@@ -0,0 +1,96 @@
+#include "BC95FileStorage.h"
+
+BC95FileStorage::BC95FileStorage(const char *path, uint32_t size, uint32_t erase_size) :
+    _size(size),
+    _erase_size(erase_size),
+    _cut(false),
+    _budget(0),
+    _bytes_written(0),
+    _erases(0),
+    _program_errors(0)
+{
+    long length;
+
+    _file = fopen(path, "r+b");
+    if (_file == NULL) {
+        _file = fopen(path, "w+b");
+    }
+    if (_file == NULL) {
+        return;
+    }
+
+    fseek(_file, 0, SEEK_END);
+    length = ftell(_file);
+    for (long i = length; i < (long)size; i++) {
+        fputc(0xFF, _file);
+    }
+    fflush(_file);
+}
+
+BC95FileStorage::~BC95FileStorage() {
+    if (_file != NULL) {
+        fclose(_file);
+    }
+}
+
+uint8_t BC95FileStorage::read(const uint32_t address, uint8_t *data, const uint16_t data_size) {
+    if (_file == NULL || address + data_size > _size || fseek(_file, address, SEEK_SET) != 0) {
+        return 0;
+    }
+
+    return fread(data, 1, data_size, _file) == data_size;
+}
+
+uint8_t BC95FileStorage::write(const uint32_t address, const uint8_t *data, const uint16_t data_size) {
+    uint8_t old;
+
+    if (_file == NULL || address + data_size > _size) {
+        return 0;
+    }
+
+    for (uint16_t i = 0; i < data_size; i++) {
+        uint8_t c = data[i];
+
+        if (_cut) {
+            if (_budget == 0) {
+                return 0;
+            }
+            _budget--;
+        }
+        if (_erase_size > 0) {
+            // NOR flash programs 1 bits to 0 only
+            if (!read(address + i, &old, 1)) {
+                return 0;
+            }
+            if ((old & c) != c) {
+                _program_errors++;
+            }
+            c &= old;
+        }
+        if (fseek(_file, address + i, SEEK_SET) != 0 || fputc(c, _file) == EOF) {
+            return 0;
+        }
+        _bytes_written++;
+    }
+    fflush(_file);
+
+    return 1;
+}
+
+uint8_t BC95FileStorage::erase(const uint32_t address) {
+    if (_file == NULL || _erase_size == 0 || address % _erase_size != 0 || address + _erase_size > _size) {
+        return 0;
+    }
+    if (is_cut()) {
+        return 0;
+    }
+
+    fseek(_file, address, SEEK_SET);
+    for (uint32_t i = 0; i < _erase_size; i++) {
+        fputc(0xFF, _file);
+    }
+    fflush(_file);
+    _erases++;
+
+    return 1;
+}
@@ -0,0 +1,52 @@
+#ifndef __BC95_FILE_STORAGE_H__
+#define __BC95_FILE_STORAGE_H__
+
+#include <NBIoT_BC95_Store.h>
+
+/*
+ * NBIoT_BC95_Storage on a host file, as EEPROM or as NOR flash.
+ *
+ * As flash it has an erase size: erasing sets a block to 0xFF and writing can
+ * only clear bits, a write that would set one is counted as a program error.
+ * A power cut can be scheduled after a number of written bytes: the bytes up
+ * to it land, every write after it is lost.
+ */
+class BC95FileStorage : public NBIoT_BC95_Storage {
+
+    public:
+
+        /* Opens path, creating it blank (0xFF) or growing it to size bytes */
+        BC95FileStorage(const char *path, uint32_t size, uint32_t erase_size = 0);
+        ~BC95FileStorage();
+
+        /* NBIoT_BC95_Storage */
+        uint32_t size(void) { return _size; }
+        uint8_t read(const uint32_t address, uint8_t *data, const uint16_t data_size);
+        uint8_t write(const uint32_t address, const uint8_t *data, const uint16_t data_size);
+        uint32_t erase_size(void) { return _erase_size; }
+        uint8_t erase(const uint32_t address);
+
+        /* Power cut after this many more written bytes */
+        void cut_after(uint32_t bytes) { _cut = true; _budget = bytes; }
+        bool is_cut(void) const { return _cut && _budget == 0; }
+
+        uint32_t bytes_written(void) const { return _bytes_written; }
+        uint32_t erases(void) const { return _erases; }
+        uint32_t program_errors(void) const { return _program_errors; }
+
+    private:
+
+        FILE *_file;
+        uint32_t _size;
+        uint32_t _erase_size;
+
+        bool _cut;
+        uint32_t _budget;
+
+        uint32_t _bytes_written;
+        uint32_t _erases;
+        uint32_t _program_errors;
+};
+
+
+#endif // __BC95_FILE_STORAGE_H__
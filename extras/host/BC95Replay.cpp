@@ -0,0 +1,171 @@
+#include "BC95Replay.h"
+
+#include <NBIoT_BC95_Trace.h>
+
+// polling an empty UART lets this much time pass, as BC95Simulator does
+#define REPLAY_IDLE_STEP_US             (100)
+
+BC95Replay::BC95Replay(uint32_t baud_rate) :
+    _record(0),
+    _offset(0),
+    _record_start(0),
+    _previous_start(0),
+    _divergences(0)
+{
+    set_baud_rate(baud_rate);
+}
+
+bool BC95Replay::load(const char *path) {
+    std::vector<uint8_t> trace;
+    FILE *f = fopen(path, "rb");
+    int c;
+
+    if (f == NULL) {
+        return false;
+    }
+    while ((c = fgetc(f)) != EOF) {
+        trace.push_back((uint8_t)c);
+    }
+    fclose(f);
+
+    return load(trace);
+}
+
+bool BC95Replay::load(const std::vector<uint8_t> &trace) {
+    size_t i = BC95_TRACE_HEADER_LEN;
+
+    _records.clear();
+    _record = 0;
+    _offset = 0;
+    _divergences = 0;
+    _first_divergence.clear();
+
+    if (trace.size() < BC95_TRACE_HEADER_LEN ||
+        memcmp(&trace[0], BC95_TRACE_MAGIC, BC95_TRACE_MAGIC_LEN) != 0 ||
+        trace[BC95_TRACE_MAGIC_LEN] != BC95_TRACE_VERSION)
+    {
+        return false;
+    }
+
+    while (i < trace.size()) {
+        record_t record;
+        size_t len = (trace[i] & BC95_TRACE_LEN_MASK) + 1;
+        uint8_t shift = 0;
+
+        record.from_modem = (trace[i++] & BC95_TRACE_FROM_MODEM) != 0;
+        record.delta_ms = 0;
+        do {
+            if (i >= trace.size() || shift > 28) {
+                return false;
+            }
+            record.delta_ms |= (uint32_t)(trace[i] & 0x7F) << shift;
+            shift += 7;
+        } while (trace[i++] & 0x80);
+
+        if (i + len > trace.size()) {
+            return false;
+        }
+        record.data.assign(trace.begin() + i, trace.begin() + i + len);
+        i += len;
+
+        _records.push_back(record);
+    }
+
+    _previous_start = host_clock_us();
+    _start_record();
+
+    return true;
+}
+
+int BC95Replay::available(void) {
+    uint64_t now = host_clock_us();
+    uint64_t next;
+
+    if (_readable()) {
+        // bytes of a record come in one after the other at the UART rate
+        size_t arrived = (now - _record_start) / _byte_time + 1;
+
+        return (arrived < _records[_record].data.size() ? arrived : _records[_record].data.size()) - _offset;
+    }
+
+    // nothing to read yet: let time pass up to the next byte
+    next = now + REPLAY_IDLE_STEP_US;
+    if (!done() && _records[_record].from_modem && _next_byte() > now && _next_byte() < next) {
+        next = _next_byte();
+    }
+    host_clock_advance_us(next - now);
+
+    return 0;
+}
+
+int BC95Replay::read(void) {
+    int c = peek();
+
+    if (c >= 0 && ++_offset == _records[_record].data.size()) {
+        _next_record();
+    }
+
+    return c;
+}
+
+int BC95Replay::peek(void) {
+    return _readable() ? _records[_record].data[_offset] : -1;
+}
+
+size_t BC95Replay::write(uint8_t c) {
+    // blocking UART transmission
+    host_clock_advance_us(_byte_time);
+
+    if (done()) {
+        _diverge(c, "written after the end of the trace");
+    } else if (_records[_record].from_modem) {
+        _diverge(c, "written while the modem was answering");
+    } else {
+        if (_offset == 0) {
+            _record_start = host_clock_us();
+        }
+        if (_records[_record].data[_offset] != c) {
+            _diverge(c, "differs from the trace");
+        }
+        if (++_offset == _records[_record].data.size()) {
+            _next_record();
+        }
+    }
+
+    return 1;
+}
+
+bool BC95Replay::_readable(void) const {
+    return !done() && _records[_record].from_modem && host_clock_us() >= _next_byte();
+}
+
+uint64_t BC95Replay::_next_byte(void) const {
+    return _record_start + _offset * _byte_time;
+}
+
+void BC95Replay::_start_record(void) {
+    _offset = 0;
+
+    if (!done() && _records[_record].from_modem) {
+        // readable the recorded time after the record before it
+        _record_start = _previous_start + (uint64_t)_records[_record].delta_ms * 1000;
+    } else {
+        // starts when the library writes its first byte
+        _record_start = 0;
+    }
+}
+
+void BC95Replay::_next_record(void) {
+    _previous_start = _record_start;
+    _record++;
+    _start_record();
+}
+
+void BC95Replay::_diverge(uint8_t c, const char *what) {
+    char description[96];
+
+    if (_divergences++ == 0) {
+        snprintf(description, sizeof(description), "record %zu byte %zu: 0x%02X %s", _record, _offset, c, what);
+        _first_divergence = description;
+    }
+}
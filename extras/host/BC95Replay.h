@@ -0,0 +1,78 @@
+#ifndef __BC95_REPLAY_H__
+#define __BC95_REPLAY_H__
+
+#include <Arduino.h>
+
+#include <string>
+#include <vector>
+
+/*
+ * Plays an NBIoT_BC95_Trace recording back as the modem UART.
+ *
+ * Recorded modem bytes become readable at their recorded times, counted from
+ * the record before them, and one byte time apart within a record, so the
+ * library runs into the same timeouts as in the recorded session. Bytes
+ * written by the library are checked against the recorded ones: any
+ * difference is a divergence. Time is virtual (see host_clock_us()) and
+ * advances while the library waits, as with BC95Simulator, so a replay is
+ * deterministic.
+ */
+class BC95Replay : public Stream {
+
+    public:
+
+        BC95Replay(uint32_t baud_rate = 9600);
+
+        /*
+         * Load a trace, from a file or from memory. Rewinds the replay.
+         * @return                 false if the trace is unreadable or malformed
+         */
+        bool load(const char *path);
+        bool load(const std::vector<uint8_t> &trace);
+
+        /* Stream interface */
+        int available(void);
+        int read(void);
+        int peek(void);
+        size_t write(uint8_t c);
+        using Print::write;
+
+        /* Host side UART rate, writes take one byte time each */
+        void set_baud_rate(uint32_t baud_rate) { _byte_time = 10000000ULL / baud_rate; }
+
+        /* Every record replayed */
+        bool done(void) const { return _record >= _records.size(); }
+        size_t records(void) const { return _records.size(); }
+        size_t position(void) const { return _record; }
+
+        /* Bytes written by the library that differ from or are missing in the trace */
+        uint32_t divergences(void) const { return _divergences; }
+        const std::string &first_divergence(void) const { return _first_divergence; }
+
+    private:
+
+        typedef struct {
+            uint8_t from_modem;
+            uint32_t delta_ms;              // since the previous record
+            std::vector<uint8_t> data;
+        } record_t;
+
+        std::vector<record_t> _records;
+        size_t _record;
+        size_t _offset;
+        uint64_t _record_start;             // when the current record started, 0 if not yet
+        uint64_t _previous_start;
+        uint64_t _byte_time;
+
+        uint32_t _divergences;
+        std::string _first_divergence;
+
+        bool _readable(void) const;
+        uint64_t _next_byte(void) const;
+        void _start_record(void);
+        void _next_record(void);
+        void _diverge(uint8_t c, const char *what);
+};
+
+
+#endif // __BC95_REPLAY_H__
@@ -0,0 +1,810 @@
+#include "BC95Simulator.h"
+
+#include <ctype.h>
+
+/* Granularity used to advance the virtual clock while the host polls an idle UART */
+#define SIM_IDLE_STEP_US                (100)
+
+#define SIM_DEFAULT_LATENCY_MS          (10)
+#define SIM_DEFAULT_NETWORK_RTT_MS      (600)
+#define SIM_DEFAULT_REBOOT_MS           (3000)
+#define SIM_DEFAULT_INACTIVITY_MS       (20000)
+#define SIM_DEFAULT_ACTIVE_TIME_MS      (10000)
+
+#define SIM_NSOST_MAX_LEN               (512)
+
+/* AT+NSOSTF release assistance flags */
+#define SIM_RAI_RELEASE_AFTER_UPLINK    (0x200)
+#define SIM_RAI_RELEASE_AFTER_DOWNLINK  (0x400)
+#define SIM_NSORF_MAX_LEN               (1358)
+
+#define SIM_IP_ADDRESS                  "10.45.0.2"
+#define SIM_DNS_ADDRESS                 "93.184.216.34"
+
+static std::vector<std::string> _split(const std::string &s, char sep) {
+    std::vector<std::string> out;
+    size_t start = 0, pos;
+
+    while ((pos = s.find(sep, start)) != std::string::npos) {
+        out.push_back(s.substr(start, pos - start));
+        start = pos + 1;
+    }
+    out.push_back(s.substr(start));
+
+    return out;
+}
+
+static uint8_t _starts_with(const std::string &s, const char *prefix) {
+    return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static std::string _to_hex(const BC95Simulator::datagram_t &data, size_t offset, size_t len) {
+    static const char digits[] = "0123456789ABCDEF";
+    std::string out;
+
+    for (size_t i = offset; i < offset + len; i++) {
+        out += digits[data[i] >> 4];
+        out += digits[data[i] & 0x0F];
+    }
+
+    return out;
+}
+
+static int _nibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+BC95Simulator::BC95Simulator(uint32_t baud_rate) :
+    _max_baud(0),
+    _natspeed_pending(0),
+    _natspeed_generation(0),
+    _network_rtt((uint64_t)SIM_DEFAULT_NETWORK_RTT_MS * 1000),
+    _default_latency((uint64_t)SIM_DEFAULT_LATENCY_MS * 1000),
+    _concatenated(0),
+    _concat_failed(0),
+    _booting(0),
+    _boot_time((uint64_t)SIM_DEFAULT_REBOOT_MS * 1000),
+    _rrc_generation(0),
+    _rrc_connected_at(0),
+    _inactivity_timer((uint64_t)SIM_DEFAULT_INACTIVITY_MS * 1000),
+    _psm_active_time((uint64_t)SIM_DEFAULT_ACTIVE_TIME_MS * 1000),
+    _tx_free(0),
+    _in_event(0),
+    _event_time(0),
+    _trace(NULL)
+{
+    reset_stats();
+    set_baud_rate(baud_rate);
+
+    // typical figures observed on BC95-G modules
+    set_latency("AT+CFUN=", 1500);
+    set_latency("AT+NBAND", 50);
+    set_latency("AT+NCONFIG", 50);
+    set_latency("AT+CPSMS", 50);
+    set_latency("AT+NSOST", 30);
+    set_latency("AT+NSORF", 20);
+
+    _peer = echo_peer();
+    _first_socket = 1;
+    _reset_nv();
+    _nv_baud = baud_rate;
+    _reset_state();
+}
+
+/******* Stream *******/
+
+int BC95Simulator::available(void) {
+    uint64_t now;
+    int n = 0;
+
+    _run();
+
+    now = host_clock_us();
+    for (std::deque<tx_byte_t>::const_iterator it = _tx.begin(); it != _tx.end() && it->at <= now; ++it) {
+        n++;
+    }
+
+    if (n == 0) {
+        // nothing to read yet: let time pass up to the next byte or event
+        uint64_t next = now + SIM_IDLE_STEP_US;
+
+        if (!_tx.empty() && _tx.front().at < next) {
+            next = _tx.front().at;
+        }
+        if (!_events.empty() && _events.begin()->first < next) {
+            next = _events.begin()->first;
+        }
+        host_clock_advance_us(next > now ? next - now : 1);
+    }
+
+    return n;
+}
+
+int BC95Simulator::read(void) {
+    int c = peek();
+
+    if (c >= 0) {
+        _tx.pop_front();
+        _stats.bytes_from_modem++;
+    }
+
+    return c;
+}
+
+int BC95Simulator::peek(void) {
+    _run();
+
+    if (_tx.empty() || _tx.front().at > host_clock_us()) {
+        return -1;
+    }
+
+    return _tx.front().c;
+}
+
+size_t BC95Simulator::write(uint8_t c) {
+    // blocking UART transmission
+    host_clock_advance_us(_byte_time);
+    _stats.bytes_to_modem++;
+
+    if (!_link_ok()) {
+        _stats.framing_errors++;
+        _cmd_line.clear();
+    } else if (c == '\r' || c == '\n') {
+        if (!_cmd_line.empty()) {
+            std::string cmd = _cmd_line;
+
+            _cmd_line.clear();
+            _stats.commands++;
+            if (_natspeed_pending) {
+                // understood at the new rate, keep it
+                _natspeed_pending = 0;
+                if (_natspeed_store) {
+                    _nv_baud = _modem_baud;
+                }
+            }
+            if (_trace != NULL) {
+                fprintf(_trace, "[%10.3f] > %s\n", host_clock_us() / 1000.0, cmd.c_str());
+            }
+            _schedule(_latency_of(cmd), [this, cmd]() { _handle(cmd); });
+        }
+    } else {
+        _cmd_line += (char)c;
+    }
+
+    _run();
+
+    return 1;
+}
+
+/******* Configuration *******/
+
+void BC95Simulator::set_baud_rate(uint32_t baud_rate) {
+    // 8N1: 10 bits per byte
+    _host_baud = baud_rate;
+    _byte_time = 10000000ULL / baud_rate;
+}
+
+void BC95Simulator::set_latency(const char *cmd_prefix, uint32_t latency_ms) {
+    _latency[cmd_prefix] = (uint64_t)latency_ms * 1000;
+}
+
+void BC95Simulator::set_default_latency(uint32_t latency_ms) {
+    _default_latency = (uint64_t)latency_ms * 1000;
+}
+
+void BC95Simulator::set_registered(uint8_t registered) {
+    if (registered != _registered && _cereg_n > 0) {
+        _emit(std::string("+CEREG:") + (registered ? "1" : "0"));
+    }
+    _registered = registered;
+}
+
+BC95Simulator::peer_t BC95Simulator::echo_peer(void) {
+    return [](BC95Simulator &sim, uint8_t socket, const std::string &ip, uint16_t port, const datagram_t &data) {
+        sim.deliver(socket, ip, port, data);
+    };
+}
+
+uint8_t BC95Simulator::open_sockets(void) const {
+    uint8_t count = 0;
+
+    for (uint8_t i = 0; i < SOCKET_IDS; i++) {
+        count += _sockets[i].open;
+    }
+
+    return count;
+}
+
+void BC95Simulator::deliver(uint8_t socket, const std::string &ip, uint16_t port, const datagram_t &data) {
+    if (socket >= SOCKET_IDS || !_sockets[socket].open) {
+        return;
+    }
+
+    _rrc_activity();
+
+    rx_datagram_t d = { ip, port, data };
+    _sockets[socket].rx.push_back(d);
+
+    if (_sockets[socket].recv_msg) {
+        _emit("+NSONMI:" + std::to_string(socket) + "," + std::to_string(data.size()));
+    }
+
+    if (_sockets[socket].release_on_downlink) {
+        _sockets[socket].release_on_downlink = 0;
+        _rrc_release();
+    }
+}
+
+uint64_t BC95Simulator::connected_us(void) {
+    // releases due by now may not have run yet if the host has not polled the UART
+    _run();
+
+    return _stats.connected_us + (_rrc_connected ? host_clock_us() - _rrc_connected_at : 0);
+}
+
+/******* Radio *******/
+
+void BC95Simulator::_rrc_activity(void) {
+    uint32_t generation = ++_rrc_generation;
+
+    if (_in_psm) {
+        _in_psm = 0;
+        if (_npsmr_n) {
+            _emit("+NPSMR:0");
+        }
+    }
+    if (!_rrc_connected) {
+        _rrc_connected = 1;
+        _rrc_connected_at = _now();
+        _stats.rrc_setups++;
+        if (_cscon_n) {
+            _emit("+CSCON:1");
+        }
+    }
+
+    if (_inactivity_timer == 0) {
+        return;
+    }
+
+    // the network releases the connection once the inactivity timer expires without traffic
+    _schedule(_inactivity_timer, [this, generation]() {
+        if (generation == _rrc_generation) {
+            _rrc_release();
+        }
+    });
+}
+
+void BC95Simulator::_rrc_release(void) {
+    uint32_t generation = ++_rrc_generation;
+
+    if (!_rrc_connected) {
+        return;
+    }
+
+    _rrc_connected = 0;
+    _stats.connected_us += _now() - _rrc_connected_at;
+    if (_cscon_n) {
+        _emit("+CSCON:0");
+    }
+
+    if (_psm_mode && _psm_active_time > 0) {
+        _schedule(_psm_active_time, [this, generation]() {
+            if (generation != _rrc_generation) {
+                return;
+            }
+            _in_psm = 1;
+            if (_npsmr_n) {
+                _emit("+NPSMR:1");
+            }
+        });
+    }
+}
+
+/******* Virtual UART *******/
+
+uint64_t BC95Simulator::next_activity_us(void) const {
+    uint64_t next = _tx.empty() ? 0 : _tx.front().at;
+
+    if (!_events.empty() && (next == 0 || _events.begin()->first < next)) {
+        next = _events.begin()->first;
+    }
+
+    return next;
+}
+
+void BC95Simulator::_run(void) {
+    while (!_events.empty() && _events.begin()->first <= host_clock_us()) {
+        std::function<void()> action = _events.begin()->second;
+
+        // actions run at their scheduled time even if the host polled late
+        _event_time = _events.begin()->first;
+        _in_event = 1;
+        _events.erase(_events.begin());
+        action();
+        _in_event = 0;
+    }
+}
+
+void BC95Simulator::_schedule(uint64_t delay_us, std::function<void()> action) {
+    _events.insert(std::make_pair(_now() + delay_us, action));
+}
+
+void BC95Simulator::_emit(const std::string &line) {
+    if (_trace != NULL) {
+        fprintf(_trace, "[%10.3f] < %s\n", _now() / 1000.0, line.c_str());
+    }
+
+    std::string framed = "\r\n" + line + "\r\n";
+    uint64_t at = _now() > _tx_free ? _now() : _tx_free;
+
+    if (!_link_ok()) {
+        // garbled on the way, the host sees nothing usable
+        _stats.framing_errors += framed.size();
+        return;
+    }
+
+    for (size_t i = 0; i < framed.size(); i++) {
+        at += 10000000ULL / _modem_baud;
+        tx_byte_t b = { at, (uint8_t)framed[i] };
+        _tx.push_back(b);
+    }
+
+    _tx_free = at;
+}
+
+uint64_t BC95Simulator::_latency_of(const std::string &cmd) const {
+    uint64_t latency = _default_latency;
+    size_t best = 0;
+
+    if (_starts_with(cmd, "AT") && cmd.find(';') != std::string::npos) {
+        // concatenated commands are processed one after the other
+        std::vector<std::string> parts = _split(cmd.substr(2), ';');
+
+        latency = 0;
+        for (size_t i = 0; i < parts.size(); i++) {
+            latency += _latency_of("AT" + parts[i]);
+        }
+        return latency;
+    }
+
+    for (std::map<std::string, uint64_t>::const_iterator it = _latency.begin(); it != _latency.end(); ++it) {
+        if (it->first.size() > best && _starts_with(cmd, it->first.c_str())) {
+            best = it->first.size();
+            latency = it->second;
+        }
+    }
+
+    return latency;
+}
+
+/******* AT command interpreter *******/
+
+void BC95Simulator::_reset_nv(void) {
+    // factory defaults
+    _autoconnect = 0;
+    _led_mode = 1;
+    _psm_mode = 0;
+    _tau = "00000000";
+    _active_time = "00000000";
+    _bands = "8,20";
+}
+
+void BC95Simulator::_reset_state(void) {
+    // the radio comes up on its own only with autoconnect
+    _cfun = _autoconnect;
+    _registered = 1;
+    _attached = 1;
+    _cereg_n = 0;
+    _cscon_n = 0;
+    _npsmr_n = 0;
+    _rrc_connected = 0;
+    _in_psm = 0;
+    _rrc_generation++;
+    _modem_baud = _nv_baud;
+    _natspeed_pending = 0;
+    _natspeed_generation++;
+
+    for (uint8_t i = 0; i < SOCKET_IDS; i++) {
+        _sockets[i].open = 0;
+        _sockets[i].rx.clear();
+    }
+}
+
+void BC95Simulator::power_on(void) {
+    // whatever was still on its way to the host is lost
+    _tx.clear();
+    _tx_free = 0;
+    _events.clear();
+    _boot("REBOOT_CAUSE_UNKNOWN");
+}
+
+void BC95Simulator::_reboot(void) {
+    _emit("REBOOTING");
+    _boot("REBOOT_CAUSE_APPLICATION_AT");
+}
+
+void BC95Simulator::_boot(const char *cause) {
+    std::string reboot_cause = cause;
+
+    _reset_state();
+    _booting = 1;
+
+    _schedule(_boot_time, [this, reboot_cause]() {
+        _emit("Boot: Unsigned");
+        _emit("Security B.. Verified");
+        _emit("Protocol A.. Verified");
+        _emit("Apps A...... Verified");
+        _emit(reboot_cause);
+        _emit("Neul ");
+        _ok();
+        _booting = 0;
+    });
+}
+
+void BC95Simulator::_handle(const std::string &cmd) {
+    uint8_t online = _cfun && _registered && _attached;
+
+    if (_booting) {
+        // the UART is not served yet
+        return;
+    }
+
+    if (_starts_with(cmd, "AT") && cmd.find(';') != std::string::npos) {
+        // V.250 concatenation: AT<cmd>;<cmd>;..., execution stops at the first error
+        std::vector<std::string> parts = _split(cmd.substr(2), ';');
+
+        _concatenated = 1;
+        _concat_failed = 0;
+        for (size_t i = 0; i < parts.size() && !_concat_failed; i++) {
+            _handle("AT" + parts[i]);
+        }
+        _concatenated = 0;
+
+        if (_concat_failed) {
+            _error();
+        } else {
+            _ok();
+        }
+        return;
+    }
+
+    if (cmd == "AT" || cmd == "ATE0" || cmd == "ATE1" || _starts_with(cmd, "AT+CMEE=")) {
+        _ok();
+    } else if (_starts_with(cmd, "AT+NCONFIG=")) {
+        std::vector<std::string> args = _split(cmd.substr(11), ',');
+
+        for (size_t i = 0; i < args.size(); i++) {
+            for (size_t j = 0; j < args[i].size(); j++) {
+                args[i][j] = toupper(args[i][j]);
+            }
+        }
+        if (args.size() != 2 || (args[1] != "TRUE" && args[1] != "FALSE")) {
+            _error();
+        } else {
+            if (args[0] == "AUTOCONNECT") {
+                _autoconnect = (args[1] == "TRUE");
+            }
+            _stats.nv_writes++;
+            _ok();
+        }
+    } else if (cmd == "AT+NCONFIG?") {
+        _emit(std::string("+NCONFIG:AUTOCONNECT,") + (_autoconnect ? "TRUE" : "FALSE"));
+        _emit("+NCONFIG:CR_0354_0338_SCRAMBLING,TRUE");
+        _emit("+NCONFIG:CR_0859_SI_AVOID,TRUE");
+        _emit("+NCONFIG:COMBINE_ATTACH,FALSE");
+        _emit("+NCONFIG:CELL_RESELECTION,FALSE");
+        _emit("+NCONFIG:ENABLE_BIP,FALSE");
+        _ok();
+    } else if (_starts_with(cmd, "AT+QLEDMODE=")) {
+        _led_mode = atoi(cmd.c_str() + 12) != 0;
+        _stats.nv_writes++;
+        _ok();
+    } else if (cmd == "AT+QLEDMODE?") {
+        _emit("+QLEDMODE:" + std::to_string(_led_mode));
+        _ok();
+    } else if (_starts_with(cmd, "AT+CFUN=")) {
+        _cfun = atoi(cmd.c_str() + 8) != 0;
+        _ok();
+    } else if (cmd == "AT+CFUN?") {
+        _emit("+CFUN:" + std::to_string(_cfun));
+        _ok();
+    } else if (_starts_with(cmd, "AT+CEREG=")) {
+        _cereg_n = atoi(cmd.c_str() + 9);
+        _ok();
+    } else if (cmd == "AT+CEREG?") {
+        _emit("+CEREG:" + std::to_string(_cereg_n) + "," + ((_cfun && _registered) ? "1" : "0"));
+        _ok();
+    } else if (_starts_with(cmd, "AT+CSCON=")) {
+        _cscon_n = atoi(cmd.c_str() + 9);
+        _ok();
+    } else if (cmd == "AT+CSCON?") {
+        _emit("+CSCON:" + std::to_string(_cscon_n) + "," + (_rrc_connected ? "1" : "0"));
+        _ok();
+    } else if (cmd == "AT+CGATT?") {
+        _emit(std::string("+CGATT:") + ((_cfun && _attached) ? "1" : "0"));
+        _ok();
+    } else if (_starts_with(cmd, "AT+CGATT=")) {
+        _attached = atoi(cmd.c_str() + 9) != 0;
+        _ok();
+    } else if (cmd == "AT+CGPADDR=0" || cmd == "AT+CGPADDR") {
+        _emit(online ? "+CGPADDR:0," SIM_IP_ADDRESS : "+CGPADDR:0");
+        _ok();
+    } else if (_starts_with(cmd, "AT+NSOCR=")) {
+        std::vector<std::string> args = _split(cmd.substr(9), ',');
+        uint8_t last = (_first_socket + MAX_SOCKETS - 1 < SOCKET_IDS) ? _first_socket + MAX_SOCKETS - 1 : SOCKET_IDS;
+        uint8_t id;
+
+        // socket 0 is reserved by the module for its own IoT platform connection
+        for (id = _first_socket; id < last && _sockets[id].open; id++);
+
+        if (args.size() < 3 || args[0] != "DGRAM" || args[1] != "17" || id >= last) {
+            _error();
+        } else {
+            _sockets[id].open = 1;
+            _sockets[id].port = atoi(args[2].c_str());
+            _sockets[id].recv_msg = args.size() < 4 || atoi(args[3].c_str()) != 0;
+            _sockets[id].release_on_downlink = 0;
+            _sockets[id].rx.clear();
+            _emit(std::to_string(id));
+            _ok();
+        }
+    } else if (_starts_with(cmd, "AT+NSOCL=")) {
+        uint8_t id = atoi(cmd.c_str() + 9);
+
+        if (id < SOCKET_IDS && _sockets[id].open) {
+            _sockets[id].open = 0;
+            _sockets[id].rx.clear();
+            _ok();
+        } else {
+            _error();
+        }
+    } else if (_starts_with(cmd, "AT+NSOST=")) {
+        _handle_nsost(cmd.substr(9), 0);
+    } else if (_starts_with(cmd, "AT+NSOSTF=")) {
+        _handle_nsost(cmd.substr(10), 1);
+    } else if (_starts_with(cmd, "AT+NSORF=")) {
+        _handle_nsorf(cmd.substr(9));
+    } else if (_starts_with(cmd, "AT+NPING=")) {
+        std::string host = cmd.substr(9);
+
+        if (!online) {
+            _error();
+        } else {
+            _ok();
+            _rrc_activity();
+            _schedule(_network_rtt, [this, host]() {
+                _emit("+NPING:" + host + ",64," + std::to_string(_network_rtt / 1000));
+            });
+        }
+    } else if (_starts_with(cmd, "AT+QDNS=0,")) {
+        if (!online) {
+            _error();
+        } else {
+            // names under the reserved .invalid domain never resolve
+            uint8_t nxdomain = cmd.size() >= 8 && cmd.compare(cmd.size() - 8, 8, ".invalid") == 0;
+
+            _ok();
+            _rrc_activity();
+            _schedule(_network_rtt, [this, nxdomain]() { _emit(nxdomain ? "+QDNS:ERROR" : "+QDNS:" SIM_DNS_ADDRESS); });
+        }
+    } else if (_starts_with(cmd, "AT+QDNS=1")) {
+        _ok();
+    } else if (_starts_with(cmd, "AT+CPSMS=")) {
+        std::vector<std::string> args = _split(cmd.substr(9), ',');
+
+        _psm_mode = atoi(args[0].c_str());
+        if (_psm_mode == 2) {
+            // disable and discard: reads back as disabled with the default timers
+            _psm_mode = 0;
+            _tau = "00000000";
+            _active_time = "00000000";
+        } else if (args.size() >= 5) {
+            _tau = args[3];
+            _active_time = args[4];
+        }
+        _stats.nv_writes++;
+        _ok();
+    } else if (cmd == "AT+CPSMS?") {
+        _emit("+CPSMS:" + std::to_string(_psm_mode) + ",,," + _tau + "," + _active_time);
+        _ok();
+    } else if (_starts_with(cmd, "AT+NBAND=")) {
+        if (_cfun) {
+            _error();
+        } else {
+            _bands = cmd.substr(9);
+            _stats.nv_writes++;
+            _ok();
+        }
+    } else if (cmd == "AT+NBAND?") {
+        _emit("+NBAND:" + _bands);
+        _ok();
+    } else if (_starts_with(cmd, "AT+NPSMR=")) {
+        _npsmr_n = atoi(cmd.c_str() + 9);
+        _ok();
+    } else if (cmd == "AT+NPSMR?") {
+        _emit("+NPSMR:" + std::to_string(_npsmr_n) + (_npsmr_n ? (_in_psm ? ",1" : ",0") : ""));
+        _ok();
+    } else if (cmd == "AT+CCLK?") {
+        _emit("+CCLK:26/10/16,12:00:00+08");
+        _ok();
+    } else if (cmd == "AT+CSQ") {
+        _emit(online ? "+CSQ:20,99" : "+CSQ:99,99");
+        _ok();
+    } else if (cmd == "AT+CGSN=1") {
+        _emit("+CGSN:863703030123456");
+        _ok();
+    } else if (cmd == "AT+NCCID") {
+        _emit("+NCCID:89860317422044000000");
+        _ok();
+    } else if (cmd == "AT+NRB") {
+        _reboot();
+    } else if (_starts_with(cmd, "AT+NATSPEED=")) {
+        _handle_natspeed(cmd.substr(12));
+    } else if (cmd == "AT+NATSPEED?") {
+        _emit("+NATSPEED:" + std::to_string(_modem_baud) + ",0,1,0,0");
+        _ok();
+    } else {
+        _error();
+    }
+}
+
+void BC95Simulator::_handle_nsost(const std::string &args, uint8_t with_flags) {
+    std::vector<std::string> f = _split(args, ',');
+    uint8_t id;
+    datagram_t data;
+    unsigned long flags = 0;
+
+    if (f.size() != (with_flags ? 6 : 5)) {
+        _error();
+        return;
+    }
+
+    if (with_flags) {
+        // <socket>,<remote_addr>,<remote_port>,<flag>,<length>,<data>
+        flags = strtoul(f[3].c_str(), NULL, 16);
+        if (flags & ~(unsigned long)(SIM_RAI_RELEASE_AFTER_UPLINK | SIM_RAI_RELEASE_AFTER_DOWNLINK)) {
+            _error();
+            return;
+        }
+        f.erase(f.begin() + 3);
+    }
+
+    id = atoi(f[0].c_str());
+    size_t len = atoi(f[3].c_str());
+
+    if (id >= SOCKET_IDS || !_sockets[id].open || !_cfun || !_attached || len > SIM_NSOST_MAX_LEN ||
+        f[4].size() != (len << 1)) {
+        _error();
+        return;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        int hi = _nibble(f[4][i << 1]), lo = _nibble(f[4][(i << 1) + 1]);
+
+        if (hi < 0 || lo < 0) {
+            _error();
+            return;
+        }
+        data.push_back((uint8_t)((hi << 4) | lo));
+    }
+
+    _emit(f[0] + "," + std::to_string(len));
+    _ok();
+    _rrc_activity();
+
+    if (flags & SIM_RAI_RELEASE_AFTER_UPLINK) {
+        uint32_t generation = _rrc_generation;
+
+        // released as soon as the uplink has reached the network, unless more traffic follows
+        _schedule(_network_rtt / 2, [this, generation]() {
+            if (generation == _rrc_generation) {
+                _rrc_release();
+            }
+        });
+    } else if (flags & SIM_RAI_RELEASE_AFTER_DOWNLINK) {
+        _sockets[id].release_on_downlink = 1;
+    }
+
+    std::string ip = f[1];
+    uint16_t port = atoi(f[2].c_str());
+    // the peer in place when the datagram leaves is the one receiving it
+    peer_t peer = _peer;
+    _schedule(_network_rtt, [this, peer, id, ip, port, data]() {
+        if (peer) {
+            peer(*this, id, ip, port, data);
+        }
+    });
+}
+
+void BC95Simulator::_handle_natspeed(const std::string &args) {
+    // <baud_rate>,<timeout>,<store>,<sync_mode>[,<stopbits>[,<parity>[,<xonxoff>]]]
+    std::vector<std::string> f = _split(args, ',');
+    static const uint32_t rates[] = { 4800, 9600, 57600, 115200, 230400, 460800 };
+    uint32_t baud_rate, timeout;
+    uint8_t store, valid = 0;
+
+    if (f.size() < 4) {
+        _error();
+        return;
+    }
+
+    baud_rate = strtoul(f[0].c_str(), NULL, 10);
+    timeout = strtoul(f[1].c_str(), NULL, 10);
+    store = atoi(f[2].c_str()) != 0;
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        valid |= (rates[i] == baud_rate);
+    }
+    if (!valid || timeout > 30) {
+        _error();
+        return;
+    }
+
+    _ok();
+
+    // switch once the OK is out, back to the previous rate unless a command arrives within the timeout
+    _schedule(_tx_free - _now(), [this, baud_rate, timeout, store]() {
+        uint32_t generation = ++_natspeed_generation;
+
+        _natspeed_previous = _modem_baud;
+        _natspeed_store = store;
+        _natspeed_pending = 1;
+        _modem_baud = baud_rate;
+        if (_trace != NULL) {
+            fprintf(_trace, "[%10.3f] - UART at %u baud\n", _now() / 1000.0, baud_rate);
+        }
+
+        _schedule((uint64_t)timeout * 1000000, [this, generation]() {
+            if (_natspeed_pending && generation == _natspeed_generation) {
+                _natspeed_pending = 0;
+                _modem_baud = _natspeed_previous;
+                if (_trace != NULL) {
+                    fprintf(_trace, "[%10.3f] - UART back at %u baud\n", _now() / 1000.0, _modem_baud);
+                }
+            }
+        });
+    });
+}
+
+void BC95Simulator::_handle_nsorf(const std::string &args) {
+    std::vector<std::string> f = _split(args, ',');
+    uint8_t id;
+    size_t req;
+
+    if (f.size() != 2) {
+        _error();
+        return;
+    }
+
+    id = atoi(f[0].c_str());
+    req = atoi(f[1].c_str());
+
+    if (id >= SOCKET_IDS || !_sockets[id].open || req > SIM_NSORF_MAX_LEN) {
+        _error();
+        return;
+    }
+
+    if (!_sockets[id].rx.empty()) {
+        rx_datagram_t &d = _sockets[id].rx.front();
+        size_t len = d.data.size() < req ? d.data.size() : req;
+        size_t remaining = 0;
+
+        std::string line = f[0] + "," + d.ip + "," + std::to_string(d.port) + "," + std::to_string(len) + "," +
+                           _to_hex(d.data, 0, len) + ",";
+
+        // the unread tail of a datagram stays queued
+        d.data.erase(d.data.begin(), d.data.begin() + len);
+        if (d.data.empty()) {
+            _sockets[id].rx.pop_front();
+        }
+        for (size_t i = 0; i < _sockets[id].rx.size(); i++) {
+            remaining += _sockets[id].rx[i].data.size();
+        }
+
+        _emit(line + std::to_string(remaining));
+    }
+
+    _ok();
+}
@@ -0,0 +1,208 @@
+#ifndef __BC95_SIMULATOR_H__
+#define __BC95_SIMULATOR_H__
+
+#include <Arduino.h>
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * Simulated Quectel BC95 attached to a virtual UART.
+ *
+ * Implements the Stream interface NBIoT_BC95 expects and answers the AT
+ * commands issued by the library. Time is virtual (see host_clock_us()):
+ * host writes take one byte time at the configured baud rate, responses are
+ * scheduled after a per-command latency and become readable byte by byte.
+ * Polling an empty UART advances the clock, so timeouts elapse instantly.
+ */
+class BC95Simulator : public Stream {
+
+    public:
+
+        /* Maximum amount of sockets supported by the module */
+        static const uint8_t MAX_SOCKETS = 7;
+        /* Socket ids accepted on the AT interface, see set_first_socket_id() */
+        static const uint8_t SOCKET_IDS = 16;
+
+        typedef struct {
+            uint32_t commands;          // AT command lines received
+            uint32_t bytes_to_modem;    // host -> modem UART bytes
+            uint32_t bytes_from_modem;  // modem -> host UART bytes
+            uint32_t rrc_setups;        // idle -> RRC connected transitions
+            uint64_t connected_us;      // time spent RRC connected, up to the last release
+            uint32_t nv_writes;         // NCONFIG, QLEDMODE, NBAND and CPSMS writes
+            uint32_t framing_errors;    // bytes lost to a baud rate mismatch, either direction
+        } stats_t;
+
+        typedef std::vector<uint8_t> datagram_t;
+
+        /*
+         * Remote peer. Invoked once an uplink datagram reaches the network,
+         * it may call deliver() to produce downlink datagrams.
+         */
+        typedef std::function<void(BC95Simulator &sim, uint8_t socket, const std::string &ip,
+                                   uint16_t port, const datagram_t &data)> peer_t;
+
+        BC95Simulator(uint32_t baud_rate = 9600);
+
+        /* Stream */
+        int available(void);
+        int read(void);
+        int peek(void);
+        size_t write(uint8_t c);
+        using Print::write;
+        void flush(void) { }
+
+        /******* Configuration *******/
+
+        /* Host side UART rate. The module follows AT+NATSPEED, bytes are lost while both differ */
+        void set_baud_rate(uint32_t baud_rate);
+        uint32_t modem_baud_rate(void) const { return _modem_baud; }
+
+        /* Highest rate the wiring sustains, bytes are lost above it. 0 for no limit */
+        void set_max_baud_rate(uint32_t baud_rate) { _max_baud = baud_rate; }
+
+        /* Latency between the end of a command line and the first response byte */
+        void set_latency(const char *cmd_prefix, uint32_t latency_ms);
+        void set_default_latency(uint32_t latency_ms);
+
+        /* Network round trip used for uplink delivery, NPING and QDNS */
+        void set_network_rtt(uint32_t rtt_ms) { _network_rtt = (uint64_t)rtt_ms * 1000; }
+
+        /* RRC inactivity timer and PSM active time (T3324) after release, 0 keeps the module awake */
+        void set_inactivity_timer(uint32_t ms) { _inactivity_timer = (uint64_t)ms * 1000; }
+        void set_active_time(uint32_t ms) { _psm_active_time = (uint64_t)ms * 1000; }
+
+        /* Restart the module from power-off. Commands are ignored until the boot messages are out */
+        void power_on(void);
+        void set_boot_time(uint32_t ms) { _boot_time = (uint64_t)ms * 1000; }
+
+        void set_registered(uint8_t registered);
+        void set_attached(uint8_t attached) { _attached = attached; }
+
+        /* First id AT+NSOCR hands out, 1 by default (socket 0 belongs to the module) */
+        void set_first_socket_id(uint8_t id) { _first_socket = id; }
+        /* Sockets open on the module */
+        uint8_t open_sockets(void) const;
+
+        void set_peer(peer_t peer) { _peer = peer; }
+        static peer_t echo_peer(void);
+
+        /* Queue a downlink datagram on an open socket and notify the host */
+        void deliver(uint8_t socket, const std::string &ip, uint16_t port, const datagram_t &data);
+
+        /* Virtual time the module acts next (a byte reaches the host or a scheduled action runs), 0 if idle */
+        uint64_t next_activity_us(void) const;
+
+        /* Log every command and response line with its virtual timestamp */
+        void set_trace(FILE *out) { _trace = out; }
+
+        /******* Statistics *******/
+
+        const stats_t &stats(void) const { return _stats; }
+        /* RRC connected time up to now, including the connection in progress */
+        uint64_t connected_us(void);
+        void reset_stats(void) { memset(&_stats, 0x0, sizeof(_stats)); }
+
+    private:
+
+        typedef struct {
+            std::string ip;
+            uint16_t    port;
+            datagram_t  data;
+        } rx_datagram_t;
+
+        typedef struct {
+            uint8_t                     open;
+            uint16_t                    port;
+            uint8_t                     recv_msg;
+            uint8_t                     release_on_downlink;
+            std::deque<rx_datagram_t>   rx;
+        } socket_t;
+
+        typedef struct {
+            uint64_t    at;
+            uint8_t     c;
+        } tx_byte_t;
+
+        stats_t _stats;
+
+        uint64_t _byte_time;
+        uint32_t _host_baud;
+        uint32_t _modem_baud;
+        uint32_t _max_baud;
+        /* AT+NATSPEED switch waiting for its first command */
+        uint8_t _natspeed_pending;
+        uint8_t _natspeed_store;
+        uint32_t _natspeed_previous;
+        uint32_t _natspeed_generation;
+        uint64_t _network_rtt;
+        uint64_t _default_latency;
+        std::map<std::string, uint64_t> _latency;
+        /* AT+A;+B;+C... line being executed, one final result code for all of them */
+        uint8_t _concatenated;
+        uint8_t _concat_failed;
+
+        /* modem state */
+        uint8_t _booting;
+        uint64_t _boot_time;
+        uint8_t _cfun;
+        uint8_t _registered;
+        uint8_t _attached;
+        uint8_t _cereg_n;
+        uint8_t _cscon_n;
+        uint8_t _npsmr_n;
+        /* non-volatile settings, kept across reboots */
+        uint8_t _autoconnect;
+        uint8_t _led_mode;
+        uint8_t _psm_mode;
+        uint32_t _nv_baud;
+        uint8_t _rrc_connected;
+        uint8_t _in_psm;
+        uint32_t _rrc_generation;
+        uint64_t _rrc_connected_at;
+        uint64_t _inactivity_timer;
+        uint64_t _psm_active_time;
+        std::string _tau;
+        std::string _active_time;
+        std::string _bands;
+        socket_t _sockets[SOCKET_IDS];
+        uint8_t _first_socket;
+
+        peer_t _peer;
+
+        /* virtual UART */
+        std::string _cmd_line;
+        std::deque<tx_byte_t> _tx;
+        uint64_t _tx_free;
+        std::multimap<uint64_t, std::function<void()> > _events;
+        uint8_t _in_event;
+        uint64_t _event_time;
+
+        FILE *_trace;
+
+        uint64_t _now(void) const { return _in_event ? _event_time : host_clock_us(); }
+        void _run(void);
+        void _schedule(uint64_t delay_us, std::function<void()> action);
+        void _emit(const std::string &line);
+        void _ok(void) { if (!_concatenated) _emit("OK"); }
+        void _error(void) { if (_concatenated) _concat_failed = 1; else _emit("ERROR"); }
+
+        uint64_t _latency_of(const std::string &cmd) const;
+        uint8_t _link_ok(void) const { return _host_baud == _modem_baud && (_max_baud == 0 || _modem_baud <= _max_baud); }
+        void _handle_natspeed(const std::string &args);
+        void _handle(const std::string &cmd);
+        void _handle_nsost(const std::string &args, uint8_t with_flags);
+        void _handle_nsorf(const std::string &args);
+        void _rrc_activity(void);
+        void _rrc_release(void);
+        void _reboot(void);
+        void _boot(const char *cause);
+        void _reset_state(void);
+        void _reset_nv(void);
+};
+
+#endif // __BC95_SIMULATOR_H__
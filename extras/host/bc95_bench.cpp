@@ -0,0 +1,552 @@
+/*
+ * AT round-trip benchmark of NBIoT_BC95 against the simulated modem.
+ *
+ * For every measured call reports the amount of AT command lines issued, the
+ * UART bytes in both directions, the virtual (modem) time and the host wall
+ * time spent in the library. Set BC95_SIM_TRACE to log the AT exchange.
+ */
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include <NBIoT_BC95.h>
+#include <NBIoT_BC95_Batch.h>
+#include "BC95Simulator.h"
+
+#define BENCH_REMOTE_IP         "192.0.2.10"
+#define BENCH_REMOTE_HOST       "collector.example.com"
+#define BENCH_NX_HOST           "collector.invalid"
+#define BENCH_REMOTE_PORT       (5000)
+#define BENCH_PAYLOAD_SIZE      (64)
+#define BENCH_LARGE_PAYLOAD     (BC95_NSOST_MAX_PAYLOAD_SIZE)
+#define BENCH_ITERATIONS        (10)
+#define BENCH_IDLE_MS           (1000)
+#define BENCH_FLOWS             (3)
+#define BENCH_FLOW_PORT         (4000)
+#define BENCH_RECORDS           (60)
+#define BENCH_RECORD_SIZE       (20)
+#define BENCH_RECORD_PERIOD_MS  (30000)
+// a burst ends by age before the datagram fills up (12 records)
+#define BENCH_RECORD_MAX_AGE_MS (300000)
+
+/* Accumulates the cost of repeated calls of one operation */
+class BenchOp {
+
+    public:
+
+        BenchOp(BC95Simulator &sim, const char *name) : _sim(sim), _name(name), _calls(0), _commands(0),
+            _tx(0), _rx(0), _rrc(0), _connected_us(0), _virtual_us(0), _wall_us(0), _result(0) { }
+
+        void run(std::function<long(void)> op) {
+            BC95Simulator::stats_t before = _sim.stats();
+            uint64_t vstart = host_clock_us();
+            uint64_t cstart = _sim.connected_us();
+            std::chrono::steady_clock::time_point wstart = std::chrono::steady_clock::now();
+
+            _result = op();
+
+            _wall_us += std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - wstart).count();
+            _virtual_us += host_clock_us() - vstart;
+            _commands += _sim.stats().commands - before.commands;
+            _tx += _sim.stats().bytes_to_modem - before.bytes_to_modem;
+            _rx += _sim.stats().bytes_from_modem - before.bytes_from_modem;
+            _rrc += _sim.stats().rrc_setups - before.rrc_setups;
+            _connected_us += _sim.connected_us() - cstart;
+            _calls++;
+        }
+
+        void report(void) const {
+            double n = _calls ? _calls : 1;
+
+            printf("%-34s %8.1f %9.1f %9.1f %6.1f %12.1f %12.1f %10.1f %6ld\n", _name,
+                   _commands / n, _tx / n, _rx / n, _rrc / n, _connected_us / 1000.0 / n, _virtual_us / 1000.0 / n,
+                   _wall_us / n, _result);
+        }
+
+        static void header(const char *title) {
+            printf("\n== %s ==\n", title);
+            printf("%-34s %8s %9s %9s %6s %12s %12s %10s %6s\n",
+                   "operation", "AT cmds", "UART tx", "UART rx", "RRC", "connected ms", "virtual ms", "wall us", "result");
+        }
+
+    private:
+
+        BC95Simulator &_sim;
+        const char *_name;
+        uint32_t _calls;
+        uint64_t _commands, _tx, _rx, _rrc, _connected_us, _virtual_us, _wall_us;
+        long _result;
+};
+
+static uint8_t large_rx_buffer[BC95_NSORF_MAX_PAYLOAD_SIZE];
+
+/* Remote peer answering every uplink with a datagram of the largest readable size */
+static void large_reply_peer(BC95Simulator &sim, uint8_t socket, const std::string &ip, uint16_t port,
+                             const BC95Simulator::datagram_t &) {
+    sim.deliver(socket, ip, port, BC95Simulator::datagram_t(BC95_NSORF_MAX_PAYLOAD_SIZE, 0xA5));
+}
+
+/* AT+NATSPEED rates measured, with the datagram size that fills a single AT+NSOST */
+static const uint32_t bench_baud_rates[] = { 9600, 57600, 115200, 230400, 460800 };
+static const char * const bench_baud_names[][2] = {
+    { "set_baud_rate(9600)",   "255B echo round trip @ 9600" },
+    { "set_baud_rate(57600)",  "255B echo round trip @ 57600" },
+    { "set_baud_rate(115200)", "255B echo round trip @ 115200" },
+    { "set_baud_rate(230400)", "255B echo round trip @ 230400" },
+    { "set_baud_rate(460800)", "255B echo round trip @ 460800" }
+};
+#define BENCH_BAUD_RATES        (sizeof(bench_baud_rates) / sizeof(bench_baud_rates[0]))
+// the wiring of the fallback run does not sustain more than this
+#define BENCH_MAX_LINK_BAUD     (115200)
+
+/* Host UART reconfiguration, the simulator stands for the host serial port */
+static void host_baud(uint32_t baud_rate, void *ctx) {
+    ((BC95Simulator *)ctx)->set_baud_rate(baud_rate);
+}
+
+/*
+ * Idle callback standing for "sleep until the UART wakes the MCU": the clock jumps to the next byte
+ * from the module. A real MCU is woken by the millis() tick as well, this is the lower bound.
+ */
+static void sleep_until_uart(uint32_t timeout, void *ctx) {
+    uint64_t now = host_clock_us();
+    uint64_t wake = now + (uint64_t)timeout * 1000;
+    uint64_t next = ((BC95Simulator *)ctx)->next_activity_us();
+
+    if (next != 0 && next < wake) {
+        wake = next;
+    }
+    if (wake > now) {
+        host_clock_advance_us(wake - now);
+    }
+}
+
+/* Idle strategies measured while ping() waits for the echo reply */
+static const bc95_idle_mode_t bench_idle_modes[] = { BC95_IDLE_POLL, BC95_IDLE_YIELD, BC95_IDLE_CALLBACK };
+static const char * const bench_idle_names[] = { "poll", "yield()", "sleep until UART (callback)" };
+#define BENCH_IDLE_MODES        (sizeof(bench_idle_modes) / sizeof(bench_idle_modes[0]))
+#define BENCH_IDLE_RTT_MS       (2000)
+
+/* Longest time spent inside a single poll() call */
+static uint64_t async_max_stall_us = 0;
+static uint32_t async_polls = 0;
+
+/* Drive the asynchronous operation in progress to completion */
+static long async_complete(NBIoT_BC95 &bc95) {
+    bc95_op_status_t status;
+
+    do {
+        uint64_t start = host_clock_us();
+
+        status = bc95.poll();
+        async_polls++;
+        if (host_clock_us() - start > async_max_stall_us) {
+            async_max_stall_us = host_clock_us() - start;
+        }
+    } while (status == BC95_OP_PENDING);
+
+    return status == BC95_OP_DONE ? (long)bc95.get_op_result() : -1;
+}
+
+int main(void) {
+    BC95Simulator sim(9600);
+    NBIoT_BC95 bc95(&sim);
+
+    uint8_t payload[BENCH_LARGE_PAYLOAD];
+    uint8_t rx_buffer[BC95_MAX_PACKET_SIZE];
+    uint16_t rx_size = 0, pending = 0;
+    char ip[16];
+
+    if (getenv("BC95_SIM_TRACE") != NULL) {
+        sim.set_trace(stderr);
+    }
+
+    for (uint16_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)i;
+    }
+
+    printf("BC95 simulated modem @ 9600 baud, per-call averages over %u calls\n", BENCH_ITERATIONS);
+
+    BenchOp init(sim, "initialize() after power-on");
+    BenchOp open(sim, "open_socket()");
+    BenchOp send_wait(sim, "send_UDP_datagram(64B, +NSONMI)");
+    BenchOp recv(sim, "receive_UDP_datagram(64B)");
+    BenchOp send_nowait(sim, "send_UDP_datagram(64B, no wait)");
+    BenchOp send_large(sim, "send_UDP_datagram(512B, no wait)");
+    BenchOp urcs(sim, "process_urcs(10x +NSONMI)");
+    BenchOp recv_queued(sim, "receive_UDP_datagrams(10x64B)");
+    BenchOp recv_large(sim, "receive_UDP_datagram(1358B)");
+    BenchOp registered(sim, "is_registered()");
+    BenchOp assigned_ip(sim, "is_assigned_ip()");
+    BenchOp ping(sim, "ping()");
+    BenchOp health_getters(sim, "health check, one getter each");
+    BenchOp health_status(sim, "health check, get_status()");
+    BenchOp dns(sim, "query_dns(), not cached");
+    BenchOp dns_cached(sim, "query_dns(), cached");
+    BenchOp dns_nx(sim, "query_dns(), failed lookup");
+    BenchOp dns_nx_cached(sim, "query_dns(), failed lookup cached");
+    BenchOp send_hostname(sim, "send_UDP_datagram(hostname)");
+    BenchOp close(sim, "close_socket()");
+    BenchOp flows_churn(sim, "3 flows, reopen default socket");
+    BenchOp flows_table(sim, "3 flows, socket handles");
+    BenchOp records_single(sim, "60x20B, one per datagram");
+    BenchOp records_single_rai(sim, "60x20B, one per datagram, RAI");
+    BenchOp records_batch(sim, "60x20B, NBIoT_BC95_Batch, no RAI");
+    BenchOp records_batch_rai(sim, "60x20B, NBIoT_BC95_Batch");
+    BenchOp async_send(sim, "begin_send_UDP_datagram()+poll()");
+    BenchOp async_recv(sim, "begin_receive_UDP_datagram()+poll()");
+    BenchOp async_ping(sim, "begin_ping()+poll()");
+    BenchOp async_dns(sim, "begin_query_dns()+poll()");
+    BenchOp profile_first(sim, "apply_config_profile(), first run");
+    BenchOp profile_same(sim, "apply_config_profile(), unchanged");
+    BenchOp config_legacy(sim, "config_psm()+set_bands()");
+    std::vector<BenchOp> baud_switch, baud_echo;
+    BenchOp baud_fail(sim, "set_baud_rate(460800) rolled back");
+    BenchOp baud_negotiate(sim, "negotiate_baud_rate(460800)");
+
+    sim.power_on();
+    init.run([&]() { return (long)bc95.initialize(); });
+    open.run([&]() { return (long)bc95.open_socket(); });
+
+    // echo round trips: uplink, wait for +NSONMI, read the echoed datagram
+    for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+        send_wait.run([&]() {
+            return (long)bc95.send_UDP_datagram(BENCH_REMOTE_IP, BENCH_REMOTE_PORT, payload, BENCH_PAYLOAD_SIZE, &pending);
+        });
+        recv.run([&]() {
+            bc95.receive_UDP_datagram(rx_buffer, &rx_size);
+            return (long)rx_size;
+        });
+    }
+
+    // fire-and-forget uplinks, spaced so that the echoes land between calls
+    for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+        send_nowait.run([&]() {
+            return (long)bc95.send_UDP_datagram(BENCH_REMOTE_IP, BENCH_REMOTE_PORT, payload, BENCH_PAYLOAD_SIZE, NULL, 0);
+        });
+        delay(BENCH_IDLE_MS);
+    }
+
+    // the +NSONMI reports of those echoes announce the queued data without any AT command
+    urcs.run([&]() { bc95.process_urcs(); return (long)bc95.get_pending_bytes(); });
+
+    // read back the echoes queued by the previous run in one burst
+    recv_queued.run([&]() { return (long)bc95.receive_UDP_datagrams(NULL, rx_buffer, sizeof(rx_buffer)); });
+
+    // largest downlink readable by AT+NSORF
+    sim.set_peer(large_reply_peer);
+    for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+        bc95.send_UDP_datagram(BENCH_REMOTE_IP, BENCH_REMOTE_PORT, payload, BENCH_PAYLOAD_SIZE, &pending);
+        recv_large.run([&]() {
+            bc95.receive_UDP_datagram(large_rx_buffer, &rx_size, sizeof(large_rx_buffer));
+            return (long)rx_size;
+        });
+    }
+
+    // largest uplink accepted by AT+NSOST, not echoed back
+    sim.set_peer(BC95Simulator::peer_t());
+    for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+        send_large.run([&]() {
+            return (long)bc95.send_UDP_datagram(BENCH_REMOTE_IP, BENCH_REMOTE_PORT, payload, BENCH_LARGE_PAYLOAD, NULL, 0);
+        });
+    }
+    delay(BENCH_IDLE_MS);
+    sim.set_peer(BC95Simulator::echo_peer());
+
+    for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+        registered.run([&]() { return (long)bc95.is_registered(); });
+        assigned_ip.run([&]() { return (long)bc95.is_assigned_ip(); });
+        ping.run([&]() { return (long)bc95.ping(BENCH_REMOTE_IP); });
+        // registration, attachment, PSM, signal and address
+        health_getters.run([&]() {
+            return (long)(bc95.is_registered() + bc95.is_attached() + !bc95.is_psm_enabled() +
+                          (bc95.get_signal_strength() != 0) + bc95.is_assigned_ip());
+        });
+        health_status.run([&]() {
+            bc95_status_t status;
+
+            return bc95.get_status(&status) ? (long)(status.registered + status.attached + !status.psm +
+                                                     (status.rssi != 0) + (status.ip_address[0] != '\0')) : -1;
+        });
+    }
+
+    // resolver cache: every lookup of the first row goes to the module
+    for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+        bc95.flush_dns_cache();
+        dns.run([&]() { return (long)bc95.query_dns(BENCH_REMOTE_HOST, ip); });
+        dns_cached.run([&]() { return (long)bc95.query_dns(BENCH_REMOTE_HOST, ip); });
+        dns_nx.run([&]() { return (long)bc95.query_dns(BENCH_NX_HOST, ip); });
+        dns_nx_cached.run([&]() { return (long)bc95.query_dns(BENCH_NX_HOST, ip); });
+        send_hostname.run([&]() {
+            return (long)bc95.send_UDP_datagram(BENCH_REMOTE_HOST, BENCH_REMOTE_PORT, payload, BENCH_PAYLOAD_SIZE, NULL, 0);
+        });
+    }
+    delay(BENCH_IDLE_MS);
+    bc95.process_urcs();
+    bc95.receive_UDP_datagrams(NULL, rx_buffer, sizeof(rx_buffer));
+
+    for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+        async_send.run([&]() {
+            return bc95.begin_send_UDP_datagram(BENCH_REMOTE_IP, BENCH_REMOTE_PORT, payload, BENCH_PAYLOAD_SIZE, &pending) ?
+                   async_complete(bc95) : -1;
+        });
+        async_recv.run([&]() {
+            return bc95.begin_receive_UDP_datagram(rx_buffer, &rx_size) ? async_complete(bc95) : -1;
+        });
+        async_ping.run([&]() { return bc95.begin_ping(BENCH_REMOTE_IP) ? async_complete(bc95) : -1; });
+        bc95.flush_dns_cache();
+        async_dns.run([&]() { return bc95.begin_query_dns(BENCH_REMOTE_HOST, ip) ? async_complete(bc95) : -1; });
+    }
+
+    close.run([&]() { return (long)bc95.close_socket(); });
+
+    // one echo round trip per flow (telemetry, config, time), each with its own listen port
+    sim.set_peer(BC95Simulator::peer_t());
+    for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+        flows_churn.run([&]() {
+            long sent = 0;
+
+            for (uint8_t f = 0; f < BENCH_FLOWS; f++) {
+                bc95.open_socket(BENCH_FLOW_PORT + f);
+                sent += bc95.send_UDP_datagram(BENCH_REMOTE_IP, BENCH_REMOTE_PORT, payload, BENCH_PAYLOAD_SIZE, NULL, 0);
+                bc95.close_socket();
+            }
+            return sent;
+        });
+    }
+
+    uint8_t flow_socket[BENCH_FLOWS];
+    for (uint8_t f = 0; f < BENCH_FLOWS; f++) {
+        bc95.create_socket(&flow_socket[f], BENCH_FLOW_PORT + f);
+    }
+    for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+        flows_table.run([&]() {
+            long sent = 0;
+
+            for (uint8_t f = 0; f < BENCH_FLOWS; f++) {
+                sent += bc95.send_UDP_datagram(flow_socket[f], BENCH_REMOTE_IP, BENCH_REMOTE_PORT, payload,
+                                               BENCH_PAYLOAD_SIZE, NULL, 0);
+            }
+            return sent;
+        });
+    }
+    for (uint8_t f = 0; f < BENCH_FLOWS; f++) {
+        bc95.close_socket(flow_socket[f]);
+    }
+
+    // sensor records sampled every BENCH_RECORD_PERIOD_MS, longer than the RRC inactivity timer
+    bc95.open_socket();
+    for (uint8_t rai = 0; rai <= 1; rai++) {
+        (rai ? records_single_rai : records_single).run([&]() {
+            long sent = 0;
+
+            for (uint16_t i = 0; i < BENCH_RECORDS; i++) {
+                sent += bc95.send_UDP_datagram(BENCH_REMOTE_IP, BENCH_REMOTE_PORT, payload, BENCH_RECORD_SIZE, NULL, 0,
+                                               rai ? BC95_RELEASE_AFTER_UPLINK : BC95_RELEASE_NONE) > 0;
+                delay(BENCH_RECORD_PERIOD_MS);
+            }
+            return sent;
+        });
+    }
+
+    NBIoT_BC95_Batch batch(&bc95, BENCH_REMOTE_IP, BENCH_REMOTE_PORT);
+    batch.set_max_age(BENCH_RECORD_MAX_AGE_MS);
+    for (uint8_t rai = 0; rai <= 1; rai++) {
+        batch.set_release(rai ? BC95_RELEASE_AFTER_UPLINK : BC95_RELEASE_NONE);
+        (rai ? records_batch_rai : records_batch).run([&]() {
+            uint32_t before = batch.get_sent_records();
+
+            for (uint16_t i = 0; i < BENCH_RECORDS; i++) {
+                batch.add(payload, BENCH_RECORD_SIZE);
+                batch.poll();
+                delay(BENCH_RECORD_PERIOD_MS);
+            }
+            batch.flush();
+            // let the last connection go idle within the measurement
+            delay(BENCH_RECORD_PERIOD_MS);
+            return (long)(batch.get_sent_records() - before);
+        });
+    }
+    bc95.close_socket();
+
+    // boot-time configuration: bands 3,8,20 and the default PSM timers of config_psm()
+    const bc95_band_t bands[] = { BC95_BAND_3, BC95_BAND_8, BC95_BAND_20 };
+    bc95_config_profile_t profile;
+    uint32_t nv_writes[3];
+    uint8_t changes = 0;
+
+    memset(&profile, 0, sizeof(profile));
+    profile.autoconnect = 1;
+    profile.nbands = sizeof(bands) / sizeof(bands[0]);
+    memcpy(profile.bands, bands, sizeof(bands));
+    profile.psm_config.psm_mode = BC95_PSM_MODE_ENABLED;
+    profile.psm_config.tau_timer_config.config.tau_multiple = BC95_TAU_10_HOURS;
+    profile.psm_config.tau_timer_config.config.tau_value = 7;
+    profile.psm_config.active_time_timer_config.config.active_time_multiple = BC95_AT_2_SECONDS;
+    profile.psm_config.active_time_timer_config.config.active_time_value = 2;
+
+    nv_writes[0] = sim.stats().nv_writes;
+    profile_first.run([&]() { bc95.apply_config_profile(&profile, &changes); return (long)changes; });
+    nv_writes[0] = sim.stats().nv_writes - nv_writes[0];
+
+    nv_writes[1] = sim.stats().nv_writes;
+    for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+        profile_same.run([&]() { bc95.apply_config_profile(&profile, &changes); return (long)changes; });
+    }
+    nv_writes[1] = sim.stats().nv_writes - nv_writes[1];
+
+    nv_writes[2] = sim.stats().nv_writes;
+    for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+        config_legacy.run([&]() { return (long)(bc95.config_psm() && bc95.set_bands(bands, profile.nbands)); });
+    }
+    nv_writes[2] = sim.stats().nv_writes - nv_writes[2];
+
+    // the same echo traffic at every rate: AT+NSOST carries 2 hex characters per byte, AT+NSORF as well
+    bc95.set_baud_callback(host_baud, &sim);
+    sim.set_peer(BC95Simulator::echo_peer());
+    bc95.open_socket();
+    baud_switch.reserve(BENCH_BAUD_RATES);
+    baud_echo.reserve(BENCH_BAUD_RATES);
+    for (uint8_t r = 0; r < BENCH_BAUD_RATES; r++) {
+        baud_switch.push_back(BenchOp(sim, bench_baud_names[r][0]));
+        baud_echo.push_back(BenchOp(sim, bench_baud_names[r][1]));
+
+        baud_switch[r].run([&]() { return (long)bc95.set_baud_rate(bench_baud_rates[r]); });
+        for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+            baud_echo[r].run([&]() {
+                bc95.send_UDP_datagram(BENCH_REMOTE_IP, BENCH_REMOTE_PORT, payload, BC95_MAX_PACKET_SIZE, &pending);
+                bc95.receive_UDP_datagram(rx_buffer, &rx_size);
+                return (long)rx_size;
+            });
+        }
+    }
+
+    // wiring that loses bytes above BENCH_MAX_LINK_BAUD: the unconfirmed rate is rolled back
+    bc95.set_baud_rate(bench_baud_rates[0]);
+    sim.set_max_baud_rate(BENCH_MAX_LINK_BAUD);
+    baud_fail.run([&]() { return (long)bc95.set_baud_rate(460800); });
+    baud_negotiate.run([&]() { return (long)bc95.negotiate_baud_rate(460800); });
+    sim.set_max_baud_rate(0);
+    bc95.close_socket();
+
+#if BC95_METRICS > 0
+    // the same pings on every idle strategy, the wait for +NPING dominates
+    std::vector<BenchOp> idle_ping;
+    bc95_idle_stats_t idle[BENCH_IDLE_MODES];
+
+    sim.set_network_rtt(BENCH_IDLE_RTT_MS);
+    idle_ping.reserve(BENCH_IDLE_MODES);
+    for (uint8_t m = 0; m < BENCH_IDLE_MODES; m++) {
+        bc95_idle_stats_t before = *bc95.get_idle_stats();
+
+        idle_ping.push_back(BenchOp(sim, bench_idle_names[m]));
+        bc95.set_idle_mode(bench_idle_modes[m], sleep_until_uart, &sim);
+        for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+            idle_ping[m].run([&]() { return (long)bc95.ping(BENCH_REMOTE_IP); });
+        }
+
+        idle[m] = *bc95.get_idle_stats();
+        idle[m].waits -= before.waits;
+        idle[m].empty_polls -= before.empty_polls;
+        idle[m].wait_us -= before.wait_us;
+        idle[m].idle_us -= before.idle_us;
+    }
+    bc95.set_idle_mode(BC95_IDLE_POLL);
+#endif
+
+    BenchOp::header("session");
+    init.report();
+    printf("get_startup_time(): %u ms\n", bc95.get_startup_time());
+    open.report();
+    close.report();
+
+    BenchOp::header("datagrams");
+    send_wait.report();
+    recv.report();
+    send_nowait.report();
+    send_large.report();
+    urcs.report();
+    recv_queued.report();
+    recv_large.report();
+
+    BenchOp::header("sockets");
+    flows_churn.report();
+    flows_table.report();
+
+    BenchOp::header("telemetry batching");
+    records_single.report();
+    records_single_rai.report();
+    records_batch.report();
+    records_batch_rai.report();
+    printf("datagrams sent by the batch: %u\n", batch.get_sent_datagrams() / 2);
+
+    BenchOp::header("queries");
+    registered.report();
+    assigned_ip.report();
+    ping.report();
+    health_getters.report();
+    health_status.report();
+
+    BenchOp::header("DNS");
+    dns.report();
+    dns_cached.report();
+    dns_nx.report();
+    dns_nx_cached.report();
+    send_hostname.report();
+    printf("resolver cache: %u hits, %u misses\n", bc95.get_dns_cache_hits(), bc95.get_dns_cache_misses());
+
+    BenchOp::header("asynchronous");
+    async_send.report();
+    async_recv.report();
+    async_ping.report();
+    async_dns.report();
+    printf("poll() calls: %u, longest poll() stall: %.3f ms\n", async_polls, async_max_stall_us / 1000.0);
+
+    BenchOp::header("configuration (result: changes mask)");
+    profile_first.report();
+    profile_same.report();
+    config_legacy.report();
+    printf("NV writes per call: first run %u, unchanged %.1f, re-applied %.1f\n", nv_writes[0],
+           nv_writes[1] / (double)BENCH_ITERATIONS, nv_writes[2] / (double)BENCH_ITERATIONS);
+
+    BenchOp::header("UART baud rate");
+    for (uint8_t r = 0; r < BENCH_BAUD_RATES; r++) {
+        baud_switch[r].report();
+        baud_echo[r].report();
+    }
+    baud_fail.report();
+    baud_negotiate.report();
+    printf("bytes lost to rate mismatches: %u\n", sim.stats().framing_errors);
+
+#if BC95_METRICS > 0
+    BenchOp::header("idle strategy, ping() with 2 s RTT");
+    for (uint8_t m = 0; m < BENCH_IDLE_MODES; m++) {
+        idle_ping[m].report();
+    }
+    printf("%-34s %8s %12s %12s %12s %7s\n", "strategy", "waits", "empty polls", "wait ms", "idle ms", "idle %");
+    for (uint8_t m = 0; m < BENCH_IDLE_MODES; m++) {
+        printf("%-34s %8.1f %12.1f %12.1f %12.1f %7.1f\n", bench_idle_names[m],
+               idle[m].waits / (double)BENCH_ITERATIONS, idle[m].empty_polls / (double)BENCH_ITERATIONS,
+               idle[m].wait_us / 1000.0 / BENCH_ITERATIONS, idle[m].idle_us / 1000.0 / BENCH_ITERATIONS,
+               idle[m].wait_us ? 100.0 * idle[m].idle_us / idle[m].wait_us : 0.0);
+    }
+
+    printf("\n== command metrics, whole run ==\n");
+    printf("%-10s %7s %5s %5s %9s %9s %7s %7s %7s  %s\n", "command", "count", "tmo", "err", "tx bytes", "rx bytes",
+           "min ms", "mean ms", "max ms", "<10 <30 <100 <300 <1s <3s <10s more");
+    for (uint8_t i = 0; bc95.get_command_metrics(i) != NULL; i++) {
+        const bc95_command_metrics_t *m = bc95.get_command_metrics(i);
+        uint32_t completed = m->count - m->timeouts;
+
+        printf("%-10s %7u %5u %5u %9u %9u %7u %7u %7u ", m->command, m->count, m->timeouts, m->errors,
+               m->tx_bytes, m->rx_bytes, m->latency_min, completed ? m->latency_sum / completed : 0, m->latency_max);
+        for (uint8_t b = 0; b < BC95_METRICS_BUCKETS; b++) {
+            printf(" %u", m->histogram[b]);
+        }
+        printf("\n");
+    }
+#endif
+
+    return 0;
+}
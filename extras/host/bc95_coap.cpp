@@ -0,0 +1,476 @@
+/*
+ * Loopback test of NBIoT_BC95_CoAP against a CoAP server on the simulated network.
+ *
+ *   bc95_coap [loss %] [seed]
+ *
+ * The server has its own small codec. Datagrams are lost with the given
+ * probability in each direction and downlinks are sometimes duplicated. A
+ * request that fails is started again, as an application would, up to
+ * COAP_ATTEMPTS times. The exit status is non-zero if a transfer completes
+ * with wrong contents or if a response block is handed over twice. Without
+ * loss every request must also complete at the first attempt; with loss a
+ * request may fail every attempt ("gave up"), as a long transfer does when
+ * too many of its blocks need all their retransmissions. Last, the blocking
+ * request() must give up on a server that never answers, after every
+ * retransmission, with the library waiting on a virtual time source.
+ */
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <NBIoT_BC95.h>
+#include <NBIoT_BC95_CoAP.h>
+#include "BC95Simulator.h"
+
+#define COAP_SERVER_IP          "192.0.2.20"
+#define COAP_IMAGE_SIZE         (3000)
+#define COAP_CONFIG_SIZE        (700)
+// the server sends blocks of 64 bytes at most, smaller than the client asks for
+#define COAP_SERVER_SZX         (2)
+#define COAP_SEPARATE_DELAY_US  (4000000ULL)
+#define COAP_DUPLICATE_RATE     (0.1)
+#define COAP_ATTEMPTS           (3)
+
+typedef BC95Simulator::datagram_t datagram_t;
+
+static uint32_t virtual_millis(void *) {
+    return (uint32_t)(host_clock_us() / 1000);
+}
+
+static void virtual_delay(uint32_t ms, void *) {
+    host_clock_advance_us((uint64_t)ms * 1000);
+}
+
+/* Server side view of a message */
+typedef struct {
+    uint8_t type;
+    uint8_t code;
+    uint16_t message_id;
+    datagram_t token;
+    std::vector<std::pair<uint16_t, datagram_t> > options;
+    datagram_t payload;
+} message_t;
+
+static bool decode(const datagram_t &d, message_t &m) {
+    size_t i = 4;
+    uint16_t number = 0;
+
+    if (d.size() < 4 || (d[0] >> 6) != 1 || (d[0] & 0x0F) > 8 || d.size() < 4 + (size_t)(d[0] & 0x0F)) {
+        return false;
+    }
+    m.type = (d[0] >> 4) & 0x03;
+    m.code = d[1];
+    m.message_id = (d[2] << 8) | d[3];
+    m.token.assign(d.begin() + 4, d.begin() + 4 + (d[0] & 0x0F));
+    i += m.token.size();
+
+    while (i < d.size() && d[i] != 0xFF) {
+        uint32_t delta = d[i] >> 4, length = d[i] & 0x0F;
+
+        i++;
+        if (delta == 15 || length == 15) {
+            return false;
+        }
+        if (delta == 13) { delta = 13 + d[i++]; } else if (delta == 14) { delta = 269 + (d[i] << 8) + d[i + 1]; i += 2; }
+        if (length == 13) { length = 13 + d[i++]; } else if (length == 14) { length = 269 + (d[i] << 8) + d[i + 1]; i += 2; }
+        if (i + length > d.size()) {
+            return false;
+        }
+        number += delta;
+        m.options.push_back(std::make_pair(number, datagram_t(d.begin() + i, d.begin() + i + length)));
+        i += length;
+    }
+    if (i < d.size()) {
+        m.payload.assign(d.begin() + i + 1, d.end());
+    }
+
+    return true;
+}
+
+static void put_option(datagram_t &d, uint16_t &last, uint16_t number, const datagram_t &value) {
+    uint16_t delta = number - last;
+
+    // the options this server sends are short and close together
+    d.push_back((uint8_t)(((delta < 13 ? delta : 13) << 4) | value.size()));
+    if (delta >= 13) {
+        d.push_back((uint8_t)(delta - 13));
+    }
+    d.insert(d.end(), value.begin(), value.end());
+    last = number;
+}
+
+static datagram_t uint_value(uint32_t v) {
+    datagram_t value;
+
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        if (!value.empty() || (v >> shift) != 0) {
+            value.push_back((uint8_t)(v >> shift));
+        }
+    }
+
+    return value;
+}
+
+static uint32_t option_uint(const message_t &m, uint16_t number, bool *found = NULL) {
+    for (size_t i = 0; i < m.options.size(); i++) {
+        if (m.options[i].first == number) {
+            uint32_t v = 0;
+
+            for (size_t j = 0; j < m.options[i].second.size(); j++) {
+                v = (v << 8) | m.options[i].second[j];
+            }
+            if (found != NULL) {
+                *found = true;
+            }
+            return v;
+        }
+    }
+    if (found != NULL) {
+        *found = false;
+    }
+
+    return 0;
+}
+
+static std::string joined(const message_t &m, uint16_t number, char separator) {
+    std::string s;
+
+    for (size_t i = 0; i < m.options.size(); i++) {
+        if (m.options[i].first == number) {
+            if (!s.empty()) {
+                s += separator;
+            }
+            s.append(m.options[i].second.begin(), m.options[i].second.end());
+        }
+    }
+
+    return s;
+}
+
+static uint8_t image_byte(size_t i) {
+    return (uint8_t)(i * 7 + (i >> 8));
+}
+
+/* CoAP server on a lossy network */
+class Server {
+
+    public:
+
+        Server(double loss, uint32_t seed) : _loss(loss), _rng(seed), _coin(0.0, 1.0) { }
+
+        void uplink(BC95Simulator &sim, uint8_t socket, const std::string &ip, uint16_t port, const datagram_t &data) {
+            message_t m;
+
+            _sim = &sim;
+            _socket = socket;
+            _ip = ip;
+            _port = port;
+
+            if (silent || _lost() || !decode(data, m)) {
+                return;
+            }
+            requests++;
+
+            if (m.type == 2 || m.type == 3) {
+                // ACK or RST of a separate response
+                if (_separate.size() > 0 && _separate[2] == (m.message_id >> 8) && _separate[3] == (uint8_t)m.message_id) {
+                    _separate.clear();
+                }
+                return;
+            }
+
+            // a retransmitted request gets the same response again
+            std::map<uint16_t, datagram_t>::const_iterator cached = _responses.find(m.message_id);
+            if (cached != _responses.end()) {
+                _send(cached->second);
+                return;
+            }
+
+            datagram_t response = _handle(m);
+            _responses[m.message_id] = response;
+            _send(response);
+        }
+
+        /* Separate responses, sent and retransmitted as time goes by */
+        void tick(void) {
+            uint64_t now = host_clock_us();
+
+            if (!_separate.empty() && now >= _separate_due) {
+                if (_separate_transmissions++ > 4) {
+                    _separate.clear();
+                } else {
+                    // as if a retransmission crossed the ACK: the client must acknowledge both, hand over one
+                    _send(_separate, true);
+                    _separate_due = now + (2000000ULL << _separate_transmissions);
+                }
+            }
+        }
+
+        datagram_t config;
+        std::string last_query;
+        bool silent = false;
+        uint32_t requests = 0;
+
+    private:
+
+        double _loss;
+        std::mt19937 _rng;
+        std::uniform_real_distribution<double> _coin;
+        std::map<uint16_t, datagram_t> _responses;
+
+        BC95Simulator *_sim = NULL;
+        uint8_t _socket = 0;
+        std::string _ip;
+        uint16_t _port = 0;
+
+        datagram_t _separate;
+        uint64_t _separate_due = 0;
+        uint8_t _separate_transmissions = 0;
+        uint16_t _next_id = 0x4000;
+
+        bool _lost(void) { return _coin(_rng) < _loss; }
+
+        void _send(const datagram_t &d, bool duplicate = false) {
+            if (!_lost()) {
+                _sim->deliver(_socket, _ip, _port, d);
+                if (duplicate || _coin(_rng) < COAP_DUPLICATE_RATE) {
+                    _sim->deliver(_socket, _ip, _port, d);
+                }
+            }
+        }
+
+        static datagram_t _header(uint8_t type, uint8_t code, uint16_t message_id, const datagram_t &token) {
+            datagram_t d;
+
+            d.push_back((uint8_t)(0x40 | (type << 4) | token.size()));
+            d.push_back(code);
+            d.push_back((uint8_t)(message_id >> 8));
+            d.push_back((uint8_t)message_id);
+            d.insert(d.end(), token.begin(), token.end());
+
+            return d;
+        }
+
+        datagram_t _handle(const message_t &m) {
+            std::string path = joined(m, BC95_COAP_OPTION_URI_PATH, '/');
+            uint8_t type = (m.type == 0) ? 2 : 1;
+            uint16_t message_id = (m.type == 0) ? m.message_id : _next_id++;
+            uint16_t last = 0;
+            datagram_t d;
+            bool found;
+
+            last_query = joined(m, BC95_COAP_OPTION_URI_QUERY, '&');
+
+            if (path == "fw/image" && m.code == 1) {
+                uint32_t block2 = option_uint(m, BC95_COAP_OPTION_BLOCK2);
+                uint32_t offset = (block2 >> 4) << ((block2 & 0x07) + 4);
+                uint8_t szx = (block2 & 0x07) < COAP_SERVER_SZX ? (block2 & 0x07) : COAP_SERVER_SZX;
+                uint32_t size = 16U << szx;
+
+                if (offset >= COAP_IMAGE_SIZE) {
+                    return _header(type, BC95_COAP_CODE(4, 2), message_id, m.token);
+                }
+                d = _header(type, BC95_COAP_CODE(2, 5), message_id, m.token);
+                put_option(d, last, BC95_COAP_OPTION_CONTENT_FORMAT, uint_value(BC95_COAP_FORMAT_OCTET_STREAM));
+                put_option(d, last, BC95_COAP_OPTION_BLOCK2,
+                           uint_value(((offset / size) << 4) | ((offset + size < COAP_IMAGE_SIZE) << 3) | szx));
+                d.push_back(0xFF);
+                for (uint32_t i = offset; i < offset + size && i < COAP_IMAGE_SIZE; i++) {
+                    d.push_back(image_byte(i));
+                }
+                return d;
+            }
+
+            if (path == "config" && m.code == 3) {
+                uint32_t block1 = option_uint(m, BC95_COAP_OPTION_BLOCK1, &found);
+                uint32_t offset = found ? (block1 >> 4) << ((block1 & 0x07) + 4) : 0;
+                bool more = found && (block1 & 0x08);
+
+                if (offset == 0) {
+                    config.clear();
+                }
+                if (offset != config.size()) {
+                    return _header(type, BC95_COAP_CODE(4, 8), message_id, m.token);
+                }
+                config.insert(config.end(), m.payload.begin(), m.payload.end());
+
+                d = _header(type, more ? BC95_COAP_CONTINUE : BC95_COAP_CODE(2, 4), message_id, m.token);
+                if (found) {
+                    put_option(d, last, BC95_COAP_OPTION_BLOCK1, uint_value(block1));
+                }
+                return d;
+            }
+
+            if (path == "slow" && m.type == 0) {
+                // empty ACK now, the response as a confirmable message of its own later
+                _separate = _header(0, BC95_COAP_CODE(2, 5), _next_id++, m.token);
+                _separate.push_back(0xFF);
+                _separate.insert(_separate.end(), (const uint8_t *)"later", (const uint8_t *)"later" + 5);
+                _separate_due = host_clock_us() + COAP_SEPARATE_DELAY_US;
+                _separate_transmissions = 0;
+                return _header(2, BC95_COAP_EMPTY, m.message_id, datagram_t());
+            }
+
+            if (path == "time") {
+                d = _header(type, BC95_COAP_CODE(2, 5), message_id, m.token);
+                d.push_back(0xFF);
+                d.insert(d.end(), (const uint8_t *)"12:00", (const uint8_t *)"12:00" + 5);
+                return d;
+            }
+
+            return _header(type, BC95_COAP_CODE(4, 4), message_id, m.token);
+        }
+};
+
+/* Response blocks put back together */
+typedef struct {
+    datagram_t data;
+    uint8_t code;
+    uint32_t handed_twice;
+    uint32_t handovers;
+} transfer_t;
+
+static void collect(const bc95_coap_response_t *response, void *ctx) {
+    transfer_t *t = (transfer_t *)ctx;
+
+    t->handovers++;
+
+    // a new attempt starts over, any other offset than the next one is a block handed over twice
+    if (response->offset == 0) {
+        t->data.clear();
+    } else if (response->offset != t->data.size()) {
+        t->handed_twice++;
+        return;
+    }
+    t->data.insert(t->data.end(), response->payload, response->payload + response->payload_size);
+    t->code = response->code;
+}
+
+typedef struct {
+    const char *name;
+    bc95_coap_method_t method;
+    const char *path;
+    bc95_coap_type_t type;
+} exchange_t;
+
+int main(int argc, char **argv) {
+    double loss = (argc > 1) ? atof(argv[1]) / 100.0 : 0.0;
+    uint32_t seed = (argc > 2) ? (uint32_t)atoi(argv[2]) : 1;
+    BC95Simulator sim(9600);
+    NBIoT_BC95 bc95(&sim);
+    NBIoT_BC95_CoAP coap(&bc95, COAP_SERVER_IP);
+    Server server(loss, seed);
+    datagram_t config(COAP_CONFIG_SIZE);
+    transfer_t transfer;
+    uint8_t ok = 1;
+
+    const exchange_t exchanges[] = {
+        { "GET Block2 image",           BC95_COAP_GET,  "/fw/image?v=3&part=all",   BC95_COAP_CON },
+        { "PUT Block1 config",          BC95_COAP_PUT,  "config",                   BC95_COAP_CON },
+        { "GET separate response",      BC95_COAP_GET,  "slow",                     BC95_COAP_CON },
+        { "GET non-confirmable",        BC95_COAP_GET,  "time",                     BC95_COAP_NON },
+        { "GET unknown resource",       BC95_COAP_GET,  "missing",                  BC95_COAP_CON },
+    };
+
+    if (loss < 0.0 || loss >= 1.0) {
+        fprintf(stderr, "usage: %s [loss %%] [seed]\n", argv[0]);
+        return 2;
+    }
+
+    for (size_t i = 0; i < config.size(); i++) {
+        config[i] = (uint8_t)(i ^ 0x5A);
+    }
+
+    host_clock_reset();
+    sim.set_peer([&](BC95Simulator &s, uint8_t socket, const std::string &ip, uint16_t port, const datagram_t &data) {
+        server.uplink(s, socket, ip, port, data);
+    });
+    sim.power_on();
+    if (!bc95.initialize() || !bc95.open_socket()) {
+        printf("modem setup failed\n");
+        return 1;
+    }
+    coap.set_response_handler(collect, &transfer);
+
+    printf("%.0f%% loss each way, %.0f%% of downlinks duplicated\n", loss * 100.0, COAP_DUPLICATE_RATE * 100.0);
+    printf("%-24s %8s %6s %10s %8s %8s %6s %8s\n", "exchange", "attempts", "code", "virtual s", "messages", "resent",
+           "dups", "result");
+
+    for (size_t e = 0; e < sizeof(exchanges) / sizeof(exchanges[0]); e++) {
+        const exchange_t &x = exchanges[e];
+        const uint8_t *payload = (x.method == BC95_COAP_PUT) ? &config[0] : NULL;
+        uint16_t payload_size = (x.method == BC95_COAP_PUT) ? config.size() : 0;
+        uint32_t messages = coap.get_sent_messages(), resent = coap.get_retransmissions(), dups = coap.get_duplicates();
+        uint64_t start = host_clock_us();
+        uint8_t attempt = 0, passed;
+        bc95_op_status_t status = BC95_OP_FAILED;
+
+        transfer.data.clear();
+        transfer.code = 0;
+        transfer.handed_twice = 0;
+        transfer.handovers = 0;
+
+        while (status != BC95_OP_DONE && attempt++ < COAP_ATTEMPTS) {
+            if (!coap.begin_request(x.method, x.path, payload, payload_size, BC95_COAP_FORMAT_OCTET_STREAM, x.type)) {
+                break;
+            }
+            do {
+                server.tick();
+                status = coap.poll();
+            } while (status == BC95_OP_PENDING);
+        }
+
+        passed = transfer.handed_twice == 0 && (status != BC95_OP_DONE || transfer.code == coap.get_response_code());
+        if (status != BC95_OP_DONE) {
+            passed = passed && loss > 0.0;
+        } else if (passed && loss == 0.0 && attempt > 1) {
+            passed = 0;
+        } else if (passed && e == 0) {
+            passed = transfer.data.size() == COAP_IMAGE_SIZE && server.last_query == "v=3&part=all";
+            for (size_t i = 0; i < transfer.data.size() && passed; i++) {
+                passed = transfer.data[i] == image_byte(i);
+            }
+        } else if (passed && e == 1) {
+            passed = coap.get_response_code() == BC95_COAP_CODE(2, 4) && server.config == config;
+        } else if (passed && e == 2) {
+            passed = transfer.data == datagram_t((const uint8_t *)"later", (const uint8_t *)"later" + 5) &&
+                     transfer.handovers <= attempt && coap.get_duplicates() > dups;
+        } else if (passed && e == 4) {
+            passed = coap.get_response_code() == BC95_COAP_CODE(4, 4);
+        }
+        ok &= passed;
+
+        printf("%-24s %8u %3u.%02u %10.1f %8u %8u %6u %8s\n", x.name, attempt > COAP_ATTEMPTS ? COAP_ATTEMPTS : attempt,
+               BC95_COAP_CODE_CLASS(coap.get_response_code()), BC95_COAP_CODE_DETAIL(coap.get_response_code()),
+               (host_clock_us() - start) / 1e6, coap.get_sent_messages() - messages, coap.get_retransmissions() - resent,
+               coap.get_duplicates() - dups, !passed ? "FAIL" : status == BC95_OP_DONE ? "pass" : "gave up");
+    }
+
+    // request() waits between retransmissions through the library, which moves a virtual clock on
+    {
+        uint32_t messages = coap.get_sent_messages(), resent = coap.get_retransmissions(), dups = coap.get_duplicates();
+        uint64_t start = host_clock_us();
+        uint64_t elapsed_ms;
+        bc95_op_status_t status;
+        uint8_t passed;
+
+        bc95.set_time_source(virtual_millis, virtual_delay);
+        server.silent = true;
+        status = coap.request(BC95_COAP_GET, "time");
+        server.silent = false;
+        elapsed_ms = (host_clock_us() - start) / 1000;
+
+        // ACK_TIMEOUT, doubled at each retransmission
+        passed = status == BC95_OP_FAILED && coap.get_sent_messages() - messages == BC95_COAP_MAX_RETRANSMIT + 1 &&
+                 elapsed_ms >= BC95_COAP_ACK_TIMEOUT * ((1UL << (BC95_COAP_MAX_RETRANSMIT + 1)) - 1);
+        ok &= passed;
+
+        printf("%-24s %8u %3u.%02u %10.1f %8u %8u %6u %8s\n", "request(), no response", 1,
+               BC95_COAP_CODE_CLASS(coap.get_response_code()), BC95_COAP_CODE_DETAIL(coap.get_response_code()),
+               elapsed_ms / 1e3, coap.get_sent_messages() - messages, coap.get_retransmissions() - resent,
+               coap.get_duplicates() - dups, passed ? "pass" : "FAIL");
+    }
+
+    return ok ? 0 : 1;
+}
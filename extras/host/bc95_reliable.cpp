@@ -0,0 +1,210 @@
+/*
+ * Loopback test of NBIoT_BC95_Reliable against the simulated modem.
+ *
+ *   bc95_reliable [loss %] [messages] [seed]
+ *
+ * A receiver on the simulated network acknowledges the messages as the
+ * protocol in NBIoT_BC95_Reliable.h describes. Uplinks and acks are each lost
+ * with the given probability. Every window size runs the same messages and
+ * reports the virtual time, datagrams and retransmissions they took. The exit
+ * status is non-zero if a message was acknowledged without being received, or
+ * if a message is still unresolved when the run ends.
+ */
+#include <random>
+#include <set>
+#include <vector>
+
+#include <NBIoT_BC95.h>
+#include <NBIoT_BC95_Reliable.h>
+#include "BC95Simulator.h"
+
+#define LOOPBACK_REMOTE_IP      "192.0.2.10"
+#define LOOPBACK_REMOTE_PORT    (5000)
+#define LOOPBACK_MESSAGE_SIZE   (32)
+#define LOOPBACK_DEFAULT_COUNT  (60)
+// virtual time a message may take at most: every transmission waiting out the longest timeout
+#define LOOPBACK_MESSAGE_MAX_US ((uint64_t)BC95_RELIABLE_MAX_TRANSMISSIONS * BC95_RELIABLE_MAX_RTO * 1000)
+
+static const uint8_t loopback_windows[] = { 1, 2, 4, 8 };
+#define LOOPBACK_WINDOWS        (sizeof(loopback_windows) / sizeof(loopback_windows[0]))
+
+/* Receiving end of the protocol, with lossy links in both directions */
+class Receiver {
+
+    public:
+
+        Receiver(double loss, uint32_t seed) : _loss(loss), _rng(seed), _coin(0.0, 1.0) { }
+
+        void uplink(BC95Simulator &sim, uint8_t socket, const std::string &ip, uint16_t port,
+                    const BC95Simulator::datagram_t &data) {
+            uint8_t seq, d;
+            BC95Simulator::datagram_t ack(BC95_RELIABLE_ACK_HEADER_SIZE);
+
+            if (_lost() || data.size() < BC95_RELIABLE_DATA_HEADER_SIZE || data[0] != BC95_RELIABLE_DATA) {
+                return;
+            }
+            seq = data[1];
+            d = (uint8_t)(seq - _next);
+
+            if (d >= 128) {
+                // already received, the ack was lost
+                duplicates++;
+            } else {
+                if (d > 8) {
+                    // the sender gave up on the messages before seq - 8
+                    _skip((uint8_t)(d - 8));
+                    d = (uint8_t)(seq - _next);
+                }
+                if (d == 0 || !(_sack & (1 << (d - 1)))) {
+                    received.insert(_message_id(data));
+                    if (d == 0) {
+                        while (_step());
+                    } else {
+                        _sack |= 1 << (d - 1);
+                    }
+                } else {
+                    duplicates++;
+                }
+            }
+
+            ack[0] = BC95_RELIABLE_ACK;
+            ack[1] = _next;
+            ack[2] = _sack;
+            if (!_lost()) {
+                sim.deliver(socket, ip, port, ack);
+            }
+        }
+
+        std::set<uint32_t> received;
+        uint32_t duplicates = 0;
+
+    private:
+
+        double _loss;
+        std::mt19937 _rng;
+        std::uniform_real_distribution<double> _coin;
+        uint8_t _next = 0;
+        uint8_t _sack = 0;
+
+        bool _lost(void) { return _coin(_rng) < _loss; }
+
+        /* Move next up by one, true if the new next had been received out of order */
+        bool _step(void) {
+            bool received_next = _sack & 1;
+
+            _sack >>= 1;
+            _next++;
+
+            return received_next;
+        }
+
+        void _skip(uint8_t n) {
+            bool received_next = false;
+
+            while (n-- > 0) {
+                received_next = _step();
+            }
+            while (received_next && _step());
+        }
+
+        static uint32_t _message_id(const BC95Simulator::datagram_t &data) {
+            uint32_t id = 0;
+
+            for (uint8_t i = 0; i < 4; i++) {
+                id |= (uint32_t)data[BC95_RELIABLE_DATA_HEADER_SIZE + i] << (8 * i);
+            }
+
+            return id;
+        }
+};
+
+typedef struct {
+    std::set<uint16_t> acknowledged;
+    std::set<uint16_t> failed;
+} outcome_t;
+
+static void delivered(uint16_t message_id, bc95_op_status_t status, void *ctx) {
+    outcome_t *outcome = (outcome_t *)ctx;
+
+    (status == BC95_OP_DONE ? outcome->acknowledged : outcome->failed).insert(message_id);
+}
+
+static uint8_t run(uint8_t window, double loss, uint32_t count, uint32_t seed) {
+    BC95Simulator sim(9600);
+    NBIoT_BC95 bc95(&sim);
+    NBIoT_BC95_Reliable link(&bc95, LOOPBACK_REMOTE_IP, LOOPBACK_REMOTE_PORT);
+    Receiver receiver(loss, seed);
+    outcome_t outcome;
+    uint8_t message[LOOPBACK_MESSAGE_SIZE] = {};
+    uint32_t sent = 0;
+    uint64_t start, rrc_setups;
+    uint8_t ok = 1;
+
+    host_clock_reset();
+    sim.set_peer([&](BC95Simulator &s, uint8_t socket, const std::string &ip, uint16_t port,
+                     const BC95Simulator::datagram_t &data) { receiver.uplink(s, socket, ip, port, data); });
+    sim.power_on();
+    if (!bc95.initialize() || !bc95.open_socket()) {
+        printf("window %u: modem setup failed\n", window);
+        return 0;
+    }
+
+    link.set_window(window);
+    link.set_delivery_callback(delivered, &outcome);
+    start = host_clock_us();
+    rrc_setups = sim.stats().rrc_setups;
+
+    while ((sent < count || link.get_in_flight() > 0) && host_clock_us() - start < count * LOOPBACK_MESSAGE_MAX_US) {
+        if (sent < count && link.can_send()) {
+            // the message carries its number, the receiver tells duplicates apart by it
+            for (uint8_t i = 0; i < 4; i++) {
+                message[i] = (uint8_t)(sent >> (8 * i));
+            }
+            link.send(message, sizeof(message));
+            sent++;
+        } else {
+            link.poll();
+        }
+    }
+
+    for (std::set<uint16_t>::const_iterator it = outcome.acknowledged.begin(); it != outcome.acknowledged.end(); ++it) {
+        if (receiver.received.count(*it) == 0) {
+            printf("window %u: message %u acknowledged but never received\n", window, *it);
+            ok = 0;
+        }
+    }
+    if (outcome.acknowledged.size() + outcome.failed.size() != count) {
+        printf("window %u: %zu messages unresolved\n", window, count - outcome.acknowledged.size() - outcome.failed.size());
+        ok = 0;
+    }
+
+    printf("%6u %10.1f %8u %8u %8zu %8zu %8zu %6u %8llu %8u %8u\n", window, (host_clock_us() - start) / 1e6,
+           link.get_sent_datagrams(), link.get_retransmissions(), outcome.acknowledged.size(), outcome.failed.size(),
+           receiver.received.size(), receiver.duplicates, (unsigned long long)(sim.stats().rrc_setups - rrc_setups),
+           link.get_srtt(), link.get_rto());
+
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    double loss = (argc > 1) ? atof(argv[1]) / 100.0 : 0.0;
+    uint32_t count = (argc > 2) ? (uint32_t)atoi(argv[2]) : LOOPBACK_DEFAULT_COUNT;
+    uint32_t seed = (argc > 3) ? (uint32_t)atoi(argv[3]) : 1;
+    uint8_t ok = 1;
+
+    if (loss < 0.0 || loss >= 1.0 || count == 0) {
+        fprintf(stderr, "usage: %s [loss %%] [messages] [seed]\n", argv[0]);
+        return 2;
+    }
+
+    printf("%u messages of %u bytes, %.0f%% loss each way\n", count, LOOPBACK_MESSAGE_SIZE, loss * 100.0);
+    printf("%6s %10s %8s %8s %8s %8s %8s %6s %8s %8s %8s\n", "window", "virtual s", "uplinks", "resent", "acked",
+           "failed", "received", "dups", "RRC", "srtt ms", "rto ms");
+    for (uint8_t w = 0; w < LOOPBACK_WINDOWS; w++) {
+        if (loopback_windows[w] <= BC95_RELIABLE_WINDOW) {
+            ok &= run(loopback_windows[w], loss, count, seed);
+        }
+    }
+
+    return ok ? 0 : 1;
+}
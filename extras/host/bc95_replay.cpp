@@ -0,0 +1,176 @@
+/*
+ * Capture and deterministic replay of an NBIoT_BC95 session.
+ *
+ *   bc95_replay record <trace>   run the session against the simulated modem, recorded
+ *                                through NBIoT_BC95_Trace
+ *   bc95_replay <trace> [runs]   run the same session against the recorded trace
+ *
+ * Every step prints its result and virtual time, which are the same on every
+ * replay of a trace. The exit status is non-zero if the library wrote anything
+ * the trace does not hold or left part of it unread, so a captured trace is a
+ * regression test of the parser and state machines; with runs > 1 the wall time
+ * is a benchmark of them.
+ */
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include <NBIoT_BC95.h>
+#include <NBIoT_BC95_Trace.h>
+#include "BC95Simulator.h"
+#include "BC95Replay.h"
+
+#define SESSION_REMOTE_IP       "192.0.2.10"
+#define SESSION_REMOTE_HOST     "collector.example.com"
+#define SESSION_REMOTE_PORT     (5000)
+#define SESSION_PAYLOAD_SIZE    (64)
+
+/* Trace sink writing to a file */
+class FilePrint : public Print {
+
+    public:
+
+        FilePrint(FILE *f) : _f(f) { }
+
+        size_t write(uint8_t c) { return fputc(c, _f) == EOF ? 0 : 1; }
+        size_t write(const uint8_t *buffer, size_t size) { return fwrite(buffer, 1, size, _f); }
+        void flush(void) { fflush(_f); }
+
+    private:
+
+        FILE *_f;
+};
+
+/* One step of the session: name, result and virtual time */
+typedef struct {
+    const char *name;
+    long result;
+    uint64_t virtual_us;
+} step_t;
+
+static void step(std::vector<step_t> &steps, const char *name, std::function<long(void)> op) {
+    uint64_t start = host_clock_us();
+    step_t s = { name, op(), 0 };
+
+    s.virtual_us = host_clock_us() - start;
+    steps.push_back(s);
+}
+
+/* The recorded session, replayed call for call */
+static std::vector<step_t> session(NBIoT_BC95 &bc95) {
+    std::vector<step_t> steps;
+    uint8_t payload[SESSION_PAYLOAD_SIZE];
+    uint8_t rx_buffer[BC95_MAX_PACKET_SIZE];
+    uint16_t rx_size = 0, pending = 0;
+    char ip[BC95_IP_ADDRESS_LEN];
+    bc95_status_t status;
+
+    for (uint16_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)i;
+    }
+
+    step(steps, "initialize()", [&]() { return (long)bc95.initialize(); });
+    step(steps, "open_socket()", [&]() { return (long)bc95.open_socket(); });
+    step(steps, "send_UDP_datagram(+NSONMI)", [&]() {
+        return (long)bc95.send_UDP_datagram(SESSION_REMOTE_IP, SESSION_REMOTE_PORT, payload, sizeof(payload), &pending);
+    });
+    step(steps, "receive_UDP_datagram()", [&]() {
+        return bc95.receive_UDP_datagram(rx_buffer, &rx_size, sizeof(rx_buffer)) ? (long)rx_size : -1;
+    });
+    step(steps, "get_status()", [&]() { return bc95.get_status(&status) ? (long)status.rssi : -1; });
+    step(steps, "ping()", [&]() { return (long)bc95.ping(SESSION_REMOTE_IP); });
+    step(steps, "query_dns()", [&]() { return (long)bc95.query_dns(SESSION_REMOTE_HOST, ip); });
+    step(steps, "begin_send_UDP_datagram()+poll()", [&]() {
+        bc95_op_status_t op;
+
+        if (!bc95.begin_send_UDP_datagram(SESSION_REMOTE_IP, SESSION_REMOTE_PORT, payload, sizeof(payload))) {
+            return -1L;
+        }
+        while ((op = bc95.poll()) == BC95_OP_PENDING);
+
+        return op == BC95_OP_DONE ? (long)bc95.get_op_result() : -1L;
+    });
+    step(steps, "close_socket()", [&]() { return (long)bc95.close_socket(); });
+
+    return steps;
+}
+
+static void report(const std::vector<step_t> &steps) {
+    printf("%-34s %12s %8s\n", "step", "virtual ms", "result");
+    for (size_t i = 0; i < steps.size(); i++) {
+        printf("%-34s %12.1f %8ld\n", steps[i].name, steps[i].virtual_us / 1000.0, steps[i].result);
+    }
+}
+
+static int record(const char *path) {
+    FILE *f = fopen(path, "wb");
+
+    if (f == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    BC95Simulator sim(9600);
+    FilePrint sink(f);
+    NBIoT_BC95_Trace trace(&sim, &sink);
+    NBIoT_BC95 bc95(&trace);
+
+    host_clock_reset();
+    sim.set_peer(BC95Simulator::echo_peer());
+    sim.power_on();
+
+    report(session(bc95));
+
+    trace.sync();
+    fclose(f);
+    printf("trace: %u bytes, %u UART bytes recorded\n", trace.get_trace_size(),
+           sim.stats().bytes_to_modem + sim.stats().bytes_from_modem);
+
+    return 0;
+}
+
+static int replay(const char *path, unsigned runs) {
+    std::vector<step_t> steps;
+    uint64_t wall_us = 0;
+    int ret = 0;
+
+    for (unsigned run = 0; run < runs; run++) {
+        BC95Replay uart(9600);
+        NBIoT_BC95 bc95(&uart);
+
+        host_clock_reset();
+        if (!uart.load(path)) {
+            fprintf(stderr, "%s: not a readable trace\n", path);
+            return 1;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        steps = session(bc95);
+        wall_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        if (run == 0) {
+            report(steps);
+            printf("replayed %zu of %zu records, %u divergences\n", uart.position(), uart.records(), uart.divergences());
+            if (uart.divergences() > 0) {
+                printf("first divergence: %s\n", uart.first_divergence().c_str());
+            }
+            ret = (uart.divergences() > 0 || !uart.done()) ? 1 : 0;
+        }
+    }
+
+    printf("wall time: %.1f us per replay over %u runs\n", (double)wall_us / runs, runs);
+
+    return ret;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 3 && strcmp(argv[1], "record") == 0) {
+        return record(argv[2]);
+    } else if (argc == 2 || argc == 3) {
+        return replay(argv[1], argc == 3 ? (unsigned)atoi(argv[2]) : 1);
+    }
+
+    fprintf(stderr, "usage: %s record <trace> | %s <trace> [runs]\n", argv[0], argv[0]);
+
+    return 2;
+}
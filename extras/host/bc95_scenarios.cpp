@@ -0,0 +1,492 @@
+/*
+ * Timeout and retry scenarios of NBIoT_BC95, run against the simulated modem
+ * or a UART nobody answers on.
+ *
+ *   bc95_scenarios [runs]
+ *
+ * The library runs on a virtual time source (NBIoT_BC95::set_time_source())
+ * whose delay moves the host clock on, so a 30 s timeout takes microseconds.
+ * Every scenario checks the result and the virtual time it took; the exit
+ * status is non-zero if any of them fails.
+ */
+#include <chrono>
+#include <vector>
+
+#include <NBIoT_BC95.h>
+#include <NBIoT_BC95_Batch.h>
+#include "BC95Simulator.h"
+
+#define SCENARIO_REMOTE_IP      "192.0.2.10"
+#define SCENARIO_REMOTE_HOST    "collector.example.com"
+#define SCENARIO_REMOTE_PORT    (5000)
+#define SCENARIO_PAYLOAD_SIZE   (64)
+// commands around the modelled wait, configuration after boot (AT+CFUN=1 alone takes 1.5 s)
+#define SCENARIO_SLACK_MS       (2500)
+
+/* UART with no module behind it. Unlike BC95Simulator it never moves the clock on */
+class DeadUart : public Stream {
+
+    public:
+
+        int available(void) { return 0; }
+        int read(void) { return -1; }
+        int peek(void) { return -1; }
+        size_t write(uint8_t) { return 1; }
+        using Print::write;
+        void flush(void) { }
+};
+
+/* Virtual time source on the host clock */
+static uint32_t virtual_millis(void *) {
+    return (uint32_t)(host_clock_us() / 1000);
+}
+
+static void virtual_delay(uint32_t ms, void *) {
+    host_clock_advance_us((uint64_t)ms * 1000);
+}
+
+static void sim_baud_rate(uint32_t baud_rate, void *ctx) {
+    ((BC95Simulator *)ctx)->set_baud_rate(baud_rate);
+}
+
+/* Modem under test: the library on its time source, talking to the simulator */
+class Device {
+
+    public:
+
+        Device(Stream *uart) : bc95(uart) {
+            host_clock_reset();
+            bc95.set_time_source(virtual_millis, virtual_delay);
+        }
+
+        /* Virtual milliseconds since the last call */
+        uint32_t lap(void) {
+            uint32_t now = bc95.get_millis();
+            uint32_t elapsed = now - _lap;
+
+            _lap = now;
+
+            return elapsed;
+        }
+
+        NBIoT_BC95 bc95;
+
+    private:
+
+        uint32_t _lap = 0;
+};
+
+static std::vector<const char *> failures;
+
+#define CHECK(cond) do { if (!(cond)) { failures.push_back(#cond); return false; } } while (0)
+#define CHECK_TIME(ms, expected) do { uint32_t elapsed = (ms); \
+                                          CHECK(elapsed >= (expected) && elapsed < (expected) + SCENARIO_SLACK_MS); } while (0)
+
+/* Boot the simulator and open the default socket, no peer answers uplinks */
+static bool ready(Device &b, BC95Simulator &sim) {
+    sim.set_peer([](BC95Simulator &, uint8_t, const std::string &, uint16_t, const BC95Simulator::datagram_t &) { });
+    sim.power_on();
+
+    CHECK(b.bc95.initialize());
+    CHECK(b.bc95.open_socket());
+    b.lap();
+
+    return true;
+}
+
+/******* Scenarios *******/
+
+static bool no_module_initialize(void) {
+    DeadUart uart;
+    Device b(&uart);
+
+    CHECK(!b.bc95.initialize());
+    CHECK_TIME(b.lap(), BC95_STARTUP_TIMEOUT);
+
+    return true;
+}
+
+static bool no_module_command(void) {
+    DeadUart uart;
+    Device b(&uart);
+
+    CHECK(b.bc95.get_signal_strength() == 0);
+    CHECK_TIME(b.lap(), BC95_READ_RESPONSE_TIMEOUT);
+
+    return true;
+}
+
+static bool slow_boot(void) {
+    BC95Simulator sim;
+    Device b(&sim);
+
+    sim.set_boot_time(BC95_STARTUP_TIMEOUT - 3000);
+    sim.power_on();
+
+    CHECK(b.bc95.initialize());
+    CHECK_TIME(b.bc95.get_startup_time(), BC95_STARTUP_TIMEOUT - 3000);
+
+    return true;
+}
+
+static bool boot_too_slow(void) {
+    BC95Simulator sim;
+    Device b(&sim);
+
+    sim.set_boot_time(BC95_STARTUP_TIMEOUT + 5000);
+    sim.power_on();
+
+    CHECK(!b.bc95.initialize());
+    CHECK_TIME(b.lap(), BC95_STARTUP_TIMEOUT);
+
+    return true;
+}
+
+static bool ping_unanswered(void) {
+    BC95Simulator sim;
+    Device b(&sim);
+
+    if (!ready(b, sim)) {
+        return false;
+    }
+    sim.set_network_rtt(60000);
+
+    CHECK(b.bc95.ping(SCENARIO_REMOTE_IP, 5000) == 0);
+    CHECK_TIME(b.lap(), 5000);
+
+    return true;
+}
+
+static bool dns_unanswered(void) {
+    BC95Simulator sim;
+    Device b(&sim);
+    char ip[BC95_IP_ADDRESS_LEN];
+
+    if (!ready(b, sim)) {
+        return false;
+    }
+    // the timeout counts from the last received byte, keep the RRC release report out of it
+    sim.set_inactivity_timer(0);
+    sim.set_network_rtt(60000);
+
+    CHECK(!b.bc95.query_dns(SCENARIO_REMOTE_HOST, ip));
+    CHECK_TIME(b.lap(), BC95_CONNECTION_TIMEOUT);
+
+    return true;
+}
+
+static bool downlink_missing(void) {
+    BC95Simulator sim;
+    Device b(&sim);
+    uint8_t payload[SCENARIO_PAYLOAD_SIZE] = {};
+    uint16_t pending = 1;
+
+    if (!ready(b, sim)) {
+        return false;
+    }
+
+    CHECK(b.bc95.send_UDP_datagram(SCENARIO_REMOTE_IP, SCENARIO_REMOTE_PORT, payload, sizeof(payload), &pending, 2000) ==
+          sizeof(payload));
+    CHECK(pending == 0);
+    CHECK_TIME(b.lap(), 2000);
+
+    return true;
+}
+
+static bool not_registered(void) {
+    BC95Simulator sim;
+    Device b(&sim);
+    uint8_t payload[SCENARIO_PAYLOAD_SIZE] = {};
+
+    if (!ready(b, sim)) {
+        return false;
+    }
+    sim.set_registered(0);
+    b.bc95.invalidate_link_state();
+
+    CHECK(b.bc95.send_UDP_datagram(SCENARIO_REMOTE_IP, SCENARIO_REMOTE_PORT, payload, sizeof(payload)) == 0);
+    CHECK(b.lap() < SCENARIO_SLACK_MS);
+
+    return true;
+}
+
+static bool baud_rate_fallback(void) {
+    BC95Simulator sim;
+    Device b(&sim);
+
+    if (!ready(b, sim)) {
+        return false;
+    }
+    // the wiring loses bytes above 57600: the switch is not confirmed and both sides go back
+    sim.set_max_baud_rate(57600);
+    b.bc95.set_baud_callback(sim_baud_rate, &sim);
+
+    CHECK(!b.bc95.set_baud_rate(115200));
+    CHECK(b.bc95.get_baud_rate() == 9600);
+    CHECK_TIME(b.lap(), BC95_NATSPEED_TIMEOUT * 1000UL);
+    CHECK(b.bc95.get_signal_strength() != 0);
+
+    return true;
+}
+
+static bool batch_max_age(void) {
+    BC95Simulator sim;
+    Device b(&sim);
+    NBIoT_BC95_Batch batch(&b.bc95, SCENARIO_REMOTE_IP, SCENARIO_REMOTE_PORT);
+    uint8_t record[8] = {};
+
+    if (!ready(b, sim)) {
+        return false;
+    }
+    batch.set_max_age(60000);
+
+    CHECK(batch.add(record, sizeof(record)));
+    virtual_delay(59000, NULL);
+    CHECK(batch.poll() && batch.get_sent_datagrams() == 0);
+    virtual_delay(1000, NULL);
+    CHECK(batch.poll() && batch.get_sent_datagrams() == 1);
+
+    return true;
+}
+
+static bool gather_send(void) {
+    BC95Simulator sim;
+    Device b(&sim);
+    BC95Simulator::datagram_t received;
+    static const uint8_t large[BC95_NSOST_MAX_PAYLOAD_SIZE - 1] = {};
+    const bc95_segment_t segments[] = {
+        { (const uint8_t *)"1234", 4 },
+        { NULL, 0 },
+        { (const uint8_t *)"56789", 5 }
+    };
+    const bc95_segment_t too_large[] = {
+        { large, sizeof(large) },
+    };
+    // CRC-16/CCITT-FALSE check value of "123456789"
+    const BC95Simulator::datagram_t expected = { '1', '2', '3', '4', '5', '6', '7', '8', '9', 0x29, 0xB1 };
+
+    if (!ready(b, sim)) {
+        return false;
+    }
+    sim.set_peer([&received](BC95Simulator &, uint8_t, const std::string &, uint16_t, const BC95Simulator::datagram_t &d) {
+        received = d;
+    });
+
+    CHECK(b.bc95.send_UDP_datagram(SCENARIO_REMOTE_IP, SCENARIO_REMOTE_PORT, segments, 3, NULL, 0, BC95_RELEASE_NONE,
+                                   BC95_CRC16_CCITT) == expected.size());
+    virtual_delay(1000, NULL);
+    b.bc95.process_urcs();
+    CHECK(received == expected);
+
+    CHECK(b.bc95.send_UDP_datagram(SCENARIO_REMOTE_IP, SCENARIO_REMOTE_PORT, segments, 3, NULL, 0) == 9);
+    // the check value counts towards the AT+NSOST limit
+    CHECK(b.bc95.send_UDP_datagram(SCENARIO_REMOTE_IP, SCENARIO_REMOTE_PORT, too_large, 1, NULL, 0) == sizeof(large));
+    CHECK(b.bc95.send_UDP_datagram(SCENARIO_REMOTE_IP, SCENARIO_REMOTE_PORT, too_large, 1, NULL, 0, BC95_RELEASE_NONE,
+                                   BC95_CRC16_CCITT) == 0);
+
+    return true;
+}
+
+static bool profile_psm_discard(void) {
+    BC95Simulator sim;
+    Device b(&sim);
+    bc95_config_profile_t profile = {};
+    uint32_t nv_writes;
+    uint8_t changes;
+
+    if (!ready(b, sim)) {
+        return false;
+    }
+    profile.autoconnect = 1;
+    profile.psm_config.psm_mode = BC95_PSM_MODE_ENABLED;
+    profile.psm_config.tau_timer_config.config.tau_multiple = BC95_TAU_10_HOURS;
+    profile.psm_config.tau_timer_config.config.tau_value = 7;
+    CHECK(b.bc95.apply_config_profile(&profile, &changes) && changes == BC95_CONFIG_PSM);
+
+    // AT+CPSMS=2 reads back as 0: written once, then left alone
+    profile.psm_config.psm_mode = BC95_PSM_MODE_DISABLED_AND_DISCARD_CURRENT_CONFIG;
+    CHECK(b.bc95.apply_config_profile(&profile, &changes) && changes == BC95_CONFIG_PSM);
+    nv_writes = sim.stats().nv_writes;
+    CHECK(b.bc95.apply_config_profile(&profile, &changes) && changes == BC95_CONFIG_UNCHANGED);
+    CHECK(sim.stats().nv_writes == nv_writes);
+
+    return true;
+}
+
+static bool socket_id_beyond_table(void) {
+    BC95Simulator sim;
+    Device b(&sim);
+    uint8_t socket;
+
+    if (!ready(b, sim)) {
+        return false;
+    }
+
+    // an id the socket table has no slot for fails the call, the module socket is closed again
+    sim.set_first_socket_id(BC95_MAX_SOCKETS);
+    CHECK(!b.bc95.create_socket(&socket, 6000));
+    CHECK(sim.open_sockets() == 1);
+
+    sim.set_first_socket_id(1);
+    CHECK(b.bc95.create_socket(&socket, 6000) && socket == 2);
+    CHECK(sim.open_sockets() == 2);
+
+    return true;
+}
+
+static bool pending_across_reads(void) {
+    BC95Simulator sim;
+    Device b(&sim);
+    uint8_t payload[SCENARIO_PAYLOAD_SIZE];
+    uint16_t payload_size;
+
+    if (!ready(b, sim)) {
+        return false;
+    }
+
+    // +NSONMI adds up the queued datagrams, each read takes off what it returned
+    sim.deliver(1, SCENARIO_REMOTE_IP, SCENARIO_REMOTE_PORT, BC95Simulator::datagram_t(10, 0x11));
+    sim.deliver(1, SCENARIO_REMOTE_IP, SCENARIO_REMOTE_PORT, BC95Simulator::datagram_t(20, 0x22));
+    while (b.bc95.get_pending_bytes(1) < 30 && b.bc95.wait_for_downlink(1, 1000));
+    CHECK(b.bc95.get_pending_bytes(1) == 30);
+
+    CHECK(b.bc95.receive_UDP_datagram(1, payload, &payload_size, sizeof(payload)) && payload_size == 10);
+    CHECK(b.bc95.get_pending_bytes(1) == 20);
+    CHECK(b.bc95.receive_UDP_datagram(1, payload, &payload_size, sizeof(payload)) && payload_size == 20);
+    CHECK(b.bc95.get_pending_bytes(1) == 0);
+
+    return true;
+}
+
+static void count_psm_reports(bc95_urc_t urc, uint16_t, uint16_t, void *ctx) {
+    if (urc == BC95_URC_PSM) {
+        (*(unsigned *)ctx)++;
+    }
+}
+
+static bool reporting_off(void) {
+    BC95Simulator sim;
+    Device b(&sim);
+    bc95_status_t status;
+    unsigned reports = 0;
+
+    if (!ready(b, sim)) {
+        return false;
+    }
+    b.bc95.set_urc_handler(count_psm_reports, &reports);
+
+    // the module restarts behind the library with reporting off: "+NPSMR:0" answers the query, it is no report
+    sim.set_boot_time(500);
+    sim.power_on();
+    virtual_delay(1000, NULL);
+    b.lap();
+    CHECK(!b.bc95.is_psm_enabled());
+    CHECK(b.bc95.get_status(&status) && !status.psm);
+    CHECK(b.lap() < SCENARIO_SLACK_MS);
+    CHECK(reports == 0);
+
+    return true;
+}
+
+#if BC95_METRICS > 0
+static const bc95_command_metrics_t *metrics_of(NBIoT_BC95 &bc95, const char *command) {
+    for (uint8_t i = 0; bc95.get_command_metrics(i) != NULL; i++) {
+        if (strcmp(bc95.get_command_metrics(i)->command, command) == 0) {
+            return bc95.get_command_metrics(i);
+        }
+    }
+
+    return NULL;
+}
+
+static bool compound_metrics(void) {
+    BC95Simulator sim;
+    Device b(&sim);
+    bc95_status_t status;
+    const bc95_command_metrics_t *single, *compound;
+
+    if (!ready(b, sim)) {
+        return false;
+    }
+    b.bc95.reset_metrics();
+
+    // AT+CEREG? and AT+CEREG?;+CGATT?;... go to separate entries
+    CHECK(b.bc95.is_registered());
+    CHECK(b.bc95.get_status(&status));
+    single = metrics_of(b.bc95, "CEREG?");
+    compound = metrics_of(b.bc95, "CEREG?;");
+    CHECK(single != NULL && single->count == 1);
+    CHECK(compound != NULL && compound->count == 1);
+    CHECK(compound->rx_bytes > single->rx_bytes);
+
+    return true;
+}
+#endif
+
+typedef struct {
+    const char *name;
+    bool (*run)(void);
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    { "no module, initialize()",                no_module_initialize },
+    { "no module, AT command",                  no_module_command },
+    { "boot within BC95_STARTUP_TIMEOUT",       slow_boot },
+    { "boot beyond BC95_STARTUP_TIMEOUT",       boot_too_slow },
+    { "ping(), no answer",                      ping_unanswered },
+    { "query_dns(), no answer",                 dns_unanswered },
+    { "send_UDP_datagram(), no downlink",       downlink_missing },
+    { "send_UDP_datagram(), not registered",    not_registered },
+    { "set_baud_rate(), link fails, fallback",  baud_rate_fallback },
+    { "batch flushed by maximum age",           batch_max_age },
+    { "send_UDP_datagram(), segments and CRC",  gather_send },
+    { "apply_config_profile(), PSM discard",    profile_psm_discard },
+    { "create_socket(), id beyond the table",   socket_id_beyond_table },
+    { "get_pending_bytes() across reads",       pending_across_reads },
+    { "query answers with reporting off",       reporting_off },
+#if BC95_METRICS > 0
+    { "metrics, compound command apart",        compound_metrics },
+#endif
+};
+
+int main(int argc, char **argv) {
+    unsigned runs = (argc > 1) ? (unsigned)atoi(argv[1]) : 1;
+    size_t count = sizeof(scenarios) / sizeof(scenarios[0]);
+    size_t failed = 0;
+    uint64_t virtual_us = 0;
+
+    if (runs == 0) {
+        fprintf(stderr, "usage: %s [runs]\n", argv[0]);
+        return 2;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    printf("%-42s %12s %8s\n", "scenario", "virtual ms", "result");
+    for (size_t i = 0; i < count; i++) {
+        uint64_t scenario_us = 0;
+        bool passed = true;
+
+        failures.clear();
+        for (unsigned run = 0; run < runs && passed; run++) {
+            passed = scenarios[i].run();
+            scenario_us += host_clock_us();
+        }
+        virtual_us += scenario_us;
+
+        printf("%-42s %12.1f %8s\n", scenarios[i].name, scenario_us / 1000.0 / runs, passed ? "pass" : "FAIL");
+        if (!passed) {
+            printf("    failed: %s\n", failures.back());
+            failed++;
+        }
+    }
+
+    double wall_s = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start).count() / 1e6;
+
+    printf("%zu of %zu scenarios passed, %u runs each\n", count - failed, count, runs);
+    printf("%.0f scenarios per second, %.0f virtual seconds in %.3f s\n",
+           count * runs / wall_s, virtual_us / 1e6, wall_s);
+
+    return failed > 0 ? 1 : 0;
+}
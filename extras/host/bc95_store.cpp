@@ -0,0 +1,426 @@
+/*
+ * Store-and-forward scenarios of NBIoT_BC95_Store against the simulated modem,
+ * on a file standing in for EEPROM or for NOR flash.
+ *
+ *   bc95_store
+ *
+ * A collector on the simulated network unpacks the datagrams. Coverage loss
+ * is modelled by deregistering the simulated modem; resets by a new store
+ * recovering the same file; power cuts by the file dropping every write after
+ * a given byte, at each byte of a record. The exit status is non-zero if any
+ * scenario fails.
+ */
+#include <unistd.h>
+#include <vector>
+
+#include <NBIoT_BC95.h>
+#include <NBIoT_BC95_Store.h>
+#include "BC95FileStorage.h"
+#include "BC95Simulator.h"
+
+#define STORE_REMOTE_IP         "192.0.2.10"
+#define STORE_REMOTE_PORT       (5000)
+#define STORE_FILE_SIZE         (4096)
+#define STORE_ERASE_SIZE        (256)
+#define STORE_RECORD_SIZE       (8)
+
+static char store_path[] = "/tmp/bc95_store_XXXXXX";
+
+static uint32_t virtual_millis(void *) {
+    return (uint32_t)(host_clock_us() / 1000);
+}
+
+static void virtual_delay(uint32_t ms, void *) {
+    host_clock_advance_us((uint64_t)ms * 1000);
+}
+
+/* Receiving end: the record numbers in arrival order */
+class Collector {
+
+    public:
+
+        void uplink(const BC95Simulator::datagram_t &data) {
+            size_t i = 0;
+
+            datagrams++;
+            while (i < data.size()) {
+                size_t length = data[i++];
+                uint32_t number = 0;
+
+                if (length != STORE_RECORD_SIZE || i + length > data.size()) {
+                    malformed++;
+                    return;
+                }
+                for (uint8_t b = 0; b < 4; b++) {
+                    number |= (uint32_t)data[i + b] << (8 * b);
+                }
+                records.push_back(number);
+                i += length;
+            }
+        }
+
+        /* Exactly first, first + 1, ... first + count - 1 since the last call */
+        bool received(uint32_t first, uint32_t count) {
+            bool ok = malformed == 0 && records.size() == count;
+
+            for (uint32_t i = 0; i < records.size() && ok; i++) {
+                ok = records[i] == first + i;
+            }
+            records.clear();
+
+            return ok;
+        }
+
+        std::vector<uint32_t> records;
+        uint32_t datagrams = 0;
+        uint32_t malformed = 0;
+};
+
+/* Modem on a virtual time source, and the collector behind the simulated network */
+class Device {
+
+    public:
+
+        Device() : bc95(&sim) {
+            host_clock_reset();
+            bc95.set_time_source(virtual_millis, virtual_delay);
+            sim.set_peer([this](BC95Simulator &, uint8_t, const std::string &, uint16_t, const BC95Simulator::datagram_t &d) {
+                collector.uplink(d);
+            });
+            sim.power_on();
+            ready = bc95.initialize() && bc95.open_socket();
+        }
+
+        void coverage(bool in_coverage) {
+            sim.set_registered(in_coverage);
+            bc95.invalidate_link_state();
+        }
+
+        /* Let the uplinks reach the collector */
+        void settle(void) {
+            virtual_delay(5000, NULL);
+            bc95.process_urcs();
+        }
+
+        BC95Simulator sim;
+        NBIoT_BC95 bc95;
+        Collector collector;
+        bool ready;
+};
+
+static uint8_t record_of(uint32_t number, uint8_t *record) {
+    memset(record, 0, STORE_RECORD_SIZE);
+    for (uint8_t b = 0; b < 4; b++) {
+        record[b] = (uint8_t)(number >> (8 * b));
+    }
+
+    return STORE_RECORD_SIZE;
+}
+
+static bool send_records(NBIoT_BC95_Store &store, uint32_t first, uint32_t count) {
+    uint8_t record[STORE_RECORD_SIZE];
+
+    for (uint32_t i = first; i < first + count; i++) {
+        if (!store.send(record, record_of(i, record))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static const char *failure;
+
+#define CHECK(cond) do { if (!(cond)) { failure = #cond; return false; } } while (0)
+
+/******* Scenarios *******/
+
+static bool sent_right_away(uint32_t erase_size) {
+    Device d;
+    BC95FileStorage file(store_path, STORE_FILE_SIZE, erase_size);
+    NBIoT_BC95_Store store(&d.bc95, &file, STORE_REMOTE_IP, STORE_REMOTE_PORT);
+
+    CHECK(d.ready && store.begin());
+    CHECK(send_records(store, 0, 5));
+    d.settle();
+
+    CHECK(store.get_depth() == 0 && store.get_stored_records() == 0);
+    CHECK(d.collector.received(0, 5));
+    CHECK(file.bytes_written() == 0);
+
+    return true;
+}
+
+static bool coverage_loss(uint32_t erase_size) {
+    Device d;
+    BC95FileStorage file(store_path, STORE_FILE_SIZE, erase_size);
+    NBIoT_BC95_Store store(&d.bc95, &file, STORE_REMOTE_IP, STORE_REMOTE_PORT);
+
+    CHECK(d.ready && store.begin());
+    d.coverage(false);
+    CHECK(send_records(store, 0, 60));
+    CHECK(store.get_depth() == 60 && store.get_stored_records() == 60);
+
+    // within the retry interval nothing is tried
+    d.coverage(true);
+    CHECK(store.poll() == 0);
+    virtual_delay(BC95_STORE_RETRY_INTERVAL, NULL);
+    CHECK(store.poll() == 60);
+    d.settle();
+
+    CHECK(store.get_depth() == 0);
+    CHECK(d.collector.received(0, 60));
+    // 28 records of 1 + 8 bytes to a datagram
+    CHECK(store.get_replayed_datagrams() == 3 && d.collector.datagrams == 3);
+    CHECK(file.program_errors() == 0);
+
+    return true;
+}
+
+static bool order_kept(uint32_t erase_size) {
+    Device d;
+    BC95FileStorage file(store_path, STORE_FILE_SIZE, erase_size);
+    NBIoT_BC95_Store store(&d.bc95, &file, STORE_REMOTE_IP, STORE_REMOTE_PORT);
+
+    CHECK(d.ready && store.begin());
+    d.coverage(false);
+    CHECK(send_records(store, 0, 10));
+    // back in coverage: new records queue behind the backlog instead of overtaking it
+    d.coverage(true);
+    CHECK(send_records(store, 10, 5));
+    CHECK(store.get_depth() == 15);
+    CHECK(store.flush() == 15);
+    CHECK(send_records(store, 15, 1));
+    d.settle();
+
+    CHECK(d.collector.received(0, 16));
+
+    return true;
+}
+
+static bool reset_with_backlog(uint32_t erase_size) {
+    Device d;
+    BC95FileStorage file(store_path, STORE_FILE_SIZE, erase_size);
+
+    CHECK(d.ready);
+    {
+        NBIoT_BC95_Store store(&d.bc95, &file, STORE_REMOTE_IP, STORE_REMOTE_PORT);
+
+        CHECK(store.begin());
+        d.coverage(false);
+        CHECK(send_records(store, 0, 30));
+    }
+    {
+        NBIoT_BC95_Store store(&d.bc95, &file, STORE_REMOTE_IP, STORE_REMOTE_PORT);
+
+        CHECK(store.begin() && store.get_depth() == 30);
+        d.coverage(true);
+        CHECK(store.flush() == 30);
+        // new records follow the recovered ones in the log
+        d.coverage(false);
+        CHECK(send_records(store, 30, 3));
+    }
+    {
+        NBIoT_BC95_Store store(&d.bc95, &file, STORE_REMOTE_IP, STORE_REMOTE_PORT);
+
+        CHECK(store.begin() && store.get_depth() == 3);
+        d.coverage(true);
+        CHECK(store.flush() == 3);
+    }
+    d.settle();
+
+    CHECK(d.collector.received(0, 33));
+    CHECK(file.program_errors() == 0);
+
+    return true;
+}
+
+static bool full_storage(uint32_t erase_size) {
+    Device d;
+    BC95FileStorage file(store_path, STORE_FILE_SIZE, erase_size);
+    NBIoT_BC95_Store store(&d.bc95, &file, STORE_REMOTE_IP, STORE_REMOTE_PORT);
+    uint16_t capacity;
+    uint32_t dropped;
+
+    CHECK(d.ready && store.begin());
+    capacity = store.get_capacity();
+    d.coverage(false);
+    CHECK(send_records(store, 0, capacity + 10));
+
+    // the oldest go, on flash a whole erase block for each block the head enters: two for 10 records
+    dropped = store.get_dropped_records();
+    CHECK(dropped == (erase_size == 0 ? 10 : 2 * STORE_ERASE_SIZE / BC95_STORE_SLOT_SIZE));
+    CHECK(store.get_depth() == capacity + 10 - dropped);
+
+    d.coverage(true);
+    CHECK(store.flush() == capacity + 10 - dropped);
+    d.settle();
+
+    CHECK(d.collector.received(dropped, capacity + 10 - dropped));
+    CHECK(file.program_errors() == 0);
+
+    return true;
+}
+
+static bool power_cut_while_storing(uint32_t erase_size) {
+    // every byte of the 11th record, its state and the retiring write before it
+    for (uint32_t cut = 0; cut <= BC95_STORE_SLOT_HEADER_SIZE + STORE_RECORD_SIZE + 1; cut++) {
+        Device d;
+        BC95FileStorage file(store_path, STORE_FILE_SIZE, erase_size);
+        uint16_t depth;
+
+        CHECK(d.ready);
+        {
+            NBIoT_BC95_Store store(&d.bc95, &file, STORE_REMOTE_IP, STORE_REMOTE_PORT);
+
+            CHECK(store.begin());
+            d.coverage(false);
+            CHECK(send_records(store, 0, 10));
+            file.cut_after(cut);
+            send_records(store, 10, 1);
+        }
+        {
+            BC95FileStorage rebooted(store_path, STORE_FILE_SIZE, erase_size);
+            NBIoT_BC95_Store store(&d.bc95, &rebooted, STORE_REMOTE_IP, STORE_REMOTE_PORT);
+
+            CHECK(store.begin());
+            depth = store.get_depth();
+            CHECK(depth == 10 || depth == 11);
+            CHECK(send_records(store, 11, 1));
+            d.coverage(true);
+            CHECK(store.flush() == depth + 1);
+            d.settle();
+
+            // the torn record is gone or complete, never garbage, and the log goes on after it
+            std::vector<uint32_t> expected;
+            for (uint32_t i = 0; i < depth; i++) {
+                expected.push_back(i);
+            }
+            expected.push_back(11);
+            CHECK(d.collector.malformed == 0 && d.collector.records == expected);
+            CHECK(rebooted.program_errors() == 0);
+        }
+        unlink(store_path);
+    }
+
+    return true;
+}
+
+static bool power_cut_after_send(uint32_t erase_size) {
+    Device d;
+    BC95FileStorage file(store_path, STORE_FILE_SIZE, erase_size);
+
+    CHECK(d.ready);
+    {
+        NBIoT_BC95_Store store(&d.bc95, &file, STORE_REMOTE_IP, STORE_REMOTE_PORT);
+
+        CHECK(store.begin());
+        d.coverage(false);
+        CHECK(send_records(store, 0, 20));
+        d.coverage(true);
+        // the datagram leaves, the power goes before the records are marked sent
+        file.cut_after(0);
+        store.flush();
+    }
+    {
+        BC95FileStorage rebooted(store_path, STORE_FILE_SIZE, erase_size);
+        NBIoT_BC95_Store store(&d.bc95, &rebooted, STORE_REMOTE_IP, STORE_REMOTE_PORT);
+
+        // at least once: sent again after the reset
+        CHECK(store.begin() && store.get_depth() == 20);
+        CHECK(store.flush() == 20);
+    }
+    d.settle();
+
+    CHECK(d.collector.records.size() == 40);
+    d.collector.records.erase(d.collector.records.begin(), d.collector.records.begin() + 20);
+    CHECK(d.collector.received(0, 20));
+
+    return true;
+}
+
+static bool oldest_age(uint32_t erase_size) {
+    Device d;
+    BC95FileStorage file(store_path, STORE_FILE_SIZE, erase_size);
+
+    CHECK(d.ready);
+    {
+        NBIoT_BC95_Store store(&d.bc95, &file, STORE_REMOTE_IP, STORE_REMOTE_PORT);
+
+        CHECK(store.begin() && store.get_oldest_age() == 0);
+        d.coverage(false);
+        CHECK(send_records(store, 0, 1));
+        virtual_delay(60000, NULL);
+        CHECK(send_records(store, 1, 1));
+        CHECK(store.get_oldest_age() >= 60000 && store.get_oldest_age() < 61000);
+    }
+    virtual_delay(10000, NULL);
+    {
+        NBIoT_BC95_Store store(&d.bc95, &file, STORE_REMOTE_IP, STORE_REMOTE_PORT);
+
+        // millis() of an earlier boot mean nothing: recovered records count from begin()
+        CHECK(store.begin() && store.get_oldest_age() == 0);
+        virtual_delay(5000, NULL);
+        CHECK(store.get_oldest_age() == 5000);
+    }
+
+    return true;
+}
+
+typedef struct {
+    const char *name;
+    bool (*run)(uint32_t erase_size);
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    { "in coverage, sent right away",           sent_right_away },
+    { "coverage loss, backlog replayed",        coverage_loss },
+    { "new records behind the backlog",         order_kept },
+    { "reset with a backlog",                   reset_with_backlog },
+    { "storage full, oldest dropped",           full_storage },
+    { "power cut while storing a record",       power_cut_while_storing },
+    { "power cut before marking sent",          power_cut_after_send },
+    { "oldest record age",                      oldest_age },
+};
+
+int main(void) {
+    static const uint32_t erase_sizes[] = { 0, STORE_ERASE_SIZE };
+    size_t count = sizeof(scenarios) / sizeof(scenarios[0]);
+    size_t failed = 0;
+    int fd = mkstemp(store_path);
+
+    if (fd < 0) {
+        perror("mkstemp");
+        return 2;
+    }
+    close(fd);
+
+    printf("%-40s %10s %10s\n", "scenario", "EEPROM", "flash");
+    for (size_t i = 0; i < count; i++) {
+        const char *results[2];
+        const char *first_failure = NULL;
+
+        for (uint8_t e = 0; e < 2; e++) {
+            bool passed;
+
+            // every scenario starts from blank storage
+            unlink(store_path);
+            passed = scenarios[i].run(erase_sizes[e]);
+            results[e] = passed ? "pass" : "FAIL";
+            if (!passed) {
+                first_failure = (first_failure != NULL) ? first_failure : failure;
+                failed++;
+            }
+        }
+
+        printf("%-40s %10s %10s\n", scenarios[i].name, results[0], results[1]);
+        if (first_failure != NULL) {
+            printf("    failed: %s\n", first_failure);
+        }
+    }
+    unlink(store_path);
+
+    printf("%zu of %zu runs passed\n", 2 * count - failed, 2 * count);
+
+    return failed > 0 ? 1 : 0;
+}
@@ -1,5 +1,9 @@
 #include <NBIoT_BC95.h>
 
+#if defined(__AVR__)
+#include <avr/sleep.h>
+#endif
+
 /******* Defines *******/
 #define BC95_DEFAULT_REBOOT_TIMEOUT         (10000)
 #define BC95_DEFAULT_CFUN_RESPONSE_TIMEOUT  (10000)
@@ -7,10 +11,10 @@
 #define BC95_MIN_RSP_BUF_LEN                (16)
 #define BC95_MIN_CMD_BUF_LEN                (40)
 
-/* BC95_MAX_PACKET_SIZE * 2 (payload HEX representation) */
-#define BC95_NSOST_BUFFER_LEN               (BC95_MAX_PACKET_SIZE << 1)
-#define BC95_NSORF_BUFFER_LEN               (BC95_MAX_PACKET_SIZE << 1)
-#define BC95_NSORF_MAX_BUFFER_LEN           (1358) // real max 1358 (Note: See BC95 AT Commands Manual)
+/* Payload is hex-encoded through a small chunk on its way to the UART */
+#define BC95_HEX_CHUNK_LEN                  (32)
+
+#define BC95_RX_BUFFER_MASK                 (BC95_RX_BUFFER_SIZE - 1)
 
 // BC95::Modem::readResponse() return values
 enum bc95_response_type_t {
@@ -18,7 +22,8 @@ enum bc95_response_type_t {
     BC95_RESPONSE_TYPE_OK                                         ,
     BC95_RESPONSE_TYPE_ERROR                                      ,
     BC95_RESPONSE_TYPE_TIMEOUT                                    ,
-    BC95_RESPONSE_TYPE_UNKNOWN
+    BC95_RESPONSE_TYPE_UNKNOWN                                    ,
+    BC95_RESPONSE_TYPE_NSORF                                         // +NSORF data line decoded in place
 };
 
 // EPS Network Registration Status
@@ -31,69 +36,211 @@ enum bc95_network_stat_t {
     BC95_NETWORK_STAT_REGISTERED_ROAMING
 };
 
+// Command response field types
+enum bc95_field_type_t {
+    BC95_FIELD_SKIP                                            = 0,  // present, ignored
+    BC95_FIELD_UINT                                               ,  // decimal number, up to 9 digits
+    BC95_FIELD_BITS                                               ,  // bit string (PSM timers), may be empty
+    BC95_FIELD_IPV4                                               ,  // dotted IPv4 address
+    BC95_FIELD_TEXT                                                  // rest of the line, up to the descriptor text length
+};
+
+// Command responses parsed by _parse_response(), indexes of _responses[]
+enum bc95_response_id_t {
+    BC95_RESPONSE_SOCKET                                       = 0,
+    BC95_RESPONSE_SENT                                            ,
+    BC95_RESPONSE_CEREG                                           ,
+    BC95_RESPONSE_CGATT                                           ,
+    BC95_RESPONSE_NPSMR                                           ,
+    BC95_RESPONSE_CSQ                                             ,
+    BC95_RESPONSE_CGPADDR                                         ,
+    BC95_RESPONSE_CGSN                                            ,
+    BC95_RESPONSE_NCCID                                           ,
+    BC95_RESPONSE_CCLK                                            ,
+    BC95_RESPONSE_NPING                                           ,
+    BC95_RESPONSE_QDNS                                            ,
+    BC95_RESPONSE_NBAND                                           ,
+    BC95_RESPONSE_CPSMS                                           ,
+    BC95_RESPONSE_NATSPEED                                        ,
+    BC95_RESPONSE_QLEDMODE                                        ,
+    BC95_RESPONSE_CFUN                                            ,
+    BC95_RESPONSE_COUNT
+};
+
+typedef struct {
+    char prefix[11];                            // e.g. "+CEREG:", empty for bare values
+    uint8_t min_fields;                         // fields past it are optional
+    uint8_t max_fields;                         // fields past it are ignored
+    uint8_t text_len;                           // longest BC95_FIELD_TEXT
+    uint8_t fields[BC95_RESPONSE_MAX_FIELDS];
+} bc95_response_desc_t;
+
+static const bc95_response_desc_t _responses[] PROGMEM = {
+    // <socket>
+    { "",           1, 1,                       0,  { BC95_FIELD_UINT } },
+    // <socket>,<length>
+    { "",           2, 2,                       0,  { BC95_FIELD_SKIP, BC95_FIELD_UINT } },
+    // +CEREG:<n>,<stat>[,...]
+    { "+CEREG:",    2, 2,                       0,  { BC95_FIELD_SKIP, BC95_FIELD_UINT } },
+    // +CGATT:<state>
+    { "+CGATT:",    1, 1,                       0,  { BC95_FIELD_UINT } },
+    // +NPSMR:<n>[,<mode>]
+    { "+NPSMR:",    1, 2,                       0,  { BC95_FIELD_UINT, BC95_FIELD_UINT } },
+    // +CSQ:<rssi>,<ber>
+    { "+CSQ:",      1, 2,                       0,  { BC95_FIELD_UINT, BC95_FIELD_UINT } },
+    // +CGPADDR:<cid>[,<address>], no address until the PDP context is active
+    { "+CGPADDR:",  2, 2,                       0,  { BC95_FIELD_SKIP, BC95_FIELD_IPV4 } },
+    // +CGSN:<IMEI>
+    { "+CGSN:",     1, 1, BC95_IMEI_LEN - 1,        { BC95_FIELD_TEXT } },
+    // +NCCID:<ICCID>
+    { "+NCCID:",    1, 1, BC95_ICCID_LEN - 1,       { BC95_FIELD_TEXT } },
+    // +CCLK:<yy/mm/dd,hh:mm:ss+zz>
+    { "+CCLK:",     1, 1, BC95_DATE_TIME_LEN - 1,   { BC95_FIELD_TEXT } },
+    // +NPING:<address>,<ttl>,<rtt>
+    { "+NPING:",    3, 3,                       0,  { BC95_FIELD_SKIP, BC95_FIELD_UINT, BC95_FIELD_UINT } },
+    // +QDNS:<address>
+    { "+QDNS:",     1, 1,                       0,  { BC95_FIELD_IPV4 } },
+    // +NBAND:<band>[,<band>[...]]
+    { "+NBAND:",    1, BC95_MAX_BANDS,          0,  { BC95_FIELD_UINT, BC95_FIELD_UINT, BC95_FIELD_UINT,
+                                                      BC95_FIELD_UINT, BC95_FIELD_UINT, BC95_FIELD_UINT } },
+    // +CPSMS:<mode>,[<RAU>],[<GPRS-READY>],[<TAU>],[<Active-Time>]
+    { "+CPSMS:",    1, 5,                       0,  { BC95_FIELD_UINT, BC95_FIELD_SKIP, BC95_FIELD_SKIP,
+                                                      BC95_FIELD_BITS, BC95_FIELD_BITS } },
+    // +NATSPEED:<baud_rate>,<sync_mode>,<stopbits>,<parity>,<xonxoff>
+    { "+NATSPEED:", 1, 1,                       0,  { BC95_FIELD_UINT } },
+    // +QLEDMODE:<mode>
+    { "+QLEDMODE:", 1, 1,                       0,  { BC95_FIELD_UINT } },
+    // +CFUN:<fun>
+    { "+CFUN:",     1, 1,                       0,  { BC95_FIELD_UINT } }
+};
+static_assert(sizeof(_responses) / sizeof(_responses[0]) == BC95_RESPONSE_COUNT, "_responses[] out of sync");
+
 /***** Utility Functions Definitions *****/
 
 uint8_t _is_valid_listen_port(uint16_t port);
 
 uint8_t _hex_char_to_int(const char c);
+static const char _hex_digits[] PROGMEM = "0123456789ABCDEF";
 uint8_t inline _get_bit(uint32_t num, uint8_t bit);
+#if BC95_METRICS > 0
+// Upper bounds of the command latency histogram buckets in ms, the last bucket is unbounded
+static const uint16_t _metrics_bounds[BC95_METRICS_BUCKETS - 1] PROGMEM = { 10, 30, 100, 300, 1000, 3000, 10000 };
+#endif
+// AT+NATSPEED rates, fastest first
+static const uint32_t _baud_rates[] PROGMEM = { 460800, 230400, 115200, 57600, 9600, 4800 };
 uint32_t _hr_time_2_epoch(char *hr_time_str); // convert human readable time to epoch
+uint8_t _parse_ipv4(const char *str, uint8_t *ip);
+void _format_ipv4(const uint8_t *ip, char *str);
+int8_t _csq_to_dbm(const uint32_t rssi);
 
 /***** BC95 Modem Public Functions *****/
 
 uint8_t NBIoT_BC95::initialize(void) {
+    uint32_t start = _millis();
+    uint8_t autoconnect = 0;
+    bc95_fields_t fields;
+
     _flushInput();
 
-    if (_ping_module(5)) {
-        // set echo off, led on, error report off, automatic network autoconnect on
+    if (_wait_for_ready(BC95_STARTUP_TIMEOUT)) {
+        // set echo off, led off, automatic network autoconnect on. NV settings are written only if they differ
         _is_init  = _send_command(F("ATE0"))                        && _wait_for_OK();
-        _is_init &= _send_command(F("AT+NCONFIG=autoconnect,true")) && _wait_for_OK();
-        _is_init &= _send_command(F("AT+CSCON=0"))                  && _wait_for_OK();
-        _is_init &= _send_command(F("AT+QLEDMODE=0"))               && _wait_for_OK();
-        delay(5000);
-        _is_init &= set_modem_functionality();
-
-        #if BC95_DEBUG_MODE > 0
+        _is_init &= (_read_autoconnect(&autoconnect) && autoconnect) || _set_autoconnect(1);
+        // report registration, RRC connection and PSM changes to keep the cached link state up to date
+        _is_init &= _send_command(F("AT+CEREG=1"))                  && _wait_for_OK();
+        _is_init &= _send_command(F("AT+CSCON=1"))                  && _wait_for_OK();
+        _is_init &= _send_command(F("AT+NPSMR=1"))                  && _wait_for_OK();
+        _is_init &= (_send_command(F("AT+QLEDMODE?")) && _read_response(BC95_RESPONSE_QLEDMODE, &fields) &&
+                     fields.value[0] == BC95_LED_DISABLED) || set_led_mode(BC95_LED_DISABLED);
+        // autoconnect usually has the radio up already. AT+CFUN=1 answers only once it is, no need to wait beforehand
+        _is_init &= (_send_command(F("AT+CFUN?")) && _read_response(BC95_RESPONSE_CFUN, &fields) &&
+                     fields.value[0] == BC95_MODEM_FUNCIONALITY_LEVEL_FULL) || set_modem_functionality();
+
+        #if BC95_MODULE_DEBUG > 0
             _send_command(F("AT+CMEE=1"));
             _wait_for_OK();
         #endif
     }
 
+    if (_is_init) {
+        _startup_time = _millis() - start;
+
+        #if BC95_MODULE_DEBUG > 0
+            if (_dbg != NULL) {
+                _dbg->print("startup time ");
+                _dbg->println(_startup_time);
+            }
+        #endif
+    }
+
     return _is_init;
 }
 
 /******* Data Transmission Funcions *******/
 
 uint8_t NBIoT_BC95::open_socket(const uint16_t listen_port, const uint8_t recv_msg) {
-    if (_ping_module(5)) {
-        if (!_open_soc && is_assigned_ip() && _is_valid_listen_port(listen_port)) {
-            char response_buffer[BC95_MIN_RSP_BUF_LEN];
-            char command[BC95_MIN_CMD_BUF_LEN];
-            uint16_t resp_buf_len = 0;
+    if (!_socket_open(_default_soc)) {
+        create_socket(&_default_soc, listen_port, recv_msg);
+    }
+
+    return _socket_open(_default_soc);
+}
 
-            sprintf_P(command, (PGM_P)F("AT+NSOCR=DGRAM,17,%u,%u"), listen_port, recv_msg);
+uint8_t NBIoT_BC95::close_socket(void) {
+    return close_socket(_default_soc);
+}
 
-            _send_command(command);
+uint8_t NBIoT_BC95::create_socket(uint8_t *socket, const uint16_t listen_port, const uint8_t recv_msg) {
+    uint8_t ret = 0;
 
-            if (_read_line(response_buffer, BC95_MIN_RSP_BUF_LEN, &resp_buf_len) &&
-               (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_DATA) && _wait_for_OK())
-            {
-                _open_soc = 1;
+    if (_ping_module(5)) {
+        if (is_assigned_ip() && _is_valid_listen_port(listen_port)) {
+            bc95_fields_t fields;
+            uint8_t id;
+
+            _begin_command(F("AT+NSOCR=DGRAM,17,"));
+            _command_uint(listen_port);
+            _command_str(F(","));
+            _command_uint(recv_msg);
+            _end_command();
+
+            if (_read_response(BC95_RESPONSE_SOCKET, &fields)) {
+                id = fields.value[0];
+
+                if (id < BC95_MAX_SOCKETS) {
+                    memset(&_sockets[id], 0x0, sizeof(_sockets[id]));
+                    _sockets[id].open = 1;
+                    *socket = id;
+                    ret = 1;
+                } else {
+                    // beyond the socket table: close it rather than leave it open on the module
+                    _begin_command(F("AT+NSOCL="));
+                    _command_uint(id);
+                    _end_command();
+                    _wait_for_OK();
+                }
             }
         }
     }
 
-    return _open_soc;
+    return ret;
 }
 
-uint8_t NBIoT_BC95::close_socket(void) {
+uint8_t NBIoT_BC95::close_socket(const uint8_t socket) {
     uint8_t ret = 0;
 
-    _send_command(F("AT+NSOCL=1"));
+    if (_socket_open(socket)) {
+        _begin_command(F("AT+NSOCL="));
+        _command_uint(socket);
+        _end_command();
 
-    if(_wait_for_OK()){
-        _open_soc = 0;
-        ret = 1;
+        if (_wait_for_OK()) {
+            _sockets[socket].open = 0;
+            if (socket == _default_soc) {
+                _default_soc = BC95_INVALID_SOCKET;
+            }
+            ret = 1;
+        }
     }
 
     return ret;
@@ -105,120 +252,204 @@ uint16_t NBIoT_BC95::send_UDP_datagram(
         const uint8_t *payload_out,
         const uint16_t payload_out_size,
         uint16_t *bytes_pending,
-        const uint32_t response_timeout)
+        const uint32_t response_timeout,
+        const bc95_release_t release)
+{
+    return send_UDP_datagram(_default_soc, remote_host, remote_port, payload_out, payload_out_size,
+                             bytes_pending, response_timeout, release);
+}
+
+uint16_t NBIoT_BC95::send_UDP_datagram(
+        const uint8_t socket,
+        const char *remote_host,
+        const uint16_t remote_port,
+        const uint8_t *payload_out,
+        const uint16_t payload_out_size,
+        uint16_t *bytes_pending,
+        const uint32_t response_timeout,
+        const bc95_release_t release)
+{
+    bc95_segment_t segment = { payload_out, payload_out_size };
+
+    return send_UDP_datagram(socket, remote_host, remote_port, &segment, 1, bytes_pending, response_timeout, release);
+}
+
+uint16_t NBIoT_BC95::send_UDP_datagram(
+        const char *remote_host,
+        const uint16_t remote_port,
+        const bc95_segment_t *segments,
+        const uint8_t segment_count,
+        uint16_t *bytes_pending,
+        const uint32_t response_timeout,
+        const bc95_release_t release,
+        const bc95_crc_t crc)
+{
+    return send_UDP_datagram(_default_soc, remote_host, remote_port, segments, segment_count,
+                             bytes_pending, response_timeout, release, crc);
+}
+
+uint16_t NBIoT_BC95::send_UDP_datagram(
+        const uint8_t socket,
+        const char *remote_host,
+        const uint16_t remote_port,
+        const bc95_segment_t *segments,
+        const uint8_t segment_count,
+        uint16_t *bytes_pending,
+        const uint32_t response_timeout,
+        const bc95_release_t release,
+        const bc95_crc_t crc)
 {
+    char remote_ip[BC95_IP_ADDRESS_LEN];
     uint16_t bytes_sent = 0;
-    uint16_t resp_buf_len = 0;
     if (bytes_pending != NULL) {
         *bytes_pending = 0;
     }
 
-    if (_ping_module(5)) {
-        if (_is_init && _open_soc && is_registered() && is_attached()) {
-            char response_buffer[BC95_MIN_RSP_BUF_LEN];
-            char command_buffer[BC95_NSOST_BUFFER_LEN +BC95_MIN_CMD_BUF_LEN];
-            char hbyte[3], *pbytes;
-
-            sprintf_P(command_buffer, (PGM_P)F("AT+NSOST=1,%s,%u,%u,"), remote_host, remote_port, payload_out_size);
-
-            for (uint16_t i = 0; i < payload_out_size; i++) {
-                sprintf_P(hbyte, (PGM_P)F("%02X"), payload_out[i]);
-                strcat(command_buffer, hbyte);
-            }
-
-            _send_command(command_buffer);
-
-            if (_read_line(response_buffer, BC95_MIN_RSP_BUF_LEN, &resp_buf_len) &&
-               (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_DATA) && _wait_for_OK())
-            {
-                pbytes = strstr_P(response_buffer, (PGM_P)F(","));
-                bytes_sent = strtoul(++pbytes, NULL, 10);
-                // msg received. check incoming data
-                memset(response_buffer, 0x0, BC95_MIN_RSP_BUF_LEN);
-                if (_read_line(response_buffer, BC95_MIN_RSP_BUF_LEN, &resp_buf_len, response_timeout) &&
-                   (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_DATA))
-                {
-                    if (bytes_pending != NULL) {
-                        pbytes = strstr_P(response_buffer, (PGM_P)F(","));
-                        *bytes_pending = strtoul(++pbytes, NULL, 10);
-                    }
-                }
+    if (_is_init && _socket_open(socket) && _segments_size(segments, segment_count, crc) <= BC95_NSOST_MAX_PAYLOAD_SIZE &&
+        query_dns(remote_host, remote_ip) && _link_ready())
+    {
+        bc95_fields_t fields;
+        uint8_t downlink_mark;
+
+        _send_nsost(socket, remote_ip, remote_port, segments, segment_count, crc, release);
+        // +NSONMI reports counted from now on belong to this uplink, even if they come before the OK
+        downlink_mark = _sockets[socket].downlinks;
+
+        if (_read_response(BC95_RESPONSE_SENT, &fields)) {
+            _link_confirm();
+
+            bytes_sent = fields.value[1];
+            // msg received. check incoming data
+            if (_wait_for_downlink(socket, downlink_mark, response_timeout) && bytes_pending != NULL) {
+                *bytes_pending = _sockets[socket].last_downlink;
             }
+        } else {
+            // the link may be gone, query it again before the next transmission
+            invalidate_link_state();
         }
     }
 
     return bytes_sent;
 }
 
-uint8_t NBIoT_BC95::receive_UDP_datagram(uint8_t *payload_out, uint16_t *payload_out_size) {
+uint16_t NBIoT_BC95::crc16(const uint8_t *data, const uint16_t data_size, uint16_t crc) {
+    // bitwise: no table to keep in flash
+    for (uint16_t i = 0; i < data_size; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+uint8_t NBIoT_BC95::receive_UDP_datagram(
+        uint8_t *payload_out,
+        uint16_t *payload_out_size,
+        const uint16_t max_size,
+        uint16_t *remaining)
+{
+    return receive_UDP_datagram(_default_soc, payload_out, payload_out_size, max_size, remaining);
+}
+
+uint8_t NBIoT_BC95::receive_UDP_datagram(
+        const uint8_t socket,
+        uint8_t *payload_out,
+        uint16_t *payload_out_size,
+        const uint16_t max_size,
+        uint16_t *remaining)
+{
     uint8_t ret = 0;
     if (payload_out_size != NULL) {
         *payload_out_size = 0;
     }
-    if (_ping_module(5)) {
-        if (_is_init && _open_soc && is_registered() && is_attached()) {
-            char command[BC95_MIN_CMD_BUF_LEN];
-            // 40 bytes for additional parameters like ip_address, socket_cid, etc.
-            char receive_buffer[BC95_NSORF_BUFFER_LEN +BC95_MIN_CMD_BUF_LEN];
-            char* pchr;
-            uint16_t resp_buf_len = 0;
-
-            uint16_t pload_ind = 0, payload_in_size = 0;
-
-            sprintf_P(command, (PGM_P)F("AT+NSORF=1,%u"), BC95_MAX_PACKET_SIZE);
+    if (remaining != NULL) {
+        *remaining = 0;
+    }
 
-            _send_command(command);
+    if (_is_init && _socket_open(socket) && _link_ready()) {
+        uint16_t request_size = (max_size < BC95_NSORF_MAX_PAYLOAD_SIZE) ? max_size : BC95_NSORF_MAX_PAYLOAD_SIZE;
+        uint8_t resp_type;
 
-            if (_read_line(receive_buffer, BC95_NSORF_BUFFER_LEN +64, &resp_buf_len) &&
-               (_check_response(receive_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_DATA) && _wait_for_OK())
-            {
-                // soc_cid
-                strtok_P(receive_buffer, (PGM_P)F(","));
-                for(uint8_t i = 0; i < 4; i++) {
-                    // ip_addr, port, payload_len, payload
-                    pchr = strtok_P(NULL, (PGM_P)F(","));
-                    if (i == 2) {
-                        payload_in_size = strtoul(pchr, NULL, 10);
-                    }
-                }
+        _begin_command(F("AT+NSORF="));
+        _command_uint(socket);
+        _command_str(F(","));
+        _command_uint(request_size);
+        _end_command();
 
-                for (uint16_t i = 0; i < payload_in_size; i++) {
-                    pload_ind = i << 1;
-                    payload_out[i] = (_hex_char_to_int(pchr[pload_ind]) << 4) | _hex_char_to_int(pchr[pload_ind+1]);
-                }
+        resp_type = _read_nsorf(payload_out, request_size);
 
-                if (payload_out_size != NULL) {
-                    *payload_out_size = payload_in_size;
-                }
+        if (resp_type == BC95_RESPONSE_TYPE_NSORF && _wait_for_OK()) {
+            _link_confirm();
+            // +NSONMI adds every datagram, <remaining_length> only covers the one read here
+            _sockets[socket].pending -= (_nsorf.length < _sockets[socket].pending) ? _nsorf.length : _sockets[socket].pending;
 
-                ret = 1;
+            if (payload_out_size != NULL) {
+                *payload_out_size = (_nsorf.length < request_size) ? _nsorf.length : request_size;
             }
+            if (remaining != NULL) {
+                *remaining = _nsorf.remaining;
+            }
+
+            ret = 1;
+        } else if (resp_type == BC95_RESPONSE_TYPE_OK) {
+            // plain OK means nothing to read, whatever was announced
+            _sockets[socket].pending = 0;
+        } else {
+            invalidate_link_state();
         }
     }
 
     return ret;
 }
 
+uint16_t NBIoT_BC95::receive_UDP_datagrams(
+        bc95_datagram_handler_t handler,
+        uint8_t *buffer,
+        const uint16_t max_size,
+        void *ctx)
+{
+    return receive_UDP_datagrams(_default_soc, handler, buffer, max_size, ctx);
+}
+
+uint16_t NBIoT_BC95::receive_UDP_datagrams(
+        const uint8_t socket,
+        bc95_datagram_handler_t handler,
+        uint8_t *buffer,
+        const uint16_t max_size,
+        void *ctx)
+{
+    uint16_t received = 0;
+    uint16_t size = 0, remaining = 0;
+
+    do {
+        if (!receive_UDP_datagram(socket, buffer, &size, max_size, &remaining)) {
+            break;
+        }
+
+        if (handler != NULL) {
+            handler(buffer, size, ctx);
+        }
+        received++;
+    } while (remaining > 0);
+
+    return received;
+}
+
 uint16_t NBIoT_BC95::ping(const char *host, const uint32_t timeout) {
     uint16_t rtt = 0;
 
-    if (_ping_module(5)) {
-        if (_is_init && is_registered() && is_attached()) {
-            char response_buffer[BC95_MIN_RSP_BUF_LEN*2];
-            char command[BC95_MIN_CMD_BUF_LEN];
-            const char *pchr;
-            uint16_t resp_buf_len = 0;
-
-            sprintf_P(command, (PGM_P)F("AT+NPING=%s"), host);
+    if (_is_init && _link_ready()) {
+        bc95_fields_t fields;
 
-            _send_command(command);
+        _begin_command(F("AT+NPING="));
+        _command_str(host);
+        _end_command();
 
-            if (_wait_for_OK() && _read_line(response_buffer, sizeof(response_buffer), &resp_buf_len, BC95_CONNECTION_TIMEOUT) &&
-               (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_DATA))
-            {
-                pchr = strrchr(response_buffer, ',');
-                rtt = strtoul(++pchr, NULL, 10);
-            }
+        // OK comes first, the result when the echo reply arrives
+        if (_wait_for_OK() && _read_response(BC95_RESPONSE_NPING, &fields, timeout, 0)) {
+            rtt = fields.value[2];
         }
     }
 
@@ -228,25 +459,24 @@ uint16_t NBIoT_BC95::ping(const char *host, const uint32_t timeout) {
 /******* DNS-related Functions *******/
 
 uint8_t NBIoT_BC95::query_dns(const char *host_url, char *ip_address) {
-    uint8_t ret = 0;
+    int8_t ret = _dns_cached(host_url, ip_address);
 
-    if (_is_init && is_registered() && is_attached()) {
-        char command[BC95_MIN_CMD_BUF_LEN];
-        char response_buffer[BC95_MIN_CMD_BUF_LEN];
-        char *pchr;
-        uint16_t resp_buf_len = 0;
+    if (ret < 0) {
+        ret = 0;
 
-        sprintf_P(command, (PGM_P)F("AT+QDNS=0,%s"), host_url);
+        if (_is_init && _link_ready()) {
+            char response_buffer[BC95_MIN_CMD_BUF_LEN];
+            uint16_t resp_buf_len = 0;
 
-        _send_command(command);
+            _dns_misses++;
 
-        if (_wait_for_OK() && _read_line(response_buffer, BC95_MIN_CMD_BUF_LEN, &resp_buf_len, BC95_CONNECTION_TIMEOUT) &&
-           (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_DATA))
-        {
-            pchr = strstr_P(response_buffer, (PGM_P)F(":"));
-            strcpy(ip_address, ++pchr);
+            _begin_command(F("AT+QDNS=0,"));
+            _command_str(host_url);
+            _end_command();
 
-            ret = 1;
+            if (_wait_for_OK() && _read_line(response_buffer, BC95_MIN_CMD_BUF_LEN, &resp_buf_len, BC95_CONNECTION_TIMEOUT)) {
+                ret = _dns_answer(response_buffer, host_url, ip_address);
+            }
         }
     }
 
@@ -254,481 +484,1897 @@ uint8_t NBIoT_BC95::query_dns(const char *host_url, char *ip_address) {
 }
 
 uint8_t NBIoT_BC95::flush_dns_cache(const char *host_url) {
-    char command[BC95_MIN_CMD_BUF_LEN];
+    _dns_flush(host_url);
 
-    if (host_url == NULL) {
-        strcpy_P(command, (PGM_P)F("AT+QDNS=1"));
-    } else {
-        sprintf_P(command, (PGM_P)F("AT+QDNS=1,%s"), host_url);
+    _begin_command(F("AT+QDNS=1"));
+    if (host_url != NULL) {
+        _command_str(F(","));
+        _command_str(host_url);
     }
-
-    _send_command(command);
+    _end_command();
 
     return _wait_for_OK();
 }
 
-/******* Modem Configuration Functions *******/
-
-uint8_t NBIoT_BC95::config_psm(const bc95_psm_config_t *psm_config) {
-    char command[BC95_MIN_CMD_BUF_LEN];
-    bc95_psm_config_t pconfig;
-
-    if (psm_config == NULL) {
-        // set up psm default config
-        memset(&pconfig, 0x0, sizeof(bc95_psm_config_t));
-
-        pconfig.psm_mode                            = BC95_PSM_MODE_ENABLED;
-
-        // request operator sleep 10*7 hours
-        tau_timer_t tau_timer;
-        tau_timer.config.tau_multiple               = BC95_TAU_10_HOURS;
-        tau_timer.config.tau_value                  = 7;
+/******* Asynchronous Functions *******/
 
-        // report operator 2*2 seconds active time
-        active_time_timer_t at_timer;
-        at_timer.config.active_time_multiple        = BC95_AT_2_SECONDS;
-        at_timer.config.active_time_value           = 2;
+uint8_t NBIoT_BC95::begin_send_UDP_datagram(
+        const char *remote_host,
+        const uint16_t remote_port,
+        const uint8_t *payload_out,
+        const uint16_t payload_out_size,
+        uint16_t *bytes_pending,
+        const uint32_t response_timeout,
+        const bc95_release_t release)
+{
+    return begin_send_UDP_datagram(_default_soc, remote_host, remote_port, payload_out, payload_out_size,
+                                   bytes_pending, response_timeout, release);
+}
 
-        pconfig.tau_timer_config                    = tau_timer;
-        pconfig.active_time_timer_config            = at_timer;
+uint8_t NBIoT_BC95::begin_send_UDP_datagram(
+        const uint8_t socket,
+        const char *remote_host,
+        const uint16_t remote_port,
+        const uint8_t *payload_out,
+        const uint16_t payload_out_size,
+        uint16_t *bytes_pending,
+        const uint32_t response_timeout,
+        const bc95_release_t release)
+{
+    bc95_segment_t segment = { payload_out, payload_out_size };
 
-        psm_config = &pconfig;
-    }
+    return begin_send_UDP_datagram(socket, remote_host, remote_port, &segment, 1, bytes_pending, response_timeout,
+                                   release);
+}
 
-    sprintf_P(command, (PGM_P)F("AT+CPSMS=%u,,,"), psm_config->psm_mode);
-    char bit[2];
-    int8_t i;
+uint8_t NBIoT_BC95::begin_send_UDP_datagram(
+        const char *remote_host,
+        const uint16_t remote_port,
+        const bc95_segment_t *segments,
+        const uint8_t segment_count,
+        uint16_t *bytes_pending,
+        const uint32_t response_timeout,
+        const bc95_release_t release,
+        const bc95_crc_t crc)
+{
+    return begin_send_UDP_datagram(_default_soc, remote_host, remote_port, segments, segment_count,
+                                   bytes_pending, response_timeout, release, crc);
+}
 
-    bit[1] = '\0';
-    for (i = 7; i >= 0; i--) {
-        bit[0] = '0' + _get_bit(psm_config->tau_timer_config.i, i);
-        strcat(command, bit);
+uint8_t NBIoT_BC95::begin_send_UDP_datagram(
+        const uint8_t socket,
+        const char *remote_host,
+        const uint16_t remote_port,
+        const bc95_segment_t *segments,
+        const uint8_t segment_count,
+        uint16_t *bytes_pending,
+        const uint32_t response_timeout,
+        const bc95_release_t release,
+        const bc95_crc_t crc)
+{
+    char remote_ip[BC95_IP_ADDRESS_LEN];
+    uint8_t ret = 0;
+    if (bytes_pending != NULL) {
+        *bytes_pending = 0;
     }
 
-    strcat_P(command, (PGM_P)F(","));
+    if (_op.status != BC95_OP_PENDING && _is_init && _socket_open(socket) &&
+        _segments_size(segments, segment_count, crc) <= BC95_NSOST_MAX_PAYLOAD_SIZE &&
+        query_dns(remote_host, remote_ip) && _link_ready())
+    {
+        _send_nsost(socket, remote_ip, remote_port, segments, segment_count, crc, release);
 
-    for (i = 7; i >= 0; i--) {
-        bit[0] = '0' + _get_bit(psm_config->active_time_timer_config.i, i);
-        strcat(command, bit);
+        _op.socket = socket;
+        _op.bytes_pending = bytes_pending;
+        _op.downlink_mark = _sockets[socket].downlinks;
+        ret = _op_start(BC95_OP_SEND, OP_STAGE_RESPONSE, response_timeout);
     }
 
-    _send_command(command);
-
-    return _wait_for_OK();
+    return ret;
 }
 
-/******* Network Configuration Functions *******/
+uint8_t NBIoT_BC95::begin_receive_UDP_datagram(
+        uint8_t *payload_out,
+        uint16_t *payload_out_size,
+        const uint16_t max_size,
+        uint16_t *remaining)
+{
+    return begin_receive_UDP_datagram(_default_soc, payload_out, payload_out_size, max_size, remaining);
+}
 
-uint8_t NBIoT_BC95::force_network_attachment(const bc95_network_attachment_state_t state) {
+uint8_t NBIoT_BC95::begin_receive_UDP_datagram(
+        const uint8_t socket,
+        uint8_t *payload_out,
+        uint16_t *payload_out_size,
+        const uint16_t max_size,
+        uint16_t *remaining)
+{
     uint8_t ret = 0;
+    if (payload_out_size != NULL) {
+        *payload_out_size = 0;
+    }
+    if (remaining != NULL) {
+        *remaining = 0;
+    }
 
-    if(_is_init) {
-        char command[BC95_MIN_CMD_BUF_LEN];
+    if (_op.status != BC95_OP_PENDING && _is_init && _socket_open(socket) && _link_ready()) {
+        _op.payload_capacity = (max_size < BC95_NSORF_MAX_PAYLOAD_SIZE) ? max_size : BC95_NSORF_MAX_PAYLOAD_SIZE;
 
-        if((state == BC95_NETWORK_DETACH && !is_attached()) || (state == BC95_NETWORK_ATTACH && is_attached())) {
-            ret = 1;
-        } else {
-            sprintf_P(command, (PGM_P)F("AT+CGATT=%u"), state == BC95_NETWORK_ATTACH);
+        _begin_command(F("AT+NSORF="));
+        _command_uint(socket);
+        _command_str(F(","));
+        _command_uint(_op.payload_capacity);
+        _end_command();
 
-            _send_command(command);
-            ret = _wait_for_OK();
-        }
+        _op.socket = socket;
+        _op.payload = payload_out;
+        _op.payload_size = payload_out_size;
+        _op.remaining = remaining;
+        ret = _op_start(BC95_OP_RECEIVE, OP_STAGE_RESPONSE, 0);
     }
 
     return ret;
 }
 
-uint8_t NBIoT_BC95::set_bands(const bc95_band_t *bands, const uint8_t nbands) {
+uint8_t NBIoT_BC95::begin_ping(const char *host, const uint32_t timeout) {
     uint8_t ret = 0;
-    // Needs to be executed when CFUN=0. Note: See AT Commands Manual
-    if (set_modem_functionality(BC95_MODEM_FUNCIONALITY_LEVEL_MINIMUM)) {
-        char command[BC95_MIN_CMD_BUF_LEN] = "AT+NBAND=";
-        char tmp[3];
-
-        for(uint8_t i = 0; i < nbands; i++) {
-            sprintf_P(tmp, (PGM_P)F("%u,"), bands[i]);
-            strcat(command, tmp);
-        }
 
-        command[strlen(command)-1] = '\0';
-        _send_command(command);
+    if (_op.status != BC95_OP_PENDING && _is_init && _link_ready()) {
+        _begin_command(F("AT+NPING="));
+        _command_str(host);
+        _end_command();
 
-        ret = _wait_for_OK() && set_modem_functionality(BC95_MODEM_FUNCIONALITY_LEVEL_FULL);
+        ret = _op_start(BC95_OP_PING, OP_STAGE_OK, timeout);
     }
 
     return ret;
 }
 
-uint8_t NBIoT_BC95::set_modem_functionality(const bc95_modem_functionality_level_t level) {
-    char command[BC95_MIN_CMD_BUF_LEN];
+uint8_t NBIoT_BC95::begin_query_dns(const char *host_url, char *ip_address) {
+    uint8_t ret = 0;
+    int8_t cached;
 
-    sprintf_P(command, (PGM_P)F("AT+CFUN=%u"), level);
+    if (_op.status != BC95_OP_PENDING) {
+        cached = _dns_cached(host_url, ip_address);
 
-    _send_command(command);
+        if (cached >= 0) {
+            // answered by the cache, done before the first poll()
+            _op.type = BC95_OP_DNS;
+            _op.result = cached;
+            _op_finish(cached ? BC95_OP_DONE : BC95_OP_FAILED);
+            ret = 1;
+        } else if (_is_init && _link_ready()) {
+            _dns_misses++;
 
-    return _wait_for_OK(BC95_DEFAULT_CFUN_RESPONSE_TIMEOUT);
-}
+            _begin_command(F("AT+QDNS=0,"));
+            _command_str(host_url);
+            _end_command();
 
-uint8_t NBIoT_BC95::set_led_mode(const bc95_led_mode_t mode) {
-    char command[BC95_MIN_CMD_BUF_LEN];
+            _op.ip_address = ip_address;
+            _op.host = host_url;
+            ret = _op_start(BC95_OP_DNS, OP_STAGE_OK, BC95_CONNECTION_TIMEOUT);
+        }
+    }
 
-    sprintf_P(command, (PGM_P)F("AT+QLEDMODE=%u"), mode);
+    return ret;
+}
 
-    _send_command(command);
+bc95_op_status_t NBIoT_BC95::poll(void) {
+    uint8_t line_type;
 
-    return _wait_for_OK();
-}
+    if (_op.status != BC95_OP_PENDING) {
+        process_urcs();
+    }
 
+    while (_op.status == BC95_OP_PENDING && _rx_ready()) {
+        _op.last_activity = _millis();
 
-/* Checkers */
+        if (_op.type == BC95_OP_RECEIVE && _op.stage == OP_STAGE_RESPONSE) {
+            // +NSORF data goes straight into the caller's buffer
+            line_type = _nsorf_feed(_op.payload, _op.payload_capacity, _op_line, sizeof(_op_line));
+        } else {
+            line_type = (_frame_line(_op_line, sizeof(_op_line)) && _parsed_len > 0 && !_process_urc(_op_line)) ?
+                        BC95_RESPONSE_TYPE_UNKNOWN : 0;
+        }
 
-uint8_t NBIoT_BC95::is_registered(void) {
-    char response_buffer[BC95_MIN_RSP_BUF_LEN];
-    char *pchr;
-    uint16_t resp_buf_len = 0;
+        if (line_type == BC95_RESPONSE_TYPE_NSORF) {
+            _op.result = (_nsorf.length < _op.payload_capacity) ? _nsorf.length : _op.payload_capacity;
+            _sockets[_op.socket].pending -= (_nsorf.length < _sockets[_op.socket].pending) ?
+                                            _nsorf.length : _sockets[_op.socket].pending;
+            if (_op.payload_size != NULL) {
+                *_op.payload_size = _op.result;
+            }
+            if (_op.remaining != NULL) {
+                *_op.remaining = _nsorf.remaining;
+            }
+            _op.stage = OP_STAGE_OK;
+        } else if (line_type != 0) {
+            #if BC95_MODULE_DEBUG > 0
+                if (_dbg != NULL) {
+                    _dbg->println("<----");
+                    _dbg->println(_op_line);
+                }
+            #endif
 
-    int net_state = 0;
+            _op_handle_line(_op_line, _parsed_len);
+        }
 
-    _send_command(F("AT+CEREG?"));
+        if (_op.type == BC95_OP_SEND && _op.stage == OP_STAGE_RESULT &&
+            _sockets[_op.socket].downlinks != _op.downlink_mark)
+        {
+            // +NSONMI for this uplink, possibly received before the OK
+            if (_op.bytes_pending != NULL) {
+                *_op.bytes_pending = _sockets[_op.socket].last_downlink;
+            }
+            _op_finish(BC95_OP_DONE);
+        }
+    }
 
-    if (_read_line(response_buffer, BC95_MIN_RSP_BUF_LEN, &resp_buf_len) &&
-       (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_DATA) && _wait_for_OK())
-    {
-        pchr = strstr_P(response_buffer, (PGM_P)F(","));
-        net_state = strtoul(++pchr, NULL, 10);
+    if (_op.status == BC95_OP_PENDING) {
+        if (_op.stage == OP_STAGE_RESULT) {
+            if (_millis() - _op.stage_started >= _op.timeout) {
+                // the datagram has been sent, missing +NSONMI only means that nothing came back
+                _op_finish(_op.type == BC95_OP_SEND ? BC95_OP_DONE : BC95_OP_FAILED);
+            }
+        } else if (_millis() - _op.last_activity >= BC95_READ_RESPONSE_TIMEOUT) {
+            _op_finish(BC95_OP_FAILED);
+        }
     }
 
-    return (net_state == BC95_NETWORK_STAT_REGISTERED_HOME_NETWORK) ||
-           (net_state == BC95_NETWORK_STAT_REGISTERED_ROAMING);
+    return _op.status;
 }
 
-uint8_t NBIoT_BC95::is_attached(void) {
-    int attached = 0;
+/******* Unsolicited Result Codes *******/
 
-    if(_is_init) {
-        char response_buffer[BC95_MIN_RSP_BUF_LEN];
-        char *pchr;
-        uint16_t resp_buf_len = 0;
+uint8_t NBIoT_BC95::process_urcs(void) {
+    uint8_t dispatched = 0;
 
-        _send_command(F("AT+CGATT?"));
+    if (_op.status == BC95_OP_PENDING) {
+        // poll() dispatches them along with the operation in progress
+        return 0;
+    }
 
-        if (_read_line(response_buffer, BC95_MIN_RSP_BUF_LEN, &resp_buf_len) &&
-           (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_DATA) && _wait_for_OK())
-        {
-            pchr = strstr_P(response_buffer, (PGM_P)F(":"));
-            attached = strtoul(++pchr, NULL, 10);
+    // a report cut in half stays in _op_line until the next call
+    while (_rx_ready()) {
+        if (_frame_line(_op_line, sizeof(_op_line)) && _parsed_len > 0 && _process_urc(_op_line) != BC95_URC_NONE) {
+            dispatched++;
         }
     }
 
-    return attached;
+    return dispatched;
 }
 
-uint8_t NBIoT_BC95::is_psm_enabled(void) {
-    char response_buffer[BC95_MIN_RSP_BUF_LEN];
-    char *pchr;
-
-    int isPSM = 0;
-
-    _send_command(F("AT+NPSMR=1"));
+uint8_t NBIoT_BC95::wait_for_downlink(const uint8_t socket, const uint32_t timeout) {
+    uint32_t start = _millis();
+    uint8_t open = _socket_open(socket);
+    uint8_t mark = open ? _sockets[socket].downlinks : 0;
 
-    if (_wait_for_OK()) {
-        _send_command(F("AT+NPSMR?"));
-        uint16_t resp_buf_len = 0;
+    _metrics_wait_begin();
 
-        if (_read_line(response_buffer, BC95_MIN_RSP_BUF_LEN, &resp_buf_len) &&
-           (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_DATA) && _wait_for_OK())
-        {
-            pchr = strstr_P(response_buffer, (PGM_P)F(","));
-            isPSM = strtoul(++pchr, NULL, 10);
+    // unlike the waits after a command, a report cut in half is kept for the next read
+    while ((!open || _sockets[socket].downlinks == mark) && _millis() - start < timeout) {
+        if (_op.status == BC95_OP_PENDING || !_rx_ready()) {
+            _idle(start, timeout);
+        } else if (_frame_line(_op_line, sizeof(_op_line)) && _parsed_len > 0) {
+            _process_urc(_op_line);
         }
-
-        _send_command(F("AT+NPSMR=0"));
-        _wait_for_OK();
     }
+    _metrics_wait_end();
 
-    return isPSM;
+    return open && _sockets[socket].downlinks != mark;
 }
 
-#define MIN_IP_ADDRESS_LENGTH   (7)
-uint8_t NBIoT_BC95::is_assigned_ip(void) {
-    char ip_addr[15] = "";
-    get_IP_address(ip_addr);
+/******* Receive Buffer *******/
 
-    return (strlen(ip_addr) > MIN_IP_ADDRESS_LENGTH);
+uint16_t NBIoT_BC95::pump(void) {
+    uint16_t moved = 0;
+    uint8_t next = (_rx_head + 1) & BC95_RX_BUFFER_MASK;
+
+    // stops when full, the rest waits in the UART
+    while (next != _rx_tail && _stream->available()) {
+        _rx_buf[_rx_head] = _stream->read();
+        _rx_head = next;
+        next = (next + 1) & BC95_RX_BUFFER_MASK;
+        moved++;
+    }
+
+    return moved;
 }
 
-/******* Info getters *******/
+void NBIoT_BC95::rx_isr(const uint8_t read_byte) {
+    uint8_t next = (_rx_head + 1) & BC95_RX_BUFFER_MASK;
 
-uint8_t NBIoT_BC95::get_current_date_and_time(char *date_and_time) {
-    uint8_t ret = 0;
+    if (next == _rx_tail) {
+        _rx_dropped++;
+    } else {
+        _rx_buf[_rx_head] = read_byte;
+        _rx_head = next;
+    }
+}
 
-    if (_is_init && is_registered() && date_and_time != NULL) {
-        char response_buffer[BC95_MIN_CMD_BUF_LEN];
-        uint16_t resp_buf_len = 0;
+#if BC95_METRICS > 0
+const bc95_command_metrics_t *NBIoT_BC95::get_command_metrics(const uint8_t index) const {
+    return (index < BC95_METRICS_COMMANDS && _metrics[index].command[0] != '\0') ? &_metrics[index] : NULL;
+}
 
-        _send_command(F("AT+CCLK?"));
+void NBIoT_BC95::reset_metrics(void) {
+    memset(_metrics, 0x0, sizeof(_metrics));
+    memset(&_idle_stats, 0x0, sizeof(_idle_stats));
+    _metrics_open = NULL;
+}
+#endif
 
-        if (_read_line(response_buffer, sizeof(response_buffer), &resp_buf_len) &&
-           (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_DATA) && _wait_for_OK())
-        {
-            char *pchr;
-            pchr = strstr_P(response_buffer, (PGM_P)F(":"));
-            strncpy(date_and_time, pchr, strlen(pchr)-1);
+uint16_t NBIoT_BC95::get_pending_bytes(void) {
+    uint16_t pending = 0;
 
-            ret = 1;
-        }
+    for (uint8_t i = 0; i < BC95_MAX_SOCKETS; i++) {
+        pending += get_pending_bytes(i);
     }
 
-    return ret;
+    return pending;
 }
 
-int8_t NBIoT_BC95::get_signal_strength(void) {
-    uint8_t rssi_db = 0;
+uint16_t NBIoT_BC95::get_pending_bytes(const uint8_t socket) {
+    return _socket_open(socket) ? _sockets[socket].pending : 0;
+}
 
-    if (_is_init & is_registered()) {
-        char response_buffer[BC95_MIN_RSP_BUF_LEN];
-        char *pchr;
-        uint16_t resp_buf_len = 0;
+/******* Modem Configuration Functions *******/
+
+uint8_t NBIoT_BC95::config_psm(const bc95_psm_config_t *psm_config) {
+    bc95_psm_config_t pconfig;
+
+    if (psm_config == NULL) {
+        // set up psm default config
+        memset(&pconfig, 0x0, sizeof(bc95_psm_config_t));
+
+        pconfig.psm_mode                            = BC95_PSM_MODE_ENABLED;
+
+        // request operator sleep 10*7 hours
+        tau_timer_t tau_timer;
+        tau_timer.config.tau_multiple               = BC95_TAU_10_HOURS;
+        tau_timer.config.tau_value                  = 7;
+
+        // report operator 2*2 seconds active time
+        active_time_timer_t at_timer;
+        at_timer.config.active_time_multiple        = BC95_AT_2_SECONDS;
+        at_timer.config.active_time_value           = 2;
+
+        pconfig.tau_timer_config                    = tau_timer;
+        pconfig.active_time_timer_config            = at_timer;
+
+        psm_config = &pconfig;
+    }
+
+    _begin_command(F("AT+CPSMS="));
+    _command_uint(psm_config->psm_mode);
+    _command_str(F(",,,"));
+    _command_bits(psm_config->tau_timer_config.i);
+    _command_str(F(","));
+    _command_bits(psm_config->active_time_timer_config.i);
+    _end_command();
+
+    return _wait_for_OK();
+}
+
+uint8_t NBIoT_BC95::read_config_profile(bc95_config_profile_t *profile) {
+    char response_buffer[BC95_MIN_RSP_BUF_LEN*3];
+    uint16_t resp_buf_len = 0;
+    uint8_t resp_type = BC95_RESPONSE_TYPE_TIMEOUT;
+    uint8_t found = 0;
+    bc95_fields_t fields;
+
+    memset(profile, 0x0, sizeof(bc95_config_profile_t));
+
+    // one round trip: a +NCONFIG:<function>,<value> line per setting, +NBAND, +CPSMS and a single OK
+    _send_command(F("AT+NCONFIG?;+NBAND?;+CPSMS?"));
+
+    while (_read_line(response_buffer, sizeof(response_buffer), &resp_buf_len) &&
+          (resp_type = _check_response(response_buffer, resp_buf_len)) == BC95_RESPONSE_TYPE_DATA)
+    {
+        if (strncmp_P(response_buffer, (PGM_P)F("+NCONFIG:AUTOCONNECT,"), 21) == 0) {
+            profile->autoconnect = (strncmp_P(response_buffer + 21, (PGM_P)F("TRUE"), 4) == 0);
+            found |= 0x01;
+        } else if (_parse_response(response_buffer, BC95_RESPONSE_NBAND, &fields)) {
+            for (uint8_t i = 0; i < fields.count && profile->nbands < BC95_MAX_BANDS; i++) {
+                profile->bands[profile->nbands++] = (bc95_band_t)fields.value[i];
+            }
+            found |= 0x02;
+        } else if (_parse_response(response_buffer, BC95_RESPONSE_CPSMS, &fields)) {
+            // timers as bit strings, absent timers read as 0
+            profile->psm_config.psm_mode = (bc95_psm_mode_t)fields.value[0];
+            profile->psm_config.tau_timer_config.i = fields.value[3];
+            profile->psm_config.active_time_timer_config.i = fields.value[4];
+            found |= 0x04;
+        }
+    }
+
+    return found == 0x07 && resp_type == BC95_RESPONSE_TYPE_OK;
+}
+
+uint8_t NBIoT_BC95::apply_config_profile(const bc95_config_profile_t *profile, uint8_t *changes) {
+    bc95_config_profile_t current;
+    uint8_t changed = BC95_CONFIG_UNCHANGED;
+    uint8_t ret, same, i, j;
+
+    ret = read_config_profile(&current);
+
+    if (ret && current.autoconnect != (profile->autoconnect != 0)) {
+        ret = _set_autoconnect(profile->autoconnect);
+        changed |= ret ? BC95_CONFIG_AUTOCONNECT : 0;
+    }
+
+    if (ret && profile->nbands > 0) {
+        same = (current.nbands == profile->nbands);
+        for (i = 0; same && i < profile->nbands; i++) {
+            for (j = 0; j < current.nbands && current.bands[j] != profile->bands[i]; j++);
+            same = (j < current.nbands);
+        }
+
+        if (!same) {
+            ret = set_bands(profile->bands, profile->nbands);
+            changed |= ret ? BC95_CONFIG_BANDS : 0;
+        }
+    }
+
+    if (ret) {
+        if (profile->psm_config.psm_mode == BC95_PSM_MODE_DISABLED_AND_DISCARD_CURRENT_CONFIG) {
+            // an action rather than a state: done once PSM reads back disabled with the timers discarded
+            same = (current.psm_config.psm_mode == BC95_PSM_MODE_DISABLED) &&
+                   current.psm_config.tau_timer_config.i == 0 && current.psm_config.active_time_timer_config.i == 0;
+        } else {
+            // timers only matter while PSM is requested
+            same = (current.psm_config.psm_mode == profile->psm_config.psm_mode) &&
+                   (profile->psm_config.psm_mode != BC95_PSM_MODE_ENABLED ||
+                   (current.psm_config.tau_timer_config.i == profile->psm_config.tau_timer_config.i &&
+                    current.psm_config.active_time_timer_config.i == profile->psm_config.active_time_timer_config.i));
+        }
+
+        if (!same) {
+            ret = config_psm(&profile->psm_config);
+            changed |= ret ? BC95_CONFIG_PSM : 0;
+        }
+    }
+
+    if (changes != NULL) {
+        *changes = changed;
+    }
+
+    return ret;
+}
+
+/******* Network Configuration Functions *******/
+
+uint8_t NBIoT_BC95::force_network_attachment(const bc95_network_attachment_state_t state) {
+    uint8_t ret = 0;
+
+    if(_is_init) {
+        if((state == BC95_NETWORK_DETACH && !is_attached()) || (state == BC95_NETWORK_ATTACH && is_attached())) {
+            ret = 1;
+        } else {
+            _send_command(state == BC95_NETWORK_ATTACH ? F("AT+CGATT=1") : F("AT+CGATT=0"));
+            ret = _wait_for_OK();
+        }
+    }
+
+    return ret;
+}
+
+uint8_t NBIoT_BC95::set_bands(const bc95_band_t *bands, const uint8_t nbands) {
+    uint8_t ret = 0;
+    // Needs to be executed when CFUN=0. Note: See AT Commands Manual
+    if (set_modem_functionality(BC95_MODEM_FUNCIONALITY_LEVEL_MINIMUM)) {
+        _begin_command(F("AT+NBAND="));
+        for(uint8_t i = 0; i < nbands; i++) {
+            if (i > 0) {
+                _command_str(F(","));
+            }
+            _command_uint(bands[i]);
+        }
+        _end_command();
+
+        ret = _wait_for_OK() && set_modem_functionality(BC95_MODEM_FUNCIONALITY_LEVEL_FULL);
+    }
+
+    return ret;
+}
+
+uint8_t NBIoT_BC95::set_modem_functionality(const bc95_modem_functionality_level_t level) {
+    _begin_command(F("AT+CFUN="));
+    _command_uint(level);
+    _end_command();
+
+    return _wait_for_OK(BC95_DEFAULT_CFUN_RESPONSE_TIMEOUT);
+}
+
+uint8_t NBIoT_BC95::set_led_mode(const bc95_led_mode_t mode) {
+    _begin_command(F("AT+QLEDMODE="));
+    _command_uint(mode);
+    _end_command();
+
+    return _wait_for_OK();
+}
+
+
+/* Checkers */
+
+uint8_t NBIoT_BC95::is_registered(void) {
+    bc95_fields_t fields;
+    uint32_t net_state = BC95_NETWORK_STAT_NOT_REGISTERED;
+
+    _send_command(F("AT+CEREG?"));
+
+    if (_read_response(BC95_RESPONSE_CEREG, &fields)) {
+        net_state = fields.value[1];
+    }
+
+    _link_registered = (net_state == BC95_NETWORK_STAT_REGISTERED_HOME_NETWORK) ||
+                       (net_state == BC95_NETWORK_STAT_REGISTERED_ROAMING);
+    if (_link_registered && _link_attached) {
+        _link_checked = _millis();
+    }
+
+    return _link_registered;
+}
+
+uint8_t NBIoT_BC95::is_attached(void) {
+    int attached = 0;
+
+    if(_is_init) {
+        bc95_fields_t fields;
+
+        _send_command(F("AT+CGATT?"));
+
+        if (_read_response(BC95_RESPONSE_CGATT, &fields)) {
+            attached = fields.value[0];
+        }
+    }
+
+    _link_attached = attached;
+    if (_link_registered && _link_attached) {
+        _link_checked = _millis();
+    }
+
+    return attached;
+}
+
+uint8_t NBIoT_BC95::is_psm_enabled(void) {
+    bc95_fields_t fields;
+
+    int isPSM = 0;
+
+    // reporting stays enabled after initialize(), otherwise it is enabled just to read <mode>
+    if (_is_init || (_send_command(F("AT+NPSMR=1")) && _wait_for_OK())) {
+        _send_command(F("AT+NPSMR?"));
+
+        // <mode> is only reported while reporting is enabled
+        if (_read_response(BC95_RESPONSE_NPSMR, &fields) && fields.count > 1) {
+            isPSM = fields.value[1];
+            _in_psm = isPSM;
+        }
+
+        if (!_is_init) {
+            _send_command(F("AT+NPSMR=0"));
+            _wait_for_OK();
+        }
+    }
+
+    return isPSM;
+}
+
+#define MIN_IP_ADDRESS_LENGTH   (7)
+uint8_t NBIoT_BC95::is_assigned_ip(void) {
+    char ip_addr[BC95_IP_ADDRESS_LEN] = "";
+
+    return get_IP_address(ip_addr) && (strlen(ip_addr) > MIN_IP_ADDRESS_LENGTH);
+}
+
+uint8_t NBIoT_BC95::get_status(bc95_status_t *status) {
+    char response_buffer[BC95_MIN_CMD_BUF_LEN];
+    uint16_t resp_buf_len = 0;
+    uint8_t resp_type = BC95_RESPONSE_TYPE_TIMEOUT;
+    bc95_fields_t fields;
+
+    memset(status, 0x0, sizeof(bc95_status_t));
+
+    if (!_is_init) {
+        return 0;
+    }
+
+    // one answer line per query and a single OK. <mode> of +NPSMR is reported since initialize()
+    _send_command(F("AT+CEREG?;+CGATT?;+NPSMR?;+CSQ;+CGPADDR=0"));
+
+    while (_read_line(response_buffer, sizeof(response_buffer), &resp_buf_len) &&
+          (resp_type = _check_response(response_buffer, resp_buf_len)) == BC95_RESPONSE_TYPE_DATA)
+    {
+        if (_parse_response(response_buffer, BC95_RESPONSE_CEREG, &fields)) {
+            status->registered = (fields.value[1] == BC95_NETWORK_STAT_REGISTERED_HOME_NETWORK) ||
+                                 (fields.value[1] == BC95_NETWORK_STAT_REGISTERED_ROAMING);
+        } else if (_parse_response(response_buffer, BC95_RESPONSE_CGATT, &fields)) {
+            status->attached = fields.value[0];
+        } else if (_parse_response(response_buffer, BC95_RESPONSE_NPSMR, &fields)) {
+            status->psm = (fields.count > 1) ? fields.value[1] : 0;
+        } else if (_parse_response(response_buffer, BC95_RESPONSE_CSQ, &fields)) {
+            status->rssi = _csq_to_dbm(fields.value[0]);
+        } else if (_parse_response(response_buffer, BC95_RESPONSE_CGPADDR, &fields)) {
+            _format_ipv4(fields.ip, status->ip_address);
+        }
+    }
+
+    if (resp_type != BC95_RESPONSE_TYPE_OK) {
+        return 0;
+    }
+
+    _link_registered = status->registered;
+    _link_attached = status->attached;
+    _in_psm = status->psm;
+    if (_link_registered && _link_attached) {
+        _link_checked = _millis();
+    }
+
+    return 1;
+}
+
+/******* Info getters *******/
+
+uint8_t NBIoT_BC95::get_current_date_and_time(char *date_and_time) {
+    uint8_t ret = 0;
+
+    if (_is_init && is_registered() && date_and_time != NULL) {
+        bc95_fields_t fields;
+
+        fields.text = date_and_time;
+        _send_command(F("AT+CCLK?"));
+
+        ret = _read_response(BC95_RESPONSE_CCLK, &fields);
+    }
+
+    return ret;
+}
+
+int8_t NBIoT_BC95::get_signal_strength(void) {
+    int8_t rssi_db = 0;
+
+    if (_is_init & is_registered()) {
+        bc95_fields_t fields;
+
+        _send_command(F("AT+CSQ"));
+
+        if (_read_response(BC95_RESPONSE_CSQ, &fields)) {
+            rssi_db = _csq_to_dbm(fields.value[0]);
+        }
+    }
+
+    return rssi_db;
+}
+
+uint8_t NBIoT_BC95::get_IP_address(char *ip_address) {
+    uint8_t ret = 0;
+
+    if (_is_init && is_registered() && is_attached()) {
+        bc95_fields_t fields;
+
+        _send_command(F("AT+CGPADDR=0"));
+
+        if (_read_response(BC95_RESPONSE_CGPADDR, &fields)) {
+            _format_ipv4(fields.ip, ip_address);
+
+            ret = 1;
+        }
+    }
+
+    return ret;
+}
+
+uint8_t NBIoT_BC95::get_IMEI(char *imei) {
+    bc95_fields_t fields;
+
+    fields.text = imei;
+    _send_command(F("AT+CGSN=1"));
+
+    return _read_response(BC95_RESPONSE_CGSN, &fields);
+}
+
+uint8_t NBIoT_BC95::get_ICCID(char * iccid) {
+    bc95_fields_t fields;
+
+    fields.text = iccid;
+    _send_command(F("AT+NCCID"));
+
+    return _read_response(BC95_RESPONSE_NCCID, &fields);
+}
+
+/******* UART Functions *******/
+
+uint8_t NBIoT_BC95::set_baud_rate(const uint32_t baud_rate, const uint8_t store) {
+    uint32_t start;
+    uint8_t ret = 0, back;
+
+    if (_baud_callback == NULL || !(_baud_rate != 0 || _read_baud_rate())) {
+        return 0;
+    }
+
+    if (baud_rate == _baud_rate) {
+        ret = _ping_module(1);
+    } else {
+        _begin_command(F("AT+NATSPEED="));
+        _command_uint(baud_rate);
+        _command_str(F(","));
+        _command_uint(BC95_NATSPEED_TIMEOUT);
+        _command_str(F(","));
+        _command_uint(store != 0);
+        _command_str(F(",0"));
+        _end_command();
+
+        // the module answers at the current rate and switches right after the OK
+        if (_wait_for_OK()) {
+            _switch_host_baud_rate(baud_rate);
+
+            // the first command received at the new rate confirms it
+            ret = _ping_module(2);
+
+            if (!ret) {
+                // unconfirmed, the module goes back to the previous rate once the timeout expires
+                _switch_host_baud_rate(_baud_rate);
+
+                start = _millis();
+                do {
+                    back = _ping_module(1);
+                } while (!back && _millis() - start < BC95_NATSPEED_TIMEOUT * 1000UL + BC95_READ_RESPONSE_TIMEOUT);
+
+                if (!back) {
+                    // one of the pings got through and only the answers were lost
+                    _switch_host_baud_rate(baud_rate);
+                    ret = _ping_module(2);
+                }
+            }
+
+            if (ret) {
+                _baud_rate = baud_rate;
+                if (store) {
+                    _stored_baud_rate = baud_rate;
+                }
+            }
+
+            #if BC95_MODULE_DEBUG > 0
+                if (_dbg != NULL) {
+                    _dbg->print("baud rate ");
+                    _dbg->println(_baud_rate);
+                }
+            #endif
+        }
+    }
+
+    return ret;
+}
+
+uint32_t NBIoT_BC95::negotiate_baud_rate(const uint32_t max_baud_rate, const uint8_t store) {
+    uint32_t baud_rate;
+
+    for (uint8_t i = 0; i < sizeof(_baud_rates) / sizeof(_baud_rates[0]); i++) {
+        baud_rate = pgm_read_dword(&_baud_rates[i]);
+
+        if (baud_rate <= max_baud_rate && set_baud_rate(baud_rate, store)) {
+            break;
+        }
+    }
+
+    return _baud_rate;
+}
+
+/******* Misc Funcions *******/
+
+uint8_t NBIoT_BC95::reboot(void) {
+    uint8_t ret = 0;
+    char response_buffer[BC95_MIN_RSP_BUF_LEN];
+    uint16_t resp_buf_len = 0;
+
+    _send_command(F("AT+NRB"));
+
+    if (_read_line(response_buffer, BC95_MIN_RSP_BUF_LEN, &resp_buf_len, BC95_DEFAULT_REBOOT_TIMEOUT) &&
+        (_check_response(response_buffer, resp_buf_len) != BC95_RESPONSE_TYPE_DATA))
+    {
+        if (strstr_P(response_buffer, (PGM_P)F("REBOOTING")) != NULL) {
+            // sockets do not survive the reboot
+            memset(_sockets, 0x0, sizeof(_sockets));
+            _default_soc = BC95_INVALID_SOCKET;
+
+            // the module comes back at its stored baud rate
+            if (_baud_rate != _stored_baud_rate) {
+                _switch_host_baud_rate(_stored_baud_rate);
+                _baud_rate = _stored_baud_rate;
+            }
+            ret = 1;
+        }
+    }
+
+    return ret;
+}
+
+
+/* BC95 Modem Private Functions */
+
+uint8_t NBIoT_BC95::_send_command(const __FlashStringHelper *cmd) {
+    return _begin_command(cmd) && _end_command();
+}
+
+uint8_t NBIoT_BC95::_begin_command(const __FlashStringHelper *cmd) {
+    if (_op.status == BC95_OP_PENDING) {
+        // the UART belongs to the asynchronous operation in progress
+        return 0;
+    }
+
+    #if BC95_MODULE_DEBUG > 0
+        if (_dbg != NULL) {
+            _dbg->println("---->");
+        }
+    #endif
+
+    _flushInput();
+    // after the flush, a late final result code still closes the previous command
+    _metrics_begin(cmd);
+
+    _command_open = 1;
+    _solicited = _queried_reports(cmd);
+    _command_str(cmd);
+
+    return 1;
+}
+
+void NBIoT_BC95::_command_str(const __FlashStringHelper *str) {
+    if (_command_open) {
+        _metrics_sent(_stream->print(str));
+
+        #if BC95_MODULE_DEBUG > 0
+            if (_dbg != NULL) {
+                _dbg->print(str);
+            }
+        #endif
+    }
+}
+
+void NBIoT_BC95::_command_str(const char *str) {
+    if (_command_open) {
+        _metrics_sent(_stream->print(str));
+
+        #if BC95_MODULE_DEBUG > 0
+            if (_dbg != NULL) {
+                _dbg->print(str);
+            }
+        #endif
+    }
+}
+
+void NBIoT_BC95::_command_uint(const uint32_t value, const uint8_t base) {
+    if (_command_open) {
+        _metrics_sent(_stream->print((unsigned long)value, base));
+
+        #if BC95_MODULE_DEBUG > 0
+            if (_dbg != NULL) {
+                _dbg->print((unsigned long)value, base);
+            }
+        #endif
+    }
+}
+
+void NBIoT_BC95::_command_bits(const uint8_t value) {
+    char bits[8];
+
+    if (_command_open) {
+        for (int8_t i = 7; i >= 0; i--) {
+            bits[7 - i] = '0' + _get_bit(value, i);
+        }
+        _metrics_sent(_stream->write((const uint8_t *)bits, sizeof(bits)));
+
+        #if BC95_MODULE_DEBUG > 0
+            if (_dbg != NULL) {
+                _dbg->write((const uint8_t *)bits, sizeof(bits));
+            }
+        #endif
+    }
+}
+
+void NBIoT_BC95::_command_hex(const uint8_t *data, const uint16_t data_len, uint16_t *crc) {
+    char chunk[BC95_HEX_CHUNK_LEN];
+    uint8_t chunk_len = 0;
+
+    if (!_command_open) {
+        return;
+    }
+
+    if (crc != NULL) {
+        *crc = crc16(data, data_len, *crc);
+    }
+
+    for (uint16_t i = 0; i < data_len; i++) {
+        chunk[chunk_len++] = pgm_read_byte(&_hex_digits[data[i] >> 4]);
+        chunk[chunk_len++] = pgm_read_byte(&_hex_digits[data[i] & 0x0F]);
+
+        if (chunk_len == BC95_HEX_CHUNK_LEN || i == data_len - 1) {
+            _metrics_sent(_stream->write((const uint8_t *)chunk, chunk_len));
+
+            #if BC95_MODULE_DEBUG > 0
+                if (_dbg != NULL) {
+                    _dbg->write((const uint8_t *)chunk, chunk_len);
+                }
+            #endif
+
+            chunk_len = 0;
+        }
+    }
+}
+
+uint8_t NBIoT_BC95::_end_command(void) {
+    uint8_t ret = 0;
+
+    if (_command_open) {
+        ret = _stream->write('\n') == 1;
+        _metrics_sent(ret);
+        _stream->flush();
+        _command_open = 0;
+
+        #if BC95_MODULE_DEBUG > 0
+            if (_dbg != NULL) {
+                _dbg->println();
+            }
+        #endif
+    }
+
+    return ret;
+}
+
+uint8_t NBIoT_BC95::_read_line(
+        char *response_buffer,
+        const uint16_t response_buffer_len,
+        uint16_t *resonse_len,
+        const uint32_t timeout)
+{
+    uint8_t done = 0;
+
+    uint32_t lastReceivedByteMillis = _millis();
+
+    if (_op.status == BC95_OP_PENDING) {
+        return 0;
+    }
+
+    _rx_resync();
+    _metrics_wait_begin();
+
+    while ((_millis() - lastReceivedByteMillis < timeout) && !done) {
+        if (_rx_ready()) {
+            lastReceivedByteMillis = _millis();
+
+            // blank lines separate responses, unsolicited reports are consumed here: keep waiting for the response
+            if (_frame_line(response_buffer, response_buffer_len) && _parsed_len > 0 && !_process_urc(response_buffer)) {
+                if (resonse_len != NULL) {
+                    *resonse_len = _parsed_len;
+                }
+
+                #if BC95_MODULE_DEBUG > 0
+                    if (_dbg != NULL) {
+                        _dbg->println("<----");
+                        _dbg->println(response_buffer);
+                    }
+                #endif
+
+                done = 1;
+            }
+        } else {
+            _idle(lastReceivedByteMillis, timeout);
+        }
+    }
+    _metrics_wait_end();
+
+    if (!done) {
+        // a line cut by the timeout is not continued by the next reader
+        _rx_resync();
+        _metrics_timeout();
+        _solicited = 0;
+    }
+
+    return done;
+}
+
+uint8_t NBIoT_BC95::_rx_ready(void) {
+    pump();
+
+    return _rx_head != _rx_tail;
+}
+
+uint8_t NBIoT_BC95::_frame_line(char *line, const uint16_t line_len) {
+    const uint8_t *start, *end;
+    uint16_t count, copy;
+    uint8_t head;
+
+    while (_rx_tail != _rx_head) {
+        // contiguous bytes up to the head or the end of the buffer, whichever comes first
+        head = _rx_head;
+        start = &_rx_buf[_rx_tail];
+        count = (head > _rx_tail) ? head - _rx_tail : BC95_RX_BUFFER_SIZE - _rx_tail;
+
+        end = (const uint8_t *)memchr(start, '\n', count);
+        if (end != NULL) {
+            count = end - start + 1;
+        }
+
+        copy = count - (end != NULL);
+        if (_line_fill + copy > line_len - 1) {
+            if (_line_drop == LINE_KEEP) {
+                _line_drop = LINE_OVERFLOW;
+            }
+            copy = (_line_fill < line_len - 1) ? line_len - 1 - _line_fill : 0;
+        }
+        memcpy(line + _line_fill, start, copy);
+        _line_fill += copy;
+        _rx_tail = (_rx_tail + count) & BC95_RX_BUFFER_MASK;
+        _metrics_received(count);
+
+        if (end != NULL) {
+            while (_line_fill > 0 && line[_line_fill - 1] == '\r') {
+                _line_fill--;
+            }
+
+            if (_line_drop == LINE_OVERFLOW) {
+                _rx_long_lines++;
+
+                #if BC95_MODULE_DEBUG > 0
+                    if (_dbg != NULL) {
+                        _dbg->println("<---- line overflow");
+                    }
+                #endif
+            }
+            if (_line_drop != LINE_KEEP) {
+                _line_fill = 0;
+                _line_drop = LINE_KEEP;
+            }
+
+            line[_line_fill] = '\0';
+            _parsed_len = _line_fill;
+            _line_fill = 0;
+            _metrics_line(line, _parsed_len);
+
+            // past the final result code, +CEREG/+CSCON/+NPSMR are reports again
+            if (_solicited != 0) {
+                uint8_t resp_type = _check_response(line, _parsed_len);
+
+                if (resp_type == BC95_RESPONSE_TYPE_OK || resp_type == BC95_RESPONSE_TYPE_ERROR) {
+                    _solicited = 0;
+                }
+            }
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void NBIoT_BC95::_rx_resync(void) {
+    // the rest of a line cut here is dropped rather than read as a line of its own
+    if ((_line_fill > 0 || _nsorf.active) && _line_drop == LINE_KEEP) {
+        _line_drop = LINE_RESYNC;
+    }
+    _line_fill = 0;
+    _parsed_len = 0;
+    _nsorf.active = 0;
+}
+
+bc95_urc_t NBIoT_BC95::_process_urc(const char *line) {
+    bc95_urc_t urc = BC95_URC_NONE;
+    uint16_t arg1 = 0, arg2 = 0;
+    const char *pchr;
+
+    if (strncmp_P(line, (PGM_P)F("+NSONMI:"), 8) == 0) {
+        // +NSONMI:<socket>,<length>
+        pchr = strchr(line, ',');
+        if (pchr != NULL) {
+            arg1 = strtoul(line + 8, NULL, 10);
+            arg2 = strtoul(++pchr, NULL, 10);
+
+            if (arg1 < BC95_MAX_SOCKETS) {
+                _sockets[arg1].pending += arg2;
+                _sockets[arg1].last_downlink = arg2;
+                _sockets[arg1].downlinks++;
+            }
+            urc = BC95_URC_DOWNLINK;
+        }
+    } else {
+        // a query answers with the same prefix, "+NPSMR:0" with reporting off has a single field too
+        if (strncmp_P(line, (PGM_P)F("+CEREG:"), 7) == 0 && !(_solicited & (1 << BC95_URC_REGISTRATION))) {
+            arg1 = strtoul(line + 7, NULL, 10);
+
+            _link_registered = (arg1 == BC95_NETWORK_STAT_REGISTERED_HOME_NETWORK) ||
+                               (arg1 == BC95_NETWORK_STAT_REGISTERED_ROAMING);
+            if (_link_registered) {
+                _link_checked = _millis();
+            } else {
+                _link_attached = 0;
+            }
+            urc = BC95_URC_REGISTRATION;
+        } else if (strncmp_P(line, (PGM_P)F("+CSCON:"), 7) == 0 && !(_solicited & (1 << BC95_URC_CONNECTION))) {
+            arg1 = strtoul(line + 7, NULL, 10);
+
+            _rrc_connected = (arg1 == 1);
+            // RRC connection is only possible while registered and attached
+            if (_rrc_connected) {
+                _in_psm = 0;
+                _link_confirm();
+            }
+            urc = BC95_URC_CONNECTION;
+        } else if (strncmp_P(line, (PGM_P)F("+NPSMR:"), 7) == 0 && !(_solicited & (1 << BC95_URC_PSM))) {
+            arg1 = strtoul(line + 7, NULL, 10);
+
+            _in_psm = (arg1 == 1);
+            if (_in_psm) {
+                _rrc_connected = 0;
+            }
+            urc = BC95_URC_PSM;
+        }
+    }
+
+    if (urc != BC95_URC_NONE) {
+        #if BC95_MODULE_DEBUG > 0
+            if (_dbg != NULL) {
+                _dbg->println("<URC");
+                _dbg->println(line);
+            }
+        #endif
+
+        if (_urc_handler != NULL) {
+            _urc_handler(urc, arg1, arg2, _urc_handler_ctx);
+        }
+    }
+
+    return urc;
+}
+
+uint8_t NBIoT_BC95::_queried_reports(const __FlashStringHelper *cmd) {
+    PGM_P pcmd = (PGM_P)cmd;
+    char name[8];
+    uint8_t len = 0, queried = 0;
+    char c;
+
+    // every part of a compound line ("AT+CEREG?;+CGATT?;+NPSMR?") counts
+    do {
+        c = pgm_read_byte(pcmd++);
+
+        if (c == ';' || c == '\0') {
+            name[len] = '\0';
+            if (strcmp_P(name, (PGM_P)F("CEREG?")) == 0) {
+                queried |= 1 << BC95_URC_REGISTRATION;
+            } else if (strcmp_P(name, (PGM_P)F("CSCON?")) == 0) {
+                queried |= 1 << BC95_URC_CONNECTION;
+            } else if (strcmp_P(name, (PGM_P)F("NPSMR?")) == 0) {
+                queried |= 1 << BC95_URC_PSM;
+            }
+            len = 0;
+        } else if (c == '+') {
+            len = 0;
+        } else if (len < sizeof(name) - 1) {
+            name[len++] = c;
+        }
+    } while (c != '\0');
+
+    return queried;
+}
+
+uint8_t NBIoT_BC95::_wait_for_downlink(const uint8_t socket, const uint8_t mark, const uint32_t timeout) {
+    uint32_t start = _millis();
+
+    _rx_resync();
+    _metrics_wait_begin();
+
+    // anything but reports is a leftover at this point
+    while (_sockets[socket].downlinks == mark && _millis() - start < timeout) {
+        if (!_rx_ready()) {
+            _idle(start, timeout);
+        } else if (_frame_line(_op_line, sizeof(_op_line)) && _parsed_len > 0) {
+            _process_urc(_op_line);
+        }
+    }
+    _metrics_wait_end();
+
+    return _sockets[socket].downlinks != mark;
+}
+
+uint8_t NBIoT_BC95::_op_start(const bc95_op_type_t type, const bc95_op_stage_t stage, const uint32_t timeout) {
+    _op.type = type;
+    _op.stage = stage;
+    _op.timeout = timeout;
+    _op.result = 0;
+    _op.stage_started = _millis();
+    _op.last_activity = _op.stage_started;
+    _op.status = BC95_OP_PENDING;
+
+    _rx_resync();
+
+    return 1;
+}
+
+void NBIoT_BC95::_op_handle_line(const char *line, const uint16_t line_len) {
+    uint8_t resp_type = _check_response(line, line_len);
+    bc95_fields_t fields;
+
+    if (resp_type == BC95_RESPONSE_TYPE_ERROR) {
+        // includes +NPINGERR
+        if (_op.type == BC95_OP_DNS && _op.stage == OP_STAGE_RESULT) {
+            // the module could not resolve the name
+            _dns_answer(line, _op.host, _op.ip_address);
+        }
+        _op_finish(BC95_OP_FAILED);
+    } else if (_op.stage == OP_STAGE_RESPONSE) {
+        if (resp_type == BC95_RESPONSE_TYPE_DATA && _op.type == BC95_OP_SEND) {
+            if (_parse_response(line, BC95_RESPONSE_SENT, &fields)) {
+                _op.result = fields.value[1];
+            }
+            _op.stage = OP_STAGE_OK;
+        } else if (resp_type == BC95_RESPONSE_TYPE_OK && _op.type == BC95_OP_RECEIVE) {
+            // nothing to read
+            _sockets[_op.socket].pending = 0;
+            _op_finish(BC95_OP_DONE);
+        }
+    } else if (_op.stage == OP_STAGE_OK) {
+        if (resp_type == BC95_RESPONSE_TYPE_OK) {
+            if (_op.type == BC95_OP_RECEIVE || (_op.type == BC95_OP_SEND && _op.timeout == 0)) {
+                _op_finish(BC95_OP_DONE);
+            } else {
+                _op.stage = OP_STAGE_RESULT;
+                _op.stage_started = _millis();
+            }
+        }
+    } else if (_op.type == BC95_OP_PING) {
+        if (_parse_response(line, BC95_RESPONSE_NPING, &fields)) {
+            _op.result = fields.value[2];
+            _op_finish(BC95_OP_DONE);
+        }
+    } else if (_op.type == BC95_OP_DNS) {
+        if (strncmp_P(line, (PGM_P)F("+QDNS:"), 6) == 0) {
+            _op.result = _dns_answer(line, _op.host, _op.ip_address);
+            _op_finish(_op.result ? BC95_OP_DONE : BC95_OP_FAILED);
+        }
+    }
+}
+
+void NBIoT_BC95::_op_finish(const bc95_op_status_t status) {
+    _op.status = status;
+
+    if (_op.type == BC95_OP_SEND || _op.type == BC95_OP_RECEIVE) {
+        if (status == BC95_OP_DONE) {
+            _link_confirm();
+        } else {
+            invalidate_link_state();
+        }
+    }
+
+    if (_op_callback != NULL) {
+        _op_callback(_op.type, status, _op.result, _op_callback_ctx);
+    }
+}
+
+void NBIoT_BC95::_nsorf_begin(void) {
+    memset(&_nsorf, 0x0, sizeof(_nsorf));
+    _nsorf.active = 1;
+}
 
-        uint8_t rssi_raw = 0;
+uint8_t NBIoT_BC95::_nsorf_parse_byte(const uint8_t read_byte, uint8_t *payload, const uint16_t payload_size) {
+    uint8_t done = 0;
 
-        _send_command(F("AT+CSQ"));
+    if (read_byte == '\n') {
+        _nsorf.active = 0;
+        done = 1;
+    } else if (read_byte == ',') {
+        _nsorf.field++;
+    } else if (read_byte == '\r') {
+        // end of line, \n follows
+    } else if (_nsorf.field == 3) {
+        _nsorf.length = _nsorf.length * 10 + (read_byte - '0');
+    } else if (_nsorf.field == 4) {
+        // high nibble is kept with bit 4 set until the low one arrives
+        if (_nsorf.high_nibble) {
+            if (_nsorf.decoded < payload_size) {
+                payload[_nsorf.decoded] = ((_nsorf.high_nibble & 0x0F) << 4) | _hex_char_to_int(read_byte);
+            }
+            _nsorf.decoded++;
+            _nsorf.high_nibble = 0;
+        } else {
+            _nsorf.high_nibble = 0x10 | _hex_char_to_int(read_byte);
+        }
+    } else if (_nsorf.field == 5) {
+        _nsorf.remaining = _nsorf.remaining * 10 + (read_byte - '0');
+    }
 
-        if (_read_line(response_buffer, BC95_MIN_RSP_BUF_LEN, &resp_buf_len) &&
-           (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_DATA) && _wait_for_OK())
-        {
-            pchr = strstr_P(response_buffer, (PGM_P)F(":"));
-            rssi_raw = strtoul(++pchr, NULL, 10);
+    return done;
+}
+
+uint8_t NBIoT_BC95::_nsorf_feed(
+        uint8_t *payload,
+        const uint16_t payload_size,
+        char *response_buffer,
+        const uint16_t response_buffer_len)
+{
+    uint8_t ret = 0;
+    uint8_t first = _rx_buf[_rx_tail];
+
+    // a line starting with a digit is the <socket> field of the data response
+    if (_nsorf.active || (_line_fill == 0 && _line_drop == LINE_KEEP && first >= '0' && first <= '9')) {
+        if (!_nsorf.active) {
+            _nsorf_begin();
         }
 
-        if(rssi_raw >= 0 && rssi_raw <= 31) {
-            rssi_db =  -113 + (rssi_raw << 1);
+        while (!ret && _rx_tail != _rx_head) {
+            if (_nsorf_parse_byte(_rx_buf[_rx_tail], payload, payload_size)) {
+                ret = BC95_RESPONSE_TYPE_NSORF;
+            }
+            _rx_tail = (_rx_tail + 1) & BC95_RX_BUFFER_MASK;
+            _metrics_received(1);
         }
+    } else if (_frame_line(response_buffer, response_buffer_len) && _parsed_len > 0 && !_process_urc(response_buffer)) {
+        // any other line, left in response_buffer
+        ret = BC95_RESPONSE_TYPE_UNKNOWN;
     }
 
-    return rssi_db;
+    return ret;
 }
 
-uint8_t NBIoT_BC95::get_IP_address(char *ip_address) {
-    uint8_t ret = 0;
-
-    if (_is_init && is_registered() && is_attached()) {
-        char response_buffer[BC95_MIN_CMD_BUF_LEN];
-        char *pchr;
-        uint16_t resp_buf_len = 0;
+uint8_t NBIoT_BC95::_read_nsorf(uint8_t *payload, const uint16_t payload_size) {
+    char response_buffer[BC95_MIN_RSP_BUF_LEN];
+    uint8_t line_type = 0;
 
-        _send_command(F("AT+CGPADDR=0"));
+    uint32_t lastReceivedByteMillis = _millis();
 
-        if (_read_line(response_buffer, BC95_MIN_CMD_BUF_LEN, &resp_buf_len) &&
-           (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_DATA))
-        {
-            _wait_for_OK();
+    if (_op.status == BC95_OP_PENDING) {
+        return BC95_RESPONSE_TYPE_TIMEOUT;
+    }
 
-            pchr = strstr_P(response_buffer, (PGM_P)F(","));
-            strcpy(ip_address, ++pchr);
+    _rx_resync();
+    _metrics_wait_begin();
 
-            ret = 1;
+    while ((_millis() - lastReceivedByteMillis < BC95_READ_RESPONSE_TIMEOUT) && !line_type) {
+        if (_rx_ready()) {
+            line_type = _nsorf_feed(payload, payload_size, response_buffer, sizeof(response_buffer));
+            lastReceivedByteMillis = _millis();
+        } else {
+            _idle(lastReceivedByteMillis, BC95_READ_RESPONSE_TIMEOUT);
         }
     }
+    _metrics_wait_end();
+
+    if (line_type == BC95_RESPONSE_TYPE_UNKNOWN) {
+        // OK (nothing to read), ERROR, ...
+        line_type = _check_response(response_buffer, _parsed_len);
+    } else if (line_type == 0) {
+        line_type = BC95_RESPONSE_TYPE_TIMEOUT;
+        _rx_resync();
+    }
 
-    return ret;
+    return line_type;
 }
 
-uint8_t NBIoT_BC95::get_IMEI(char *imei) {
-    uint8_t ret = 0;
-    char *pchr;
+uint32_t NBIoT_BC95::_segments_size(const bc95_segment_t *segments, const uint8_t segment_count, const bc95_crc_t crc) {
+    uint32_t size = (crc == BC95_CRC16_CCITT) ? BC95_CRC16_SIZE : 0;
 
-    char response_buffer[BC95_MIN_CMD_BUF_LEN];
+    for (uint8_t i = 0; i < segment_count; i++) {
+        size += segments[i].size;
+    }
 
-    uint16_t resp_buf_len;
+    return size;
+}
 
-    _send_command(F("AT+CGSN=1"));
+void NBIoT_BC95::_send_nsost(
+        const uint8_t socket,
+        const char *remote_host,
+        const uint16_t remote_port,
+        const bc95_segment_t *segments,
+        const uint8_t segment_count,
+        const bc95_crc_t crc,
+        const bc95_release_t release)
+{
+    uint16_t check = BC95_CRC16_INIT;
+
+    // AT+NSOST[F]=<socket>,<remote_addr>,<remote_port>,[<flag>,]<length>,<data>
+    _begin_command(release == BC95_RELEASE_NONE ? F("AT+NSOST=") : F("AT+NSOSTF="));
+    _command_uint(socket);
+    _command_str(F(","));
+    _command_str(remote_host);
+    _command_str(F(","));
+    _command_uint(remote_port);
+    if (release != BC95_RELEASE_NONE) {
+        _command_str(F(",0x"));
+        _command_uint(release, HEX);
+    }
+    _command_str(F(","));
+    _command_uint(_segments_size(segments, segment_count, crc));
+    _command_str(F(","));
+    // each segment from where it lies, the check value computed on the way
+    for (uint8_t i = 0; i < segment_count; i++) {
+        _command_hex(segments[i].data, segments[i].size, (crc == BC95_CRC16_CCITT) ? &check : NULL);
+    }
+    if (crc == BC95_CRC16_CCITT) {
+        uint8_t trailer[BC95_CRC16_SIZE] = { (uint8_t)(check >> 8), (uint8_t)check };
 
-    if (_read_line(response_buffer, BC95_MIN_CMD_BUF_LEN, &resp_buf_len) &&
-       (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_DATA) && _wait_for_OK())
-    {
-        pchr = strstr_P(response_buffer, (PGM_P)F(":"));
-        strcpy(imei, ++pchr);
+        _command_hex(trailer, sizeof(trailer));
+    }
+    _end_command();
+}
 
-        ret = 1;
+uint8_t NBIoT_BC95::_check_response(const char *response_buffer, const uint16_t response_len) {
+    uint8_t ret = BC95_RESPONSE_TYPE_TIMEOUT;
+
+    if (response_len == 2 && response_buffer[0] == 'O' && response_buffer[1] == 'K') {
+        ret = BC95_RESPONSE_TYPE_OK;
+    } else if (strstr_P(response_buffer, (PGM_P)F("ERR")) != NULL) {
+        ret = BC95_RESPONSE_TYPE_ERROR;
+    } else {
+        ret = BC95_RESPONSE_TYPE_DATA;
     }
 
     return ret;
 }
 
-uint8_t NBIoT_BC95::get_ICCID(char * iccid) {
-    uint8_t ret = 0;
+uint8_t NBIoT_BC95::_wait_for_OK(const uint32_t timeout) {
+    char response_buffer[BC95_MIN_RSP_BUF_LEN];
+    uint16_t resp_buf_len = 0;
+    return _read_line(response_buffer, BC95_MIN_RSP_BUF_LEN, &resp_buf_len, timeout) &&
+           (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_OK);
+}
+
+uint8_t NBIoT_BC95::_parse_response(const char *line, const uint8_t response, bc95_fields_t *fields) {
+    bc95_response_desc_t desc;
+    char ip_address[BC95_IP_ADDRESS_LEN];
+    const char *end;
+    uint16_t len;
+    uint32_t value;
+    uint8_t prefix_len, type, i;
+
+    memcpy_P(&desc, &_responses[response], sizeof(desc));
+    memset(fields->value, 0x0, sizeof(fields->value));
+    fields->count = 0;
 
+    prefix_len = strlen(desc.prefix);
+    if (strncmp(line, desc.prefix, prefix_len) != 0) {
+        return 0;
+    }
+    line += prefix_len;
+
+    // single pass, every field is checked against its type and length as it is reached
+    for (i = 0; i < desc.max_fields; i++) {
+        if (i > 0) {
+            if (*line != ',') {
+                break;
+            }
+            line++;
+        }
+
+        type = desc.fields[i];
+        end = (type == BC95_FIELD_TEXT) ? NULL : strchr(line, ',');
+        len = (end != NULL) ? end - line : strlen(line);
+
+        if (type == BC95_FIELD_UINT || type == BC95_FIELD_BITS) {
+            if ((type == BC95_FIELD_UINT && (len == 0 || len > 9)) || len > 32) {
+                return 0;
+            }
+            for (value = 0, end = line; end < line + len; end++) {
+                if (type == BC95_FIELD_UINT && *end >= '0' && *end <= '9') {
+                    value = value * 10 + (*end - '0');
+                } else if (type == BC95_FIELD_BITS && (*end == '0' || *end == '1')) {
+                    value = (value << 1) | (*end - '0');
+                } else {
+                    return 0;
+                }
+            }
+            fields->value[i] = value;
+        } else if (type == BC95_FIELD_IPV4) {
+            if (len >= sizeof(ip_address)) {
+                return 0;
+            }
+            memcpy(ip_address, line, len);
+            ip_address[len] = '\0';
+            if (!_parse_ipv4(ip_address, fields->ip)) {
+                return 0;
+            }
+        } else if (type == BC95_FIELD_TEXT) {
+            if (len == 0 || len > desc.text_len) {
+                return 0;
+            }
+            memcpy(fields->text, line, len);
+            fields->text[len] = '\0';
+        }
+
+        line += len;
+    }
+
+    fields->count = i;
+
+    return (i >= desc.min_fields);
+}
+
+uint8_t NBIoT_BC95::_read_response(
+        const uint8_t response,
+        bc95_fields_t *fields,
+        const uint32_t timeout,
+        const uint8_t ok_follows)
+{
     char response_buffer[BC95_MIN_CMD_BUF_LEN];
     uint16_t resp_buf_len = 0;
 
-    char *pchr;
+    // the OK is consumed before parsing, a malformed line does not leave it behind
+    return _read_line(response_buffer, sizeof(response_buffer), &resp_buf_len, timeout) &&
+           (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_DATA) &&
+           (!ok_follows || _wait_for_OK()) &&
+           _parse_response(response_buffer, response, fields);
+}
 
-    _send_command(F("AT+NCCID"));
+uint8_t NBIoT_BC95::_ping_module(uint8_t times) {
+    uint8_t ret = 0;
 
-    if (_read_line(response_buffer, BC95_MIN_CMD_BUF_LEN, &resp_buf_len) &&
-       (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_DATA) && _wait_for_OK())
-    {
-        pchr = strstr_P(response_buffer, (PGM_P)F(":"));
-        strcpy(iccid, ++pchr);
-        ret = 1;
+    while(!ret && times) {
+        _send_command(F("AT"));
+        ret = _wait_for_OK();
+        times--;
     }
 
     return ret;
 }
 
-/******* Misc Funcions *******/
-
-uint8_t NBIoT_BC95::reboot(void) {
-    uint8_t ret = 0;
+uint8_t NBIoT_BC95::_wait_for_ready(const uint32_t timeout) {
     char response_buffer[BC95_MIN_RSP_BUF_LEN];
     uint16_t resp_buf_len = 0;
+    uint32_t start = _millis();
+    uint32_t interval = BC95_STARTUP_POLL_MIN_INTERVAL;
+    uint8_t ready = 0;
 
-    _send_command(F("AT+NRB"));
+    while (!ready && _millis() - start < timeout) {
+        _send_command(F("AT"));
 
-    if (_read_line(response_buffer, BC95_MIN_RSP_BUF_LEN, &resp_buf_len, BC95_DEFAULT_REBOOT_TIMEOUT) &&
-        (_check_response(response_buffer, resp_buf_len) != BC95_RESPONSE_TYPE_DATA))
-    {
-        if (strstr_P(response_buffer, (PGM_P)F("REBOOTING")) != NULL) {
-            ret = 1;
+        // boot messages keep the wait going, the OK closing the boot sequence or answering AT ends it
+        while (!ready && _read_line(response_buffer, BC95_MIN_RSP_BUF_LEN, &resp_buf_len, interval)) {
+            ready = (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_OK);
+        }
+
+        if (interval < BC95_STARTUP_POLL_MAX_INTERVAL) {
+            interval <<= 1;
         }
     }
 
-    return ret;
+    return ready;
 }
 
-
-/* BC95 Modem Private Functions */
-
-uint8_t NBIoT_BC95::_send_command(const char *cmd) {
+uint8_t NBIoT_BC95::_read_baud_rate(void) {
+    bc95_fields_t fields;
     uint8_t ret = 0;
 
-    #if BC95_DEBUG_MODE > 0
-        _dbg->println("---->");
-        _dbg->println(cmd);
-    #endif
-
-    _flushInput();
+    _send_command(F("AT+NATSPEED?"));
 
-    ret += _stream->print(cmd);
-    ret += _stream->write('\n');
-    _stream->flush();
+    if (_read_response(BC95_RESPONSE_NATSPEED, &fields)) {
+        // the module runs at its stored rate until told otherwise
+        _baud_rate = fields.value[0];
+        _stored_baud_rate = _baud_rate;
+        ret = (_baud_rate != 0);
+    }
 
     return ret;
 }
 
-uint8_t NBIoT_BC95::_send_command(const __FlashStringHelper *cmd) {
-    char str_tmp[75 +1];
+void NBIoT_BC95::_switch_host_baud_rate(const uint32_t baud_rate) {
+    // let the last command leave the UART at the old rate
+    _stream->flush();
+    _baud_callback(baud_rate, _baud_callback_ctx);
+}
+
+int8_t NBIoT_BC95::_dns_cached(const char *host, char *ip_address) {
+    bc95_dns_entry_t *entry;
+    uint8_t ip[4];
+    int8_t ret = -1;
 
-    strcpy_P(str_tmp, (PGM_P)cmd);
+    if (_parse_ipv4(host, ip)) {
+        // nothing to resolve
+        _format_ipv4(ip, ip_address);
+        ret = 1;
+    } else if ((entry = _dns_find(host)) != NULL) {
+        if (entry->state == DNS_RESOLVED) {
+            _format_ipv4(entry->ip, ip_address);
+            ret = 1;
+        } else {
+            ret = 0;
+        }
+        entry->used = ++_dns_tick;
+        _dns_hits++;
+    }
 
-    return _send_command(str_tmp);
+    return ret;
 }
 
-uint8_t NBIoT_BC95::_read_line(
-        char *response_buffer,
-        const uint16_t response_buffer_len,
-        uint16_t *resonse_len,
-        const uint32_t timeout)
-{
-    uint8_t done = 0;
-    bc95_cmd_parser_state_t cur_parser_state = START_CR;
-    uint16_t parsed_str_len = 0;
-    uint8_t read_byte = 0;
+#if BC95_DNS_CACHE_SIZE > 0
+NBIoT_BC95::bc95_dns_entry_t *NBIoT_BC95::_dns_find(const char *host) {
+    bc95_dns_entry_t *entry = NULL;
+    uint32_t ttl;
 
-    uint32_t lastReceivedByteMillis = millis();
+    for (uint8_t i = 0; i < BC95_DNS_CACHE_SIZE && entry == NULL; i++) {
+        if (_dns_cache[i].state != DNS_EMPTY) {
+            ttl = (_dns_cache[i].state == DNS_RESOLVED) ? _dns_ttl : _dns_negative_ttl;
 
-    while ((millis() - lastReceivedByteMillis < timeout) && !done) {
-        if (_stream->available()) {
-            read_byte = _stream->read();
+            if (_millis() - _dns_cache[i].stored_at >= ttl) {
+                _dns_cache[i].state = DNS_EMPTY;
+            } else if (strcmp(_dns_cache[i].host, host) == 0) {
+                entry = &_dns_cache[i];
+            }
+        }
+    }
 
-            if (cur_parser_state == NBIoT_BC95::START_CR) {
-                if (read_byte == '\r') {
-                    cur_parser_state = START_LF;
-                    lastReceivedByteMillis = millis();
-                }
-            } else if (cur_parser_state == NBIoT_BC95::START_LF) {
-                if (read_byte == '\n') {
-                    cur_parser_state = PAYLOAD;
-                    lastReceivedByteMillis = millis();
-                } else {
-                    // wrong sequence
-                    cur_parser_state = START_CR;
-                    parsed_str_len = 0;
-                }
-            } else if (cur_parser_state == NBIoT_BC95::PAYLOAD) {
-                if (read_byte == '\r') {
-                    cur_parser_state = END_LF;
-                    lastReceivedByteMillis = millis();
-                } else if (parsed_str_len >= (response_buffer_len-1)) {
-                    // buffer overflow
-                    cur_parser_state = START_CR;
-                    parsed_str_len = 0;
-                } else {
-                    response_buffer[parsed_str_len++] = read_byte;
-                    lastReceivedByteMillis = millis();
-                }
-            } else if (cur_parser_state == NBIoT_BC95::END_LF) {
-                if (read_byte == '\n') {
-                    response_buffer[parsed_str_len] = '\0';
+    return entry;
+}
 
-                    if (resonse_len != NULL) {
-                        *resonse_len = parsed_str_len;
-                    }
+void NBIoT_BC95::_dns_store(const char *host, const uint8_t *ip) {
+    bc95_dns_entry_t *entry;
 
-                    #if BC95_DEBUG_MODE > 0
-                        _dbg->println("<----");
-                        _dbg->println(response_buffer);
-                    #endif
+    if (strlen(host) > BC95_DNS_MAX_HOST_LEN || (ip != NULL ? _dns_ttl : _dns_negative_ttl) == 0) {
+        return;
+    }
 
-                    done = 1;
-                } else {
-                    // wrong sequence
-                    cur_parser_state = START_CR;
-                    parsed_str_len = 0;
-                }
+    entry = _dns_find(host);
+    for (uint8_t i = 0; i < BC95_DNS_CACHE_SIZE && entry == NULL; i++) {
+        if (_dns_cache[i].state == DNS_EMPTY) {
+            entry = &_dns_cache[i];
+        }
+    }
+    if (entry == NULL) {
+        // least recently used, ages are counted in lookups
+        entry = &_dns_cache[0];
+        for (uint8_t i = 1; i < BC95_DNS_CACHE_SIZE; i++) {
+            if ((uint8_t)(_dns_tick - _dns_cache[i].used) > (uint8_t)(_dns_tick - entry->used)) {
+                entry = &_dns_cache[i];
             }
         }
     }
 
-    return done;
+    strcpy(entry->host, host);
+    if (ip != NULL) {
+        memcpy(entry->ip, ip, sizeof(entry->ip));
+    }
+    entry->state = (ip != NULL) ? DNS_RESOLVED : DNS_FAILED;
+    entry->stored_at = _millis();
+    entry->used = ++_dns_tick;
 }
 
-uint8_t NBIoT_BC95::_check_response(const char *response_buffer, const uint16_t response_len) {
-    uint8_t ret = BC95_RESPONSE_TYPE_TIMEOUT;
+void NBIoT_BC95::_dns_flush(const char *host) {
+    for (uint8_t i = 0; i < BC95_DNS_CACHE_SIZE; i++) {
+        if (host == NULL || strcmp(_dns_cache[i].host, host) == 0) {
+            _dns_cache[i].state = DNS_EMPTY;
+        }
+    }
+}
+#endif
 
-    if (response_len == 2 && response_buffer[0] == 'O' && response_buffer[1] == 'K') {
-        ret = BC95_RESPONSE_TYPE_OK;
-    } else if (strstr_P(response_buffer, (PGM_P)F("ERR")) != NULL) {
-        ret = BC95_RESPONSE_TYPE_ERROR;
-    } else {
-        ret = BC95_RESPONSE_TYPE_DATA;
+uint8_t NBIoT_BC95::_dns_answer(const char *line, const char *host, char *ip_address) {
+    bc95_fields_t fields;
+    uint8_t ret = 0;
+
+    // an error line means the name does not resolve
+    if (_parse_response(line, BC95_RESPONSE_QDNS, &fields)) {
+        _format_ipv4(fields.ip, ip_address);
+        _dns_store(host, fields.ip);
+        ret = 1;
+    } else if (_check_response(line, strlen(line)) == BC95_RESPONSE_TYPE_ERROR) {
+        _dns_store(host, NULL);
     }
 
     return ret;
 }
 
-uint8_t NBIoT_BC95::_wait_for_OK(const uint32_t timeout) {
-    char response_buffer[BC95_MIN_RSP_BUF_LEN];
+uint8_t NBIoT_BC95::_read_autoconnect(uint8_t *autoconnect) {
+    char response_buffer[BC95_MIN_RSP_BUF_LEN*3];
     uint16_t resp_buf_len = 0;
-    return _read_line(response_buffer, BC95_MIN_RSP_BUF_LEN, &resp_buf_len, timeout) &&
-           (_check_response(response_buffer, resp_buf_len) == BC95_RESPONSE_TYPE_OK);
+    uint8_t resp_type = BC95_RESPONSE_TYPE_TIMEOUT;
+    uint8_t found = 0;
+
+    // one +NCONFIG:<function>,<value> line per setting
+    _send_command(F("AT+NCONFIG?"));
+
+    while (_read_line(response_buffer, sizeof(response_buffer), &resp_buf_len) &&
+          (resp_type = _check_response(response_buffer, resp_buf_len)) == BC95_RESPONSE_TYPE_DATA)
+    {
+        if (strncmp_P(response_buffer, (PGM_P)F("+NCONFIG:AUTOCONNECT,"), 21) == 0) {
+            *autoconnect = (strncmp_P(response_buffer + 21, (PGM_P)F("TRUE"), 4) == 0);
+            found = 1;
+        }
+    }
+
+    return found && resp_type == BC95_RESPONSE_TYPE_OK;
 }
 
-uint8_t NBIoT_BC95::_ping_module(uint8_t times) {
-    uint8_t ret = 0;
+uint8_t NBIoT_BC95::_set_autoconnect(const uint8_t autoconnect) {
+    _send_command(autoconnect ? F("AT+NCONFIG=AUTOCONNECT,TRUE") : F("AT+NCONFIG=AUTOCONNECT,FALSE"));
 
-    while(!ret && times) {
-        _send_command(F("AT"));
-        ret = _wait_for_OK();
-        times--;
+    return _wait_for_OK();
+}
+
+uint8_t NBIoT_BC95::_link_ready(void) {
+    // pick up +CEREG/+CSCON reports waiting in the input
+    _flushInput();
+
+    if (_link_registered && _link_attached && (_millis() - _link_checked < _link_ttl)) {
+        return 1;
     }
 
-    return ret;
+    return _ping_module(5) && is_registered() && is_attached();
+}
+
+void NBIoT_BC95::_link_confirm(void) {
+    _link_registered = 1;
+    _link_attached = 1;
+    _link_checked = _millis();
 }
 
+uint8_t NBIoT_BC95::_socket_open(const uint8_t socket) {
+    return socket < BC95_MAX_SOCKETS && _sockets[socket].open;
+}
+
+#if BC95_METRICS > 0
+void NBIoT_BC95::_metrics_begin(const __FlashStringHelper *cmd) {
+    PGM_P pcmd = (PGM_P)cmd;
+    char command[BC95_METRICS_COMMAND_LEN + 3];
+    const char *name = command;
+    uint8_t len = 0, i;
+    char c;
+
+    // the previous command never got its final result code
+    _metrics_timeout();
+
+    // "AT+NSOST=1,..." is tracked as "NSOST=", commands without '+' as they are ("AT", "ATE0")
+    do {
+        c = pgm_read_byte(pcmd++);
+        if (c == '\0' || c == ';') {
+            break;
+        }
+        command[len++] = c;
+    } while (c != '=' && c != '?' && len < sizeof(command) - 1);
+    // compound commands ("AT+CEREG?;+CGATT?;...") take as long as all their parts, they go apart as "CEREG?;"
+    while (c != '\0' && c != ';') {
+        c = pgm_read_byte(pcmd++);
+    }
+    if (c == ';' && len < sizeof(command) - 1) {
+        command[len++] = ';';
+    }
+    command[len] = '\0';
+
+    if (strncmp_P(command, (PGM_P)F("AT+"), 3) == 0) {
+        name += 3;
+    }
+    if (strlen(name) >= BC95_METRICS_COMMAND_LEN) {
+        name = "*";
+    }
+
+    for (i = 0; i < BC95_METRICS_COMMANDS - 1; i++) {
+        if (_metrics[i].command[0] == '\0') {
+            strcpy(_metrics[i].command, name);
+        }
+        if (strcmp(_metrics[i].command, name) == 0) {
+            break;
+        }
+    }
+    if (i == BC95_METRICS_COMMANDS - 1) {
+        // table full, the last entry collects the rest
+        strcpy(_metrics[i].command, "*");
+    }
+
+    _metrics_open = &_metrics[i];
+    _metrics_open->count++;
+    _metrics_started = _millis();
+}
+
+void NBIoT_BC95::_metrics_line(const char *line, const uint16_t line_len) {
+    bc95_command_metrics_t *metrics = _metrics_open;
+    uint8_t resp_type;
+    uint32_t latency;
+    uint8_t bucket;
+
+    if (metrics == NULL || line_len == 0) {
+        return;
+    }
+
+    resp_type = _check_response(line, line_len);
+    if (resp_type != BC95_RESPONSE_TYPE_OK && resp_type != BC95_RESPONSE_TYPE_ERROR) {
+        return;
+    }
+
+    latency = _millis() - _metrics_started;
+    if (resp_type == BC95_RESPONSE_TYPE_ERROR) {
+        metrics->errors++;
+    }
+    // count was incremented when the command was sent, this is its first completion if count - timeouts is 1
+    if (metrics->count - metrics->timeouts == 1 || latency < metrics->latency_min) {
+        metrics->latency_min = latency;
+    }
+    if (latency > metrics->latency_max) {
+        metrics->latency_max = latency;
+    }
+    metrics->latency_sum += latency;
+
+    for (bucket = 0; bucket < BC95_METRICS_BUCKETS - 1 && latency >= pgm_read_word(&_metrics_bounds[bucket]); bucket++);
+    if (metrics->histogram[bucket] < 0xFFFF) {
+        metrics->histogram[bucket]++;
+    }
+
+    _metrics_open = NULL;
+}
+
+void NBIoT_BC95::_metrics_timeout(void) {
+    if (_metrics_open != NULL) {
+        _metrics_open->timeouts++;
+        _metrics_open = NULL;
+    }
+}
+#endif
+
 void NBIoT_BC95::_flushInput(void) {
-    while (_stream->available()) _stream->read();
+    uint32_t lastReceivedByteMillis = _millis();
+
+    if (_op.status == BC95_OP_PENDING) {
+        return;
+    }
+
+    _metrics_wait_begin();
+
+    // drop stale responses but dispatch the unsolicited reports among them,
+    // a report arriving right now is completed rather than cut by the next command
+    while (_rx_ready() ||
+          ((_line_fill > 0 || _line_drop != LINE_KEEP) && _millis() - lastReceivedByteMillis < BC95_READ_RESPONSE_TIMEOUT))
+    {
+        if (_rx_ready()) {
+            lastReceivedByteMillis = _millis();
+            if (_frame_line(_op_line, sizeof(_op_line)) && _parsed_len > 0) {
+                _process_urc(_op_line);
+            }
+        } else {
+            _idle(lastReceivedByteMillis, BC95_READ_RESPONSE_TIMEOUT);
+        }
+    }
+    _metrics_wait_end();
+}
+
+void NBIoT_BC95::_idle(const uint32_t since, const uint32_t timeout) {
+    #if BC95_METRICS > 0
+        uint32_t idle_started = micros();
+
+        _idle_stats.empty_polls++;
+    #endif
+
+    switch (_idle_mode) {
+        case BC95_IDLE_YIELD:
+            yield();
+            break;
+
+        case BC95_IDLE_SLEEP:
+            // the UART receive interrupt or the next millis() tick wakes the MCU
+            #if defined(__AVR__)
+                set_sleep_mode(SLEEP_MODE_IDLE);
+                sleep_mode();
+            #elif defined(__arm__)
+                __WFI();
+            #else
+                yield();
+            #endif
+            break;
+
+        case BC95_IDLE_CALLBACK:
+            if (_idle_callback != NULL) {
+                uint32_t elapsed = _millis() - since;
+
+                _idle_callback(elapsed < timeout ? timeout - elapsed : 0, _idle_callback_ctx);
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    #if BC95_METRICS > 0
+        _idle_stats.idle_us += (uint32_t)(micros() - idle_started);
+    #endif
+
+    // a virtual clock moves on while the library waits
+    if (_delay_fn != NULL) {
+        _delay_fn(1, _time_ctx);
+    }
 }
 
 uint8_t _hex_char_to_int(const char c) {
@@ -743,6 +2389,35 @@ uint8_t _hex_char_to_int(const char c) {
     }
 }
 
+uint8_t _parse_ipv4(const char *str, uint8_t *ip) {
+    uint16_t octet;
+    uint8_t i, digits;
+
+    // exactly four dot-separated decimal octets
+    for (i = 0; i < 4; i++) {
+        octet = 0;
+        for (digits = 0; *str >= '0' && *str <= '9' && digits < 4; digits++) {
+            octet = octet * 10 + (*str++ - '0');
+        }
+        if (digits == 0 || digits > 3 || octet > 255 || *str != ((i < 3) ? '.' : '\0')) {
+            return 0;
+        }
+        ip[i] = octet;
+        str++;
+    }
+
+    return 1;
+}
+
+void _format_ipv4(const uint8_t *ip, char *str) {
+    sprintf_P(str, (PGM_P)F("%u.%u.%u.%u"), ip[0], ip[1], ip[2], ip[3]);
+}
+
+int8_t _csq_to_dbm(const uint32_t rssi) {
+    // 0..31 in 2 dB steps from -113 dBm, 99 is not known or not detectable
+    return (rssi <= 31) ? -113 + (int8_t)(rssi << 1) : 0;
+}
+
 uint8_t _is_valid_listen_port(uint16_t port) {
     /* Note: consult AT Commands Manual, command AT+NSOCR */
     return (port != 5683 && port != 5684 && port != 56830 && port != 56831 && port != 56833);
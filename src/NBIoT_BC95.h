@@ -4,11 +4,73 @@
 #include <Arduino.h>
 
 /******* Defines *******/
+// AT traffic echoed to the debug stream given to the constructor
+#ifndef BC95_MODULE_DEBUG
 #define BC95_MODULE_DEBUG                       (0)
+#endif
+// Per command metrics (see get_command_metrics()), compiled out unless defined to 1
+#ifndef BC95_METRICS
+#define BC95_METRICS                            (0)
+#endif
+// Command types tracked, the last entry collects the commands that do not fit
+#ifndef BC95_METRICS_COMMANDS
+#define BC95_METRICS_COMMANDS                   (16)
+#endif
+// Command name up to its '=' or '?', e.g. "NATSPEED="
+#define BC95_METRICS_COMMAND_LEN                (10)
+// Latency histogram buckets, upper bounds of all but the last in _metrics_bounds[]
+#define BC95_METRICS_BUCKETS                    (8)
 
 #define BC95_MAX_PACKET_SIZE                    (255)
+// AT+NSOST data length limit (Note: See BC95 AT Commands Manual)
+#define BC95_NSOST_MAX_PAYLOAD_SIZE             (512)
+// AT+NSORF data length limit (Note: See BC95 AT Commands Manual)
+#define BC95_NSORF_MAX_PAYLOAD_SIZE             (1358)
+// UDP sockets handled by the module (AT+NSOCR), handles are the module socket ids
+#define BC95_MAX_SOCKETS                        (7)
+#define BC95_INVALID_SOCKET                     (0xFF)
 #define BC95_CONNECTION_TIMEOUT                 (30000)
 #define BC95_READ_RESPONSE_TIMEOUT              (300)
+// How long initialize() waits for the module to answer after power-on or reset
+#define BC95_STARTUP_TIMEOUT                    (15000)
+// AT polling interval while the module boots, doubled after every unanswered poll
+#define BC95_STARTUP_POLL_MIN_INTERVAL          (25)
+#define BC95_STARTUP_POLL_MAX_INTERVAL          (800)
+// Resolver cache in front of query_dns(), hostnames longer than BC95_DNS_MAX_HOST_LEN are not cached.
+// An entry takes 43 bytes of RAM on AVR, 0 compiles the cache out
+#ifndef BC95_DNS_CACHE_SIZE
+#ifdef __AVR__
+#define BC95_DNS_CACHE_SIZE                     (1)
+#else
+#define BC95_DNS_CACHE_SIZE                     (4)
+#endif
+#endif
+#define BC95_DNS_MAX_HOST_LEN                   (31)
+#define BC95_DNS_CACHE_TTL                      (3600000)
+#define BC95_DNS_NEGATIVE_TTL                   (60000)
+// Dotted IPv4 address, "255.255.255.255"
+#define BC95_IP_ADDRESS_LEN                     (16)
+// Info getter buffers: IMEI (15 digits), ICCID (up to 20 digits) and "yy/mm/dd,hh:mm:ss+zz"
+#define BC95_IMEI_LEN                           (16)
+#define BC95_ICCID_LEN                          (21)
+#define BC95_DATE_TIME_LEN                      (21)
+// Module UART rate out of the factory
+#define BC95_DEFAULT_BAUD_RATE                  (9600)
+// Seconds the module keeps a new baud rate without receiving a valid command (AT+NATSPEED <timeout>)
+#define BC95_NATSPEED_TIMEOUT                   (3)
+// How long a confirmed registration/attachment is trusted before querying the modem again
+#define BC95_LINK_STATE_TTL                     (60000)
+// Longest line (other than +NSORF data) parsed by asynchronous operations, e.g. +NPING:<ip>,<ttl>,<rtt>
+#define BC95_ASYNC_LINE_BUF_LEN                 (40)
+// Fields parsed from one command response line, the longest is +NBAND:<band>[,<band>[...]]
+#define BC95_RESPONSE_MAX_FIELDS                (6)
+// Receive ring buffer between the UART and the line framing, a power of two up to 256
+#ifndef BC95_RX_BUFFER_SIZE
+#define BC95_RX_BUFFER_SIZE                     (64)
+#endif
+#if (BC95_RX_BUFFER_SIZE & (BC95_RX_BUFFER_SIZE - 1)) || BC95_RX_BUFFER_SIZE > 256
+#error "BC95_RX_BUFFER_SIZE must be a power of two up to 256"
+#endif
 
 // Power saving modes
 enum bc95_psm_mode_t {
@@ -46,6 +108,9 @@ enum bc95_band_t {
     BC95_BAND_28                                                = 28
 };
 
+// Bands supported by the module (AT+NBAND)
+#define BC95_MAX_BANDS                          (6)
+
 enum bc95_network_attachment_state_t {
     BC95_NETWORK_DETACH                                         = 0,
     BC95_NETWORK_ATTACH
@@ -56,6 +121,27 @@ enum bc95_modem_functionality_level_t {
     BC95_MODEM_FUNCIONALITY_LEVEL_FULL
 };
 
+// Release Assistance Indication (AT+NSOSTF <flag>)
+enum bc95_release_t {
+    BC95_RELEASE_NONE                                           = 0x000,  // plain AT+NSOST
+    BC95_RELEASE_AFTER_UPLINK                                   = 0x200,  // no reply expected
+    BC95_RELEASE_AFTER_DOWNLINK                                 = 0x400   // one reply expected
+};
+
+// Part of a datagram sent from where it lies, see the scatter-gather send_UDP_datagram()
+typedef struct {
+    const uint8_t *         data;
+    uint16_t                size;
+} bc95_segment_t;
+
+// Check value appended after the last segment
+enum bc95_crc_t {
+    BC95_CRC_NONE                                               = 0,
+    BC95_CRC16_CCITT                                                      // CRC-16/CCITT-FALSE, 2 bytes big endian
+};
+#define BC95_CRC16_INIT                         (0xFFFF)
+#define BC95_CRC16_SIZE                         (2)
+
 enum bc95_led_mode_t {
     BC95_LED_DISABLED = 0,
     BC95_LED_ENABLED
@@ -83,6 +169,144 @@ typedef struct {
     active_time_timer_t     active_time_timer_config;
 } bc95_psm_config_t;
 
+// Desired module configuration, see NBIoT_BC95::apply_config_profile()
+typedef struct {
+    uint8_t                 autoconnect;                // AT+NCONFIG=AUTOCONNECT
+    uint8_t                 nbands;                     // 0 leaves the bands as they are
+    bc95_band_t             bands[BC95_MAX_BANDS];      // AT+NBAND, order does not matter
+    bc95_psm_config_t       psm_config;                 // AT+CPSMS
+} bc95_config_profile_t;
+
+// Settings written by NBIoT_BC95::apply_config_profile()
+enum bc95_config_change_t {
+    BC95_CONFIG_UNCHANGED                                       = 0x00,
+    BC95_CONFIG_AUTOCONNECT                                     = 0x01,
+    BC95_CONFIG_BANDS                                           = 0x02,  // includes an AT+CFUN=0/1 cycle
+    BC95_CONFIG_PSM                                             = 0x04
+};
+
+// Link and radio state, see NBIoT_BC95::get_status()
+typedef struct {
+    uint8_t                 registered;                 // AT+CEREG, home network or roaming
+    uint8_t                 attached;                   // AT+CGATT
+    uint8_t                 psm;                        // AT+NPSMR, in power saving mode
+    int8_t                  rssi;                       // AT+CSQ, dBm, 0 if not known
+    char                    ip_address[BC95_IP_ADDRESS_LEN];    // AT+CGPADDR, empty if none
+} bc95_status_t;
+
+// Metrics of one command type, see NBIoT_BC95::get_command_metrics()
+typedef struct {
+    char                    command[BC95_METRICS_COMMAND_LEN];  // "CEREG?", "NSOST=", "AT", "*" for the rest,
+                                                                // "CEREG?;" for a compound command starting with it
+    uint32_t                count;                      // commands sent
+    uint16_t                timeouts;                   // no final result code
+    uint16_t                errors;                     // ERROR final result code
+    uint32_t                tx_bytes;                   // command bytes
+    uint32_t                rx_bytes;                   // bytes read until the final result code
+    uint32_t                latency_min;                // ms from the command to OK/ERROR, timeouts excluded
+    uint32_t                latency_max;
+    uint32_t                latency_sum;                // mean is latency_sum / (count - timeouts)
+    uint16_t                histogram[BC95_METRICS_BUCKETS];  // <10, <30, <100, <300, <1000, <3000, <10000 ms, longer
+} bc95_command_metrics_t;
+
+// Time spent waiting for the module, see NBIoT_BC95::get_idle_stats()
+typedef struct {
+    uint32_t                waits;                      // wait loops: response lines, reports, stale input flushes
+    uint32_t                empty_polls;                // UART polls that found nothing, each followed by the idle strategy
+    uint64_t                wait_us;                    // time spent waiting, micros()
+    uint64_t                idle_us;                    // part of it spent in the idle strategy, the rest is busy polling
+} bc95_idle_stats_t;
+
+// Asynchronous operations
+enum bc95_op_type_t {
+    BC95_OP_NONE                                                = 0,
+    BC95_OP_SEND                                                   ,  // begin_send_UDP_datagram()
+    BC95_OP_RECEIVE                                                ,  // begin_receive_UDP_datagram()
+    BC95_OP_PING                                                   ,  // begin_ping()
+    BC95_OP_DNS                                                       // begin_query_dns()
+};
+
+enum bc95_op_status_t {
+    BC95_OP_IDLE                                                = 0,  // nothing started yet
+    BC95_OP_PENDING                                                ,  // in progress, keep calling poll()
+    BC95_OP_DONE                                                   ,  // completed successfully
+    BC95_OP_FAILED                                                    // ERROR response or timeout
+};
+
+/*
+ * Asynchronous operation completion callback.
+ * @param  op              [IN] Completed operation
+ * @param  status          [IN] BC95_OP_DONE or BC95_OP_FAILED
+ * @param  result          [IN] Sent bytes (send), received bytes (receive), RTT (ping), 1 (dns)
+ * @param  ctx             [IN] User context given to set_op_callback()
+ */
+typedef void (*bc95_op_callback_t)(bc95_op_type_t op, bc95_op_status_t status, uint16_t result, void *ctx);
+
+/*
+ * Received datagram handler, see NBIoT_BC95::receive_UDP_datagrams().
+ * @param  payload         [IN] Received data
+ * @param  payload_size    [IN] Size of received data
+ * @param  ctx             [IN] User context
+ */
+typedef void (*bc95_datagram_handler_t)(const uint8_t *payload, uint16_t payload_size, void *ctx);
+
+// Unsolicited result codes
+enum bc95_urc_t {
+    BC95_URC_NONE                                               = 0,
+    BC95_URC_DOWNLINK                                              ,  // +NSONMI:<socket>,<length>
+    BC95_URC_REGISTRATION                                          ,  // +CEREG:<stat>
+    BC95_URC_CONNECTION                                            ,  // +CSCON:<mode>
+    BC95_URC_PSM                                                      // +NPSMR:<mode>
+};
+
+/*
+ * Unsolicited result code handler. Called from whichever function reads the report
+ * (any AT exchange, poll() or process_urcs()), so it must not issue AT commands itself.
+ * @param  urc             [IN] Received report
+ * @param  arg1            [IN] Socket (downlink), <stat> (registration), <mode> (connection, psm)
+ * @param  arg2            [IN] Datagram length (downlink), 0 otherwise
+ * @param  ctx             [IN] User context given to set_urc_handler()
+ */
+typedef void (*bc95_urc_handler_t)(bc95_urc_t urc, uint16_t arg1, uint16_t arg2, void *ctx);
+
+/*
+ * Host UART reconfiguration, e.g. Serial1.begin(baud_rate). Called when the module has switched to
+ * another baud rate, including the way back after a failed switch or a reboot.
+ * @param  baud_rate       [IN] New baud rate
+ * @param  ctx             [IN] User context given to set_baud_callback()
+ */
+typedef void (*bc95_baud_callback_t)(uint32_t baud_rate, void *ctx);
+
+/*
+ * Library clock, see NBIoT_BC95::set_time_source().
+ * @param  ctx             [IN] User context given to set_time_source()
+ * @return                 Current time in milliseconds
+ */
+typedef uint32_t (*bc95_millis_t)(void *ctx);
+
+/*
+ * Delay on the library clock, see NBIoT_BC95::set_time_source().
+ * @param  ms              [IN] Time to let pass
+ * @param  ctx             [IN] User context given to set_time_source()
+ */
+typedef void (*bc95_delay_t)(uint32_t ms, void *ctx);
+
+// What the library does while it waits for the module and the UART is empty, see NBIoT_BC95::set_idle_mode()
+enum bc95_idle_mode_t {
+    BC95_IDLE_POLL                                              = 0,  // poll the UART again right away
+    BC95_IDLE_YIELD                                                ,  // yield() to the scheduler between polls
+    BC95_IDLE_SLEEP                                                ,  // sleep until an interrupt (UART receive, millis() tick)
+    BC95_IDLE_CALLBACK                                                // call the idle callback
+};
+
+/*
+ * Idle callback. May sleep, run other work or wait for the UART interrupt, as long as it returns
+ * within timeout: bytes received meanwhile are read once it returns.
+ * @param  timeout         [IN] Milliseconds until the library gives up waiting
+ * @param  ctx             [IN] User context given to set_idle_mode()
+ */
+typedef void (*bc95_idle_callback_t)(uint32_t timeout, void *ctx);
+
 
 class NBIoT_BC95 {
 
@@ -91,20 +315,60 @@ class NBIoT_BC95 {
          /**
          * Class constructor
          * @param stream        [IN] Stream to be used to communicate with bc95 board
-         * @param dbg           [IN] Stream to be used as output for debug
+         * @param dbg           [IN] Stream to be used as output for debug (BC95_MODULE_DEBUG), NULL for none
          */
         NBIoT_BC95(Stream *stream, Stream *dbg = NULL) : _stream(stream), _dbg(dbg) { }
 
         /*
          * Initialize modem. If psm is NULL, configuration is set to default values.
+         * Returns as soon as the module has booted and is configured, see get_startup_time().
          * @return              0 on failure, 1 on success
          */
         uint8_t initialize(void);
 
+        /*
+         * Duration of the last successful initialize(), boot wait included.
+         * @return              Startup time in milliseconds
+         */
+        uint32_t get_startup_time(void) { return _startup_time; }
+
+        /*
+         * Replace millis() as the clock of every timeout, e.g. with a virtual clock in host tests.
+         * While a delay function is set it is called for 1 ms whenever the library waits for the
+         * module and nothing has arrived, so a virtual clock moves on and timeouts expire at once.
+         * @param  millis_fn       [IN] Milliseconds since any origin, NULL for millis()
+         * @param  delay_fn        [IN] Let time pass while waiting, NULL to poll the UART without pause
+         * @param  ctx             [IN] User context passed to both
+         */
+        void set_time_source(bc95_millis_t millis_fn, bc95_delay_t delay_fn = NULL, void *ctx = NULL) {
+            _millis_fn = millis_fn; _delay_fn = delay_fn; _time_ctx = ctx;
+        }
+
+        /*
+         * Current time of the library clock.
+         * @return              Milliseconds, from millis() or the time source
+         */
+        uint32_t get_millis(void) { return _millis(); }
+
+        /*
+         * Choose how the library waits for the module (up to BC95_CONNECTION_TIMEOUT for +NSONMI,
+         * +NPING or +QDNS). BC95_IDLE_POLL keeps the CPU busy and answers each byte immediately,
+         * the others save power at the cost of up to a tick (1 ms on most cores) per wake-up,
+         * which the UART hardware buffer absorbs. BC95_IDLE_SLEEP uses the idle sleep mode on AVR
+         * and WFI on ARM, elsewhere it falls back to yield().
+         * @param  mode            [IN] Idle strategy
+         * @param  callback        [IN] Idle callback, used by BC95_IDLE_CALLBACK
+         * @param  ctx             [IN] User context passed to the callback
+         */
+        void set_idle_mode(const bc95_idle_mode_t mode, bc95_idle_callback_t callback = NULL, void *ctx = NULL) {
+            _idle_mode = mode; _idle_callback = callback; _idle_callback_ctx = ctx;
+        }
+
         /******* Data Transmission Funcions *******/
 
         /*
-         * Create UDP socket for data transmission.
+         * Create UDP socket for data transmission. It becomes the default socket used by the
+         * functions below that take no socket handle.
          * @param  listen_port  [IN] Listen port.
          * @param  recv_msg     [IN] Enable receiving incoming messages (1 - should be received, 0 - should be ignored)
          * @return              0 on failure, 1 on success or if socket has been already created
@@ -112,19 +376,43 @@ class NBIoT_BC95 {
         uint8_t open_socket(const uint16_t listen_port = 0, const uint8_t recv_msg = 1);
 
         /*
-         * Close UDP socket.
+         * Close the default UDP socket.
          * @return              0 on failure or if no socket was open, 1 on success
          */
         uint8_t close_socket(void);
 
+        /*
+         * Handle of the default socket, BC95_INVALID_SOCKET if none is open.
+         */
+        uint8_t get_default_socket(void) { return _default_soc; }
+
+        /*
+         * Create an additional UDP socket, up to BC95_MAX_SOCKETS. Each socket needs its own listen port.
+         * @param  socket       [OUT] Socket handle
+         * @param  listen_port  [IN]  Listen port.
+         * @param  recv_msg     [IN]  Enable receiving incoming messages (1 - should be received, 0 - should be ignored)
+         * @return              0 on failure, 1 on success
+         */
+        uint8_t create_socket(uint8_t *socket, const uint16_t listen_port = 0, const uint8_t recv_msg = 1);
+
+        /*
+         * Close UDP socket.
+         * @param  socket       [IN] Socket handle
+         * @return              0 on failure or if the socket was not open, 1 on success
+         */
+        uint8_t close_socket(const uint8_t socket);
+
         /*
          * Send UDP datagram.
-         * @param  remote_host      [IN]  Remote host IP address
+         * @param  socket           [IN]  Socket handle from create_socket(), the default socket if omitted
+         * @param  remote_host      [IN]  Remote host IP address or hostname, resolved through query_dns()
          * @param  remote_port      [IN]  Remote host port
          * @param  payload_out      [IN]  Byte buffer to be sent
-         * @param  payload_out_size [IN]  Size of byte buffer
+         * @param  payload_out_size [IN]  Size of byte buffer, up to BC95_NSOST_MAX_PAYLOAD_SIZE
          * @param  bytes_pending    [OUT] Number of bytes to be received [if socket_create(..., recv_msg = 1)]
          * @param  response_timeout [IN]  Timeout to check response message
+         * @param  release          [IN]  Let the module drop the RRC connection right after this uplink (or its reply)
+         *                                instead of waiting for the network inactivity timer, see AT+NSOSTF
          * @return                  0 on failure, number of sent bytes on success
          */
         uint16_t send_UDP_datagram(
@@ -133,15 +421,104 @@ class NBIoT_BC95 {
             const uint8_t *payload_out,
             const uint16_t payload_out_size,
             uint16_t *bytes_pending = NULL,
-            const uint32_t response_timeout = BC95_CONNECTION_TIMEOUT);
+            const uint32_t response_timeout = BC95_CONNECTION_TIMEOUT,
+            const bc95_release_t release = BC95_RELEASE_NONE);
+
+        uint16_t send_UDP_datagram(
+            const uint8_t socket,
+            const char *remote_host,
+            const uint16_t remote_port,
+            const uint8_t *payload_out,
+            const uint16_t payload_out_size,
+            uint16_t *bytes_pending = NULL,
+            const uint32_t response_timeout = BC95_CONNECTION_TIMEOUT,
+            const bc95_release_t release = BC95_RELEASE_NONE);
 
         /*
-         * Receive UDP datagram.
+         * Send UDP datagram gathered from segments, each hex-encoded straight into the AT+NSOST command:
+         * header, readings and trailer need not be copied into one buffer first.
+         * @param  segments         [IN]  Parts of the datagram, in order. Empty segments are allowed
+         * @param  segment_count    [IN]  Number of segments
+         * @param  crc              [IN]  Check value computed over the segments while they are sent and
+         *                                appended to the datagram, BC95_CRC_NONE for none
+         * Other parameters as above. The segments and the check value together take up to
+         * BC95_NSOST_MAX_PAYLOAD_SIZE bytes, the number of sent bytes includes the check value.
+         */
+        uint16_t send_UDP_datagram(
+            const char *remote_host,
+            const uint16_t remote_port,
+            const bc95_segment_t *segments,
+            const uint8_t segment_count,
+            uint16_t *bytes_pending = NULL,
+            const uint32_t response_timeout = BC95_CONNECTION_TIMEOUT,
+            const bc95_release_t release = BC95_RELEASE_NONE,
+            const bc95_crc_t crc = BC95_CRC_NONE);
+
+        uint16_t send_UDP_datagram(
+            const uint8_t socket,
+            const char *remote_host,
+            const uint16_t remote_port,
+            const bc95_segment_t *segments,
+            const uint8_t segment_count,
+            uint16_t *bytes_pending = NULL,
+            const uint32_t response_timeout = BC95_CONNECTION_TIMEOUT,
+            const bc95_release_t release = BC95_RELEASE_NONE,
+            const bc95_crc_t crc = BC95_CRC_NONE);
+
+        /*
+         * CRC-16/CCITT-FALSE as appended by send_UDP_datagram() with BC95_CRC16_CCITT. Pass the result
+         * back in as crc to continue over more data.
+         * @param  data             [IN]  Bytes to check
+         * @param  data_size        [IN]  Number of bytes
+         * @param  crc              [IN]  BC95_CRC16_INIT, or the CRC so far
+         * @return                  CRC over data
+         */
+        static uint16_t crc16(const uint8_t *data, const uint16_t data_size, uint16_t crc = BC95_CRC16_INIT);
+
+        /*
+         * Receive UDP datagram. Data is hex-decoded straight from the UART into payload_out.
+         * A datagram longer than max_size is left partially queued and continues on the next read.
+         * @param  socket           [IN]  Socket handle from create_socket(), the default socket if omitted
          * @param  payload_out      [OUT] Data buffer for received data
          * @param  payload_out_size [OUT] Size of received data
-         * @return                  0 on failure, 1 on success
+         * @param  max_size         [IN]  Size of payload_out, up to BC95_NSORF_MAX_PAYLOAD_SIZE
+         * @param  remaining        [OUT] Bytes still queued in the module after this read
+         * @return                  0 on failure or if nothing was received, 1 on success
+         */
+        uint8_t receive_UDP_datagram(
+            uint8_t *payload_out,
+            uint16_t *payload_out_size,
+            const uint16_t max_size = BC95_MAX_PACKET_SIZE,
+            uint16_t *remaining = NULL);
+
+        uint8_t receive_UDP_datagram(
+            const uint8_t socket,
+            uint8_t *payload_out,
+            uint16_t *payload_out_size,
+            const uint16_t max_size = BC95_MAX_PACKET_SIZE,
+            uint16_t *remaining = NULL);
+
+        /*
+         * Receive every datagram queued in the module. Reads continue while the module reports
+         * remaining data, so back-to-back downlinks cost one AT+NSORF each and nothing else.
+         * @param  handler          [IN] Function called for each received datagram (or chunk of max_size)
+         * @param  buffer           [IN] Receive buffer passed to the handler
+         * @param  max_size         [IN] Size of buffer, up to BC95_NSORF_MAX_PAYLOAD_SIZE
+         * @param  ctx              [IN] User context passed to the handler
+         * @return                  Number of handled datagrams
          */
-        uint8_t receive_UDP_datagram(uint8_t *payload_out, uint16_t *payload_out_size);
+        uint16_t receive_UDP_datagrams(
+            bc95_datagram_handler_t handler,
+            uint8_t *buffer,
+            const uint16_t max_size = BC95_MAX_PACKET_SIZE,
+            void *ctx = NULL);
+
+        uint16_t receive_UDP_datagrams(
+            const uint8_t socket,
+            bc95_datagram_handler_t handler,
+            uint8_t *buffer,
+            const uint16_t max_size = BC95_MAX_PACKET_SIZE,
+            void *ctx = NULL);
 
         /*
          * Ping remote host
@@ -154,21 +531,204 @@ class NBIoT_BC95 {
         /******* DNS-related Functions *******/
 
         /*
-         * Request a DNS translation.
+         * Request a DNS translation. Answers are served from the resolver cache while they are fresh,
+         * including the failed lookups, without any AT command.
          * @param  host_url        [IN]  Host URL. IP addresses are also valid (host_url -> ip_address)
-         * @param  ip_address      [OUT] Translated IP address.
-         * @return                 0 on failure, RTT (Round Trip Time) on success
+         * @param  ip_address      [OUT] Translated IP address, BC95_IP_ADDRESS_LEN bytes
+         * @return                 0 on failure, 1 on success
          */
         uint8_t query_dns(const char *host_url, char *ip_address);
 
         /*
-         * Flush DNS buffer.
+         * Flush DNS buffer, in the module and in the resolver cache.
          * @param  host_url        [IN]  Host URL. If host_url != NULL, then flushes only memory for this entry, otherwise flushes all dns memory.
-         * @param  ip_address      [OUT] Translated IP address.
-         * @return                 0 on failure, RTT (Round Trip Time) on success
+         * @return                 0 on failure, 1 on success
          */
         uint8_t flush_dns_cache(const char *host_url = NULL);
 
+        /*
+         * Resolver cache lifetimes. A failed lookup is one the module answered with an error,
+         * timeouts are not cached.
+         * @param  ttl             [IN] How long an answer is kept in milliseconds, 0 disables the cache
+         * @param  negative_ttl    [IN] How long a failed lookup is kept in milliseconds, 0 disables negative caching
+         */
+        void set_dns_cache_ttl(const uint32_t ttl, const uint32_t negative_ttl = BC95_DNS_NEGATIVE_TTL) { _dns_ttl = ttl; _dns_negative_ttl = negative_ttl; }
+
+        /* Lookups answered by the resolver cache and by the module since start */
+        uint16_t get_dns_cache_hits(void) { return _dns_hits; }
+        uint16_t get_dns_cache_misses(void) { return _dns_misses; }
+
+        /******* Asynchronous Functions *******/
+
+        /*
+         * Asynchronous counterparts of send_UDP_datagram(), receive_UDP_datagram(), ping() and query_dns().
+         * The command is issued and the function returns immediately; poll() advances the operation with
+         * whatever bytes are available and reports completion through the status or the callback.
+         * Only one operation can be in progress, blocking functions fail until it completes.
+         * Note: an expired link state (see set_link_state_ttl()) is refreshed synchronously before starting.
+         * Output pointers must stay valid until the operation completes, so must the hostname given to
+         * begin_query_dns(). A lookup answered by the resolver cache completes right away, a hostname
+         * given to begin_send_UDP_datagram() is resolved (blocking) before the send starts.
+         * @return                  0 if busy or on failure, 1 if the operation has been started
+         */
+        uint8_t begin_send_UDP_datagram(
+            const char *remote_host,
+            const uint16_t remote_port,
+            const uint8_t *payload_out,
+            const uint16_t payload_out_size,
+            uint16_t *bytes_pending = NULL,
+            const uint32_t response_timeout = BC95_CONNECTION_TIMEOUT,
+            const bc95_release_t release = BC95_RELEASE_NONE);
+
+        uint8_t begin_send_UDP_datagram(
+            const uint8_t socket,
+            const char *remote_host,
+            const uint16_t remote_port,
+            const uint8_t *payload_out,
+            const uint16_t payload_out_size,
+            uint16_t *bytes_pending = NULL,
+            const uint32_t response_timeout = BC95_CONNECTION_TIMEOUT,
+            const bc95_release_t release = BC95_RELEASE_NONE);
+
+        uint8_t begin_send_UDP_datagram(
+            const char *remote_host,
+            const uint16_t remote_port,
+            const bc95_segment_t *segments,
+            const uint8_t segment_count,
+            uint16_t *bytes_pending = NULL,
+            const uint32_t response_timeout = BC95_CONNECTION_TIMEOUT,
+            const bc95_release_t release = BC95_RELEASE_NONE,
+            const bc95_crc_t crc = BC95_CRC_NONE);
+
+        uint8_t begin_send_UDP_datagram(
+            const uint8_t socket,
+            const char *remote_host,
+            const uint16_t remote_port,
+            const bc95_segment_t *segments,
+            const uint8_t segment_count,
+            uint16_t *bytes_pending = NULL,
+            const uint32_t response_timeout = BC95_CONNECTION_TIMEOUT,
+            const bc95_release_t release = BC95_RELEASE_NONE,
+            const bc95_crc_t crc = BC95_CRC_NONE);
+
+        uint8_t begin_receive_UDP_datagram(
+            uint8_t *payload_out,
+            uint16_t *payload_out_size,
+            const uint16_t max_size = BC95_MAX_PACKET_SIZE,
+            uint16_t *remaining = NULL);
+
+        uint8_t begin_receive_UDP_datagram(
+            const uint8_t socket,
+            uint8_t *payload_out,
+            uint16_t *payload_out_size,
+            const uint16_t max_size = BC95_MAX_PACKET_SIZE,
+            uint16_t *remaining = NULL);
+
+        uint8_t begin_ping(const char *host, const uint32_t timeout = BC95_CONNECTION_TIMEOUT);
+
+        uint8_t begin_query_dns(const char *host_url, char *ip_address);
+
+        /*
+         * Advance the asynchronous operation in progress. Never blocks.
+         * @return                 Status of the current (or last) operation
+         */
+        bc95_op_status_t poll(void);
+
+        /*
+         * Set the function called when an asynchronous operation completes.
+         * @param  callback        [IN] Completion callback, NULL to disable
+         * @param  ctx             [IN] User context passed to the callback
+         */
+        void set_op_callback(bc95_op_callback_t callback, void *ctx = NULL) { _op_callback = callback; _op_callback_ctx = ctx; }
+
+        /*
+         * Result of the current (or last) asynchronous operation. See bc95_op_callback_t.
+         */
+        bc95_op_status_t get_op_status(void) { return _op.status; }
+        uint16_t get_op_result(void) { return _op.result; }
+
+        /******* Unsolicited Result Codes *******/
+
+        /*
+         * +NSONMI, +CEREG, +CSCON and +NPSMR reports are recognised wherever they arrive, including
+         * between a command and its OK, and update the state below before the handler is called.
+         * @param  handler         [IN] Report handler, NULL to disable
+         * @param  ctx             [IN] User context passed to the handler
+         */
+        void set_urc_handler(bc95_urc_handler_t handler, void *ctx = NULL) { _urc_handler = handler; _urc_handler_ctx = ctx; }
+
+        /*
+         * Dispatch the reports received so far without issuing any command. Never blocks.
+         * poll() does the same while no asynchronous operation is in progress.
+         * @return                 Number of dispatched reports
+         */
+        uint8_t process_urcs(void);
+
+        /*
+         * Wait through the idle strategy (see set_idle_mode()) until a +NSONMI report for the socket
+         * arrives or timeout passes, dispatching reports like process_urcs(). For layers that poll
+         * between deadlines of their own. Does not dispatch while an asynchronous operation is in progress.
+         * @param  socket          [IN] Socket handle
+         * @param  timeout         [IN] Longest wait in milliseconds
+         * @return                 1 if a downlink was reported, 0 on timeout
+         */
+        uint8_t wait_for_downlink(const uint8_t socket, const uint32_t timeout);
+
+        /*
+         * Bytes announced by +NSONMI and not read yet, on all sockets or on the given one.
+         */
+        uint16_t get_pending_bytes(void);
+        uint16_t get_pending_bytes(const uint8_t socket);
+
+        /*
+         * Last reported RRC connection (+CSCON) and power saving (+NPSMR) state.
+         * @return                 0 on false, 1 on true
+         */
+        uint8_t is_connected(void) { return _rrc_connected; }
+        uint8_t is_in_psm(void) { return _in_psm; }
+
+        /******* Receive Buffer *******/
+
+        /*
+         * Move the bytes waiting in the UART into the receive buffer. Calling it from loop() while the
+         * application is busy elsewhere keeps the (small) hardware buffer from overflowing.
+         * @return                 Number of bytes moved
+         */
+        uint16_t pump(void);
+
+        /*
+         * Receive hook for a UART interrupt handler that reads the bytes itself instead of leaving them
+         * in the stream. A byte that does not fit in the receive buffer is dropped and counted.
+         * @param  read_byte       [IN] Received byte
+         */
+        void rx_isr(const uint8_t read_byte);
+
+        /*
+         * Receive overflows since start: bytes dropped by a full receive buffer (rx_isr() only) and
+         * lines longer than the buffer they were read into, which are discarded.
+         */
+        uint16_t get_rx_dropped_bytes(void) { return _rx_dropped; }
+        uint16_t get_rx_long_lines(void) { return _rx_long_lines; }
+
+        #if BC95_METRICS > 0
+        /*
+         * Command metrics, one entry per command type in order of first use.
+         * @param  index           [IN] Entry, from 0
+         * @return                 NULL past the last entry in use
+         */
+        const bc95_command_metrics_t *get_command_metrics(const uint8_t index) const;
+
+        /*
+         * Time spent waiting for the module, idle and busy polling, since start or reset_metrics().
+         */
+        const bc95_idle_stats_t *get_idle_stats(void) const { return &_idle_stats; }
+
+        /*
+         * Clear all command metrics and the idle statistics.
+         */
+        void reset_metrics(void);
+        #endif
+
         /******* Modem Configuration Functions *******/
 
         /*
@@ -178,6 +738,24 @@ class NBIoT_BC95 {
          */
         uint8_t config_psm(const bc95_psm_config_t *psm_config = NULL);
 
+        /*
+         * Read the current module configuration (AT+NCONFIG?;+NBAND?;+CPSMS? in one round trip).
+         * @param  profile         [OUT] Current configuration
+         * @return                 0 on failure, 1 on success
+         */
+        uint8_t read_config_profile(bc95_config_profile_t *profile);
+
+        /*
+         * Bring the module to the desired configuration. The current one is read back first and only
+         * the settings that differ are written: no NV write when nothing changed and no AT+CFUN radio
+         * cycle unless the bands change. BC95_PSM_MODE_DISABLED_AND_DISCARD_CURRENT_CONFIG reads back as
+         * BC95_PSM_MODE_DISABLED: it is written only while the timers do not read back as 0.
+         * @param  profile         [IN]  Desired configuration
+         * @param  changes         [OUT] Written settings, combination of bc95_config_change_t
+         * @return                 0 on failure, 1 on success
+         */
+        uint8_t apply_config_profile(const bc95_config_profile_t *profile, uint8_t *changes = NULL);
+
         /******* Network Configuration Functions *******/
 
         /*
@@ -236,11 +814,31 @@ class NBIoT_BC95 {
          */
         uint8_t is_assigned_ip(void);
 
+        /*
+         * Read registration, attachment, PSM, signal strength and IP address in one command line
+         * (AT+CEREG?;+CGATT?;+NPSMR?;+CSQ;+CGPADDR=0). Refreshes the cached link state.
+         * @param  status          [OUT] Pointer to status structure
+         * @return                 0 on failure, 1 on success
+         */
+        uint8_t get_status(bc95_status_t *status);
+
+        /*
+         * Set how long a confirmed link state (registered and attached) is trusted. Data transmission
+         * functions skip the AT+CEREG?/AT+CGATT? pre-flight queries while the cached state is fresh.
+         * @param  ttl             [IN] Time to live in milliseconds. 0 disables the cache.
+         */
+        void set_link_state_ttl(const uint32_t ttl) { _link_ttl = ttl; }
+
+        /*
+         * Drop the cached link state. Next transmission queries the modem again.
+         */
+        void invalidate_link_state(void) { _link_registered = 0; _link_attached = 0; }
+
         /******* Info getters *******/
 
         /*
          * Retrieves current date and time from the operator.
-         * @param  date_and_time   [OUT] Pointer to buffer
+         * @param  date_and_time   [OUT] "yy/mm/dd,hh:mm:ss+zz", BC95_DATE_TIME_LEN bytes
          * @return                 0 on false, 1 on true
          */
         uint8_t get_current_date_and_time(char *date_and_time);
@@ -253,7 +851,7 @@ class NBIoT_BC95 {
 
         /*
          * Get ME IP address.
-         * @param  ip_address      [OUT] Pointer to buffer
+         * @param  ip_address      [OUT] Dotted address, BC95_IP_ADDRESS_LEN bytes
          * @return                 0 on failure, 1 on success
          */
         uint8_t get_IP_address(char *ip_address);
@@ -267,18 +865,50 @@ class NBIoT_BC95 {
 
         /*
          * Get IMEI
-         * @param  imei            [OUT] Pointer to buffer
+         * @param  imei            [OUT] BC95_IMEI_LEN bytes
          * @return                 0 on failure, 1 on success
          */
         uint8_t get_IMEI(char *imei);
 
         /*
-         * Get IMEI
-         * @param  imei            [OUT] Pointer to buffer
+         * Get ICCID
+         * @param  iccid           [OUT] BC95_ICCID_LEN bytes
          * @return                 0 on failure, 1 on success
          */
         uint8_t get_ICCID(char *iccid);
 
+        /******* UART Functions *******/
+
+        /*
+         * Set the function that changes the host UART baud rate, required by set_baud_rate().
+         * @param  callback        [IN] Host UART reconfiguration
+         * @param  ctx             [IN] User context passed to the callback
+         */
+        void set_baud_callback(bc95_baud_callback_t callback, void *ctx = NULL) { _baud_callback = callback; _baud_callback_ctx = ctx; }
+
+        /*
+         * Switch the module and the host to another baud rate (AT+NATSPEED) and check the link with AT.
+         * If the module does not answer at the new rate both sides go back to the previous one.
+         * @param  baud_rate       [IN] 4800, 9600, 57600, 115200, 230400 or 460800
+         * @param  store           [IN] Keep the rate across reboots
+         * @return                 0 on failure (still at the previous rate), 1 on success
+         */
+        uint8_t set_baud_rate(const uint32_t baud_rate, const uint8_t store = 0);
+
+        /*
+         * Switch to the highest baud rate up to max_baud_rate that the link sustains, trying the
+         * supported rates from the top down.
+         * @param  max_baud_rate   [IN] Highest rate to try
+         * @param  store           [IN] Keep the rate across reboots
+         * @return                 Baud rate in use
+         */
+        uint32_t negotiate_baud_rate(const uint32_t max_baud_rate, const uint8_t store = 0);
+
+        /*
+         * Baud rate in use, 0 until set_baud_rate() has learned it from the module.
+         */
+        uint32_t get_baud_rate(void) { return _baud_rate; }
+
         /******* Misc Funcions *******/
 
         /*
@@ -289,26 +919,162 @@ class NBIoT_BC95 {
 
     private:
 
-        /* Command parser states */
-        enum bc95_cmd_parser_state_t {
-            START_CR    = 0,
-            START_LF       ,
-            PAYLOAD        ,
-            END_LF
+        /* What happens to the rest of the line being received */
+        enum bc95_line_drop_t {
+            LINE_KEEP       = 0,
+            LINE_RESYNC        ,   // cut by a reader that gave up on it
+            LINE_OVERFLOW          // longer than the line buffer
         };
 
         /* Serial */
         Stream * _stream;
         Stream * _dbg;
+        uint8_t _command_open = 0;      // a command is being streamed, see _begin_command()
+        uint8_t _solicited = 0;         // 1 << bc95_urc_t of reports queried by the open command
 
-        /* socket open */
-        uint8_t _open_soc = 0;
+        /* socket table, indexed by the module socket id */
+        struct bc95_socket_t {
+            uint8_t             open;
+            uint8_t             downlinks;      // +NSONMI reports received, wraps
+            uint16_t            last_downlink;  // length reported by the last +NSONMI
+            uint16_t            pending;        // bytes announced and not read yet
+        };
+        bc95_socket_t _sockets[BC95_MAX_SOCKETS] = {};
+        uint8_t _default_soc = BC95_INVALID_SOCKET;
 
         uint8_t _is_init = 0;
+        uint32_t _startup_time = 0;
+
+        /* time source, millis() and busy polling if not set */
+        bc95_millis_t _millis_fn = NULL;
+        bc95_delay_t _delay_fn = NULL;
+        void *_time_ctx = NULL;
+
+        bc95_idle_mode_t _idle_mode = BC95_IDLE_POLL;
+        bc95_idle_callback_t _idle_callback = NULL;
+        void *_idle_callback_ctx = NULL;
+
+        /* cached link state, filled by is_registered()/is_attached() and +CEREG/+CSCON reports */
+        uint8_t _link_registered = 0;
+        uint8_t _link_attached = 0;
+        uint32_t _link_checked = 0;
+        uint32_t _link_ttl = BC95_LINK_STATE_TTL;
+
+        /* state reported by unsolicited result codes */
+        uint8_t _rrc_connected = 0;
+        uint8_t _in_psm = 0;
+
+        bc95_urc_handler_t _urc_handler = NULL;
+        void *_urc_handler_ctx = NULL;
+
+        /* resolver cache, least recently used entry replaced first */
+        enum bc95_dns_entry_state_t {
+            DNS_EMPTY       = 0,
+            DNS_RESOLVED       ,
+            DNS_FAILED
+        };
+        struct bc95_dns_entry_t {
+            char                    host[BC95_DNS_MAX_HOST_LEN + 1];
+            uint8_t                 ip[4];
+            bc95_dns_entry_state_t  state;
+            uint32_t                stored_at;
+            uint8_t                 used;       // _dns_tick of the last use, wraps
+        };
+        #if BC95_DNS_CACHE_SIZE > 0
+        bc95_dns_entry_t _dns_cache[BC95_DNS_CACHE_SIZE] = {};
+        #endif
+
+        // Response line parsed against its descriptor, see _parse_response()
+        struct bc95_fields_t {
+            uint32_t value[BC95_RESPONSE_MAX_FIELDS];   // numeric fields by position, 0 if skipped or absent
+            uint8_t ip[4];                              // address field
+            char *text;                                 // set by the caller to receive the text field
+            uint8_t count;                              // fields present in the line
+        };
+        uint8_t _dns_tick = 0;
+        uint32_t _dns_ttl = BC95_DNS_CACHE_TTL;
+        uint32_t _dns_negative_ttl = BC95_DNS_NEGATIVE_TTL;
+        uint16_t _dns_hits = 0;
+        uint16_t _dns_misses = 0;
+
+        /* UART rate, 0 when unknown */
+        uint32_t _baud_rate = 0;
+        uint32_t _stored_baud_rate = 0;
+        bc95_baud_callback_t _baud_callback = NULL;
+        void *_baud_callback_ctx = NULL;
+
+        /* receive ring buffer, filled by pump() or rx_isr() */
+        uint8_t _rx_buf[BC95_RX_BUFFER_SIZE];
+        volatile uint8_t _rx_head = 0;
+        uint8_t _rx_tail = 0;
+        volatile uint16_t _rx_dropped = 0;
+        uint16_t _rx_long_lines = 0;
+
+        #if BC95_METRICS > 0
+        /* command metrics, the open command is closed by its final result code or a timeout */
+        bc95_command_metrics_t _metrics[BC95_METRICS_COMMANDS] = {};
+        bc95_command_metrics_t *_metrics_open = NULL;
+        bc95_idle_stats_t _idle_stats = {};
+        uint32_t _wait_started = 0;
+        uint32_t _metrics_started = 0;
+        #endif
+
+        /* line framing */
+        uint16_t _line_fill = 0;                // bytes of the line being received
+        bc95_line_drop_t _line_drop = LINE_KEEP;
+        uint16_t _parsed_len = 0;               // length of the last complete line
+
+        /* Asynchronous operation stages */
+        enum bc95_op_stage_t {
+            OP_STAGE_RESPONSE   = 0,    // information response (e.g. "1,12")
+            OP_STAGE_OK            ,    // final OK
+            OP_STAGE_RESULT             // result report (+NSONMI, +NPING, +QDNS)
+        };
+
+        /* asynchronous operation in progress */
+        struct {
+            bc95_op_type_t      type;
+            bc95_op_status_t    status;
+            bc95_op_stage_t     stage;
+            uint32_t            stage_started;
+            uint32_t            last_activity;
+            uint32_t            timeout;
+            uint16_t            result;
+            uint8_t             socket;
+            uint16_t           *bytes_pending;
+            uint8_t             downlink_mark;
+            uint8_t            *payload;
+            uint16_t            payload_capacity;
+            uint16_t           *payload_size;
+            uint16_t           *remaining;
+            char               *ip_address;
+            const char         *host;
+        } _op = { BC95_OP_NONE, BC95_OP_IDLE, OP_STAGE_RESPONSE, 0, 0, 0, 0, BC95_INVALID_SOCKET, NULL, 0, NULL, 0, NULL, NULL, NULL, NULL };
+        char _op_line[BC95_ASYNC_LINE_BUF_LEN];
+
+        bc95_op_callback_t _op_callback = NULL;
+        void *_op_callback_ctx = NULL;
+
+        /* incremental +NSORF decoder: <socket>,<ip>,<port>,<length>,<data>,<remaining_length> */
+        struct {
+            uint8_t             active;
+            uint8_t             field;
+            uint8_t             high_nibble;
+            uint16_t            length;
+            uint16_t            decoded;
+            uint16_t            remaining;
+        } _nsorf = { 0, 0, 0, 0, 0, 0 };
 
         /* Communication with BC95 */
-        uint8_t _send_command(const char  *cmd);
         uint8_t _send_command(const __FlashStringHelper *cmd);
+        /* Command builder, streams the command to the UART piece by piece without buffering it */
+        uint8_t _begin_command(const __FlashStringHelper *cmd);
+        void _command_str(const __FlashStringHelper *str);
+        void _command_str(const char *str);
+        void _command_uint(const uint32_t value, const uint8_t base = DEC);
+        void _command_bits(const uint8_t value);
+        void _command_hex(const uint8_t *data, const uint16_t data_len, uint16_t *crc = NULL);
+        uint8_t _end_command(void);
         uint8_t _read_line(
                 char *resonse_buffer,
                 const uint16_t resonse_buffer_len,
@@ -316,8 +1082,78 @@ class NBIoT_BC95 {
                 const uint32_t timeout = BC95_READ_RESPONSE_TIMEOUT);
         uint8_t _check_response(const char *response_buffer, const uint16_t response_len);
         uint8_t _wait_for_OK(const uint32_t timeout = BC95_READ_RESPONSE_TIMEOUT);
+        uint8_t _rx_ready(void);
+        uint8_t _frame_line(char *line, const uint16_t line_len);
+        void _rx_resync(void);
+        bc95_urc_t _process_urc(const char *line);
+        uint8_t _queried_reports(const __FlashStringHelper *cmd);
+        uint8_t _wait_for_downlink(const uint8_t socket, const uint8_t mark, const uint32_t timeout);
+        uint8_t _op_start(const bc95_op_type_t type, const bc95_op_stage_t stage, const uint32_t timeout);
+        void _op_handle_line(const char *line, const uint16_t line_len);
+        void _op_finish(const bc95_op_status_t status);
+        void _nsorf_begin(void);
+        uint8_t _nsorf_parse_byte(const uint8_t read_byte, uint8_t *payload, const uint16_t payload_size);
+        uint8_t _nsorf_feed(
+                uint8_t *payload,
+                const uint16_t payload_size,
+                char *response_buffer,
+                const uint16_t response_buffer_len);
+        uint8_t _read_nsorf(uint8_t *payload, const uint16_t payload_size);
+        uint32_t _segments_size(const bc95_segment_t *segments, const uint8_t segment_count, const bc95_crc_t crc);
+        void _send_nsost(
+                const uint8_t socket,
+                const char *remote_host,
+                const uint16_t remote_port,
+                const bc95_segment_t *segments,
+                const uint8_t segment_count,
+                const bc95_crc_t crc,
+                const bc95_release_t release);
+        uint8_t _socket_open(const uint8_t socket);
         uint8_t _ping_module(uint8_t times);
+        uint8_t _wait_for_ready(const uint32_t timeout);
+        uint8_t _parse_response(const char *line, const uint8_t response, bc95_fields_t *fields);
+        #if BC95_METRICS > 0
+        void _metrics_begin(const __FlashStringHelper *cmd);
+        void _metrics_line(const char *line, const uint16_t line_len);
+        void _metrics_timeout(void);
+        void _metrics_sent(const size_t sent) { if (_metrics_open != NULL) _metrics_open->tx_bytes += sent; }
+        void _metrics_received(const uint16_t received) { if (_metrics_open != NULL) _metrics_open->rx_bytes += received; }
+        void _metrics_wait_begin(void) { _idle_stats.waits++; _wait_started = micros(); }
+        void _metrics_wait_end(void) { _idle_stats.wait_us += (uint32_t)(micros() - _wait_started); }
+        #else
+        void _metrics_begin(const __FlashStringHelper *) { }
+        void _metrics_line(const char *, const uint16_t) { }
+        void _metrics_timeout(void) { }
+        void _metrics_sent(const size_t) { }
+        void _metrics_received(const uint16_t) { }
+        void _metrics_wait_begin(void) { }
+        void _metrics_wait_end(void) { }
+        #endif
+        uint8_t _read_response(
+                const uint8_t response,
+                bc95_fields_t *fields,
+                const uint32_t timeout = BC95_READ_RESPONSE_TIMEOUT,
+                const uint8_t ok_follows = 1);
+        uint8_t _read_baud_rate(void);
+        int8_t _dns_cached(const char *host, char *ip_address);
+        #if BC95_DNS_CACHE_SIZE > 0
+        bc95_dns_entry_t *_dns_find(const char *host);
+        void _dns_store(const char *host, const uint8_t *ip);
+        void _dns_flush(const char *host);
+        #else
+        bc95_dns_entry_t *_dns_find(const char *) { return NULL; }
+        void _dns_store(const char *, const uint8_t *) { }
+        void _dns_flush(const char *) { }
+        #endif
+        uint8_t _dns_answer(const char *line, const char *host, char *ip_address);
+        void _switch_host_baud_rate(const uint32_t baud_rate);
+        uint8_t _read_autoconnect(uint8_t *autoconnect);
+        uint8_t _set_autoconnect(const uint8_t autoconnect);
+        uint8_t _link_ready(void);
+        void _link_confirm(void);
         void _flushInput(void);
+        uint32_t _millis(void) { return _millis_fn != NULL ? _millis_fn(_time_ctx) : millis(); }
+        void _idle(const uint32_t since, const uint32_t timeout);
 };
 
 
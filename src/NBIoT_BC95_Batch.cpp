@@ -0,0 +1,83 @@
+#include <NBIoT_BC95_Batch.h>
+
+uint8_t NBIoT_BC95_Batch::add(const uint8_t *record, const uint16_t record_size, uint16_t *record_id) {
+    if (record_size > BC95_BATCH_MAX_RECORD_SIZE || record_size + BC95_BATCH_RECORD_HEADER_SIZE > _max_size) {
+        return 0;
+    }
+
+    if (_size + BC95_BATCH_RECORD_HEADER_SIZE + record_size > _max_size) {
+        // full, more records are coming. Failed records are reported and dropped either way
+        _flush(BC95_RELEASE_NONE);
+    }
+
+    if (_records == 0) {
+        _first_id = _next_id;
+        _oldest = _bc95->get_millis();
+    }
+
+    _buffer[_size++] = record_size;
+    memcpy(&_buffer[_size], record, record_size);
+    _size += record_size;
+    _records++;
+
+    if (record_id != NULL) {
+        *record_id = _next_id;
+    }
+    _next_id++;
+
+    if (_size + BC95_BATCH_RECORD_HEADER_SIZE >= _max_size) {
+        // not even an empty record fits anymore
+        _flush(BC95_RELEASE_NONE);
+    }
+
+    return 1;
+}
+
+uint8_t NBIoT_BC95_Batch::flush(void) {
+    return _flush(_release);
+}
+
+uint8_t NBIoT_BC95_Batch::poll(void) {
+    uint8_t ret = 1;
+
+    if (_records > 0 && _max_age > 0 && _bc95->get_millis() - _oldest >= _max_age) {
+        ret = flush();
+    }
+
+    return ret;
+}
+
+uint8_t NBIoT_BC95_Batch::_flush(const bc95_release_t release) {
+    uint16_t sent, first_id = _first_id;
+    uint16_t records = _records;
+    uint8_t ret;
+
+    if (_records == 0) {
+        return 1;
+    }
+
+    // fire and forget, a reply is not waited for
+    if (_socket == BC95_INVALID_SOCKET) {
+        sent = _bc95->send_UDP_datagram(_remote_host, _remote_port, _buffer, _size, NULL, 0, release);
+    } else {
+        sent = _bc95->send_UDP_datagram(_socket, _remote_host, _remote_port, _buffer, _size, NULL, 0, release);
+    }
+
+    ret = (sent == _size);
+    if (ret) {
+        _sent_datagrams++;
+        _sent_records += records;
+    }
+
+    // emptied before reporting so that the callback can queue again
+    _size = 0;
+    _records = 0;
+
+    if (_callback != NULL) {
+        for (uint16_t i = 0; i < records; i++) {
+            _callback(first_id + i, ret ? BC95_OP_DONE : BC95_OP_FAILED, _callback_ctx);
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,132 @@
+#ifndef __NBIoT_BC95_BATCH_H__
+#define __NBIoT_BC95_BATCH_H__
+
+#include <NBIoT_BC95.h>
+
+/******* Defines *******/
+// Largest datagram assembled by the batch, up to BC95_NSOST_MAX_PAYLOAD_SIZE
+#ifndef BC95_BATCH_BUFFER_SIZE
+#define BC95_BATCH_BUFFER_SIZE                  (BC95_MAX_PACKET_SIZE)
+#endif
+// Age of the oldest queued record that triggers a flush from poll()
+#define BC95_BATCH_MAX_AGE                      (60000)
+// Every record is preceded by its length (one byte)
+#define BC95_BATCH_RECORD_HEADER_SIZE           (1)
+#define BC95_BATCH_MAX_RECORD_SIZE              (255)
+
+/*
+ * Record delivery callback, called once per record when the datagram carrying it has been handed
+ * over to the network (or could not be).
+ * @param  record_id       [IN] Identifier returned by NBIoT_BC95_Batch::add()
+ * @param  status          [IN] BC95_OP_DONE or BC95_OP_FAILED
+ * @param  ctx             [IN] User context given to set_record_callback()
+ */
+typedef void (*bc95_record_callback_t)(uint16_t record_id, bc95_op_status_t status, void *ctx);
+
+
+/*
+ * Telemetry send queue layered on NBIoT_BC95::send_UDP_datagram(). Small records are packed into
+ * one datagram as <length><record><length><record>... and sent when the datagram is full, when the
+ * oldest record reaches the maximum age (see poll()) or on flush().
+ */
+class NBIoT_BC95_Batch {
+
+    public:
+
+        /**
+         * Class constructor
+         * @param bc95          [IN] Initialized modem with an open socket
+         * @param remote_host   [IN] Remote host IP address or hostname, must stay valid
+         * @param remote_port   [IN] Remote host port
+         * @param socket        [IN] Socket handle, the default socket if omitted
+         */
+        NBIoT_BC95_Batch(
+            NBIoT_BC95 *bc95,
+            const char *remote_host,
+            const uint16_t remote_port,
+            const uint8_t socket = BC95_INVALID_SOCKET) :
+                _bc95(bc95), _remote_host(remote_host), _remote_port(remote_port), _socket(socket) { }
+
+        /*
+         * Queue a record. A record that does not fit in the current datagram flushes it first.
+         * @param  record          [IN]  Record data
+         * @param  record_size     [IN]  Size of record, up to BC95_BATCH_MAX_RECORD_SIZE and the datagram size
+         * @param  record_id       [OUT] Identifier reported to the delivery callback
+         * @return                 0 on failure (record too long), 1 on success
+         */
+        uint8_t add(const uint8_t *record, const uint16_t record_size, uint16_t *record_id = NULL);
+
+        /*
+         * Send the queued records now. This ends a burst, the datagram carries the release
+         * assistance indication (see set_release()).
+         * @return                 0 on failure, 1 on success or if nothing was queued
+         */
+        uint8_t flush(void);
+
+        /*
+         * Flush if the oldest queued record is older than the maximum age. Never blocks otherwise.
+         * @return                 0 if a flush failed, 1 otherwise
+         */
+        uint8_t poll(void);
+
+        /*
+         * Set the function called with the delivery status of each record.
+         * @param  callback        [IN] Delivery callback, NULL to disable
+         * @param  ctx             [IN] User context passed to the callback
+         */
+        void set_record_callback(bc95_record_callback_t callback, void *ctx = NULL) { _callback = callback; _callback_ctx = ctx; }
+
+        /*
+         * Flush thresholds.
+         * @param  max_size        [IN] Datagram size, up to BC95_BATCH_BUFFER_SIZE
+         * @param  max_age         [IN] Maximum age of a queued record in milliseconds, 0 disables it
+         */
+        void set_max_size(const uint16_t max_size) { _max_size = (max_size < BC95_BATCH_BUFFER_SIZE) ? max_size : BC95_BATCH_BUFFER_SIZE; }
+        void set_max_age(const uint32_t max_age) { _max_age = max_age; }
+
+        /*
+         * Release assistance sent with the last datagram of a burst (flush() or maximum age).
+         * Datagrams sent because the next record does not fit keep the connection up.
+         * @param  release         [IN] BC95_RELEASE_AFTER_UPLINK (default), BC95_RELEASE_AFTER_DOWNLINK if the
+         *                              collector answers every datagram, BC95_RELEASE_NONE to disable
+         */
+        void set_release(const bc95_release_t release) { _release = release; }
+
+        /* Queue state */
+        uint16_t get_queued_records(void) { return _records; }
+        uint16_t get_queued_bytes(void) { return _size; }
+
+        /* Totals since construction */
+        uint32_t get_sent_datagrams(void) { return _sent_datagrams; }
+        uint32_t get_sent_records(void) { return _sent_records; }
+
+    private:
+
+        NBIoT_BC95 * _bc95;
+        const char * _remote_host;
+        uint16_t _remote_port;
+        uint8_t _socket;
+
+        /* datagram being assembled */
+        uint8_t _buffer[BC95_BATCH_BUFFER_SIZE];
+        uint16_t _size = 0;
+        uint16_t _records = 0;
+        uint16_t _first_id = 0;     // records of a datagram have consecutive identifiers
+        uint16_t _next_id = 0;
+        uint32_t _oldest = 0;
+
+        uint16_t _max_size = BC95_BATCH_BUFFER_SIZE;
+        uint32_t _max_age = BC95_BATCH_MAX_AGE;
+        bc95_release_t _release = BC95_RELEASE_AFTER_UPLINK;
+
+        uint32_t _sent_datagrams = 0;
+        uint32_t _sent_records = 0;
+
+        bc95_record_callback_t _callback = NULL;
+        void *_callback_ctx = NULL;
+
+        uint8_t _flush(const bc95_release_t release);
+};
+
+
+#endif // __NBIoT_BC95_BATCH_H__
@@ -0,0 +1,547 @@
+#include <NBIoT_BC95_CoAP.h>
+
+uint8_t NBIoT_BC95_CoAP::begin_request(
+        const bc95_coap_method_t method,
+        const char *path,
+        const uint8_t *payload,
+        const uint16_t payload_size,
+        const uint16_t content_format,
+        const bc95_coap_type_t type)
+{
+    if (_status == BC95_OP_PENDING || path == NULL || (payload == NULL && payload_size > 0) ||
+        (type != BC95_COAP_CON && type != BC95_COAP_NON))
+    {
+        return 0;
+    }
+
+    if (_random_state == 0) {
+        // seeded on first use, when the time since boot has had a chance to vary
+        _random_state = (uint32_t)micros() ^ (_bc95->get_millis() << 12);
+        if (_random_state == 0) {
+            _random_state = 1;
+        }
+        _message_id = (uint16_t)_random();
+    }
+
+    _method = method;
+    _type = type;
+    _path = path;
+    _payload = payload;
+    _payload_size = payload_size;
+    _content_format = content_format;
+    _response_code = BC95_COAP_EMPTY;
+    _block1_szx = _szx;
+    _block1_offset = 0;
+    _block2_szx = _szx;
+    _block2_offset = 0;
+
+    _next_message();
+    if (_encode() == 0) {
+        // the path and query do not fit in the buffer
+        return 0;
+    }
+
+    _status = BC95_OP_PENDING;
+    _transmit();
+
+    return 1;
+}
+
+bc95_op_status_t NBIoT_BC95_CoAP::poll(void) {
+    uint8_t socket = _socket_handle();
+    uint32_t now;
+
+    if (_status != BC95_OP_PENDING) {
+        return _status;
+    }
+
+    // +NSONMI reports, read by any earlier command or right here, tell whether there is anything to read
+    _bc95->process_urcs();
+    if (_bc95->get_pending_bytes(socket) > 0) {
+        _bc95->receive_UDP_datagrams(socket, _on_datagram, _buffer, sizeof(_buffer), this);
+    }
+
+    if (_status != BC95_OP_PENDING) {
+        return _status;
+    }
+
+    now = _bc95->get_millis();
+    if (_stage == STAGE_SEND) {
+        // next block of a transfer
+        _transmit();
+    } else if (now - _sent_at >= _timeout) {
+        if (_stage == STAGE_ACK && _transmissions <= BC95_COAP_MAX_RETRANSMIT) {
+            _transmit();
+        } else {
+            _finish(BC95_OP_FAILED);
+        }
+    }
+
+    return _status;
+}
+
+bc95_op_status_t NBIoT_BC95_CoAP::request(
+        const bc95_coap_method_t method,
+        const char *path,
+        const uint8_t *payload,
+        const uint16_t payload_size,
+        const uint16_t content_format,
+        const bc95_coap_type_t type)
+{
+    if (!begin_request(method, path, payload, payload_size, content_format, type)) {
+        return BC95_OP_FAILED;
+    }
+
+    while (poll() == BC95_OP_PENDING) {
+        _bc95->wait_for_downlink(_socket_handle(), _time_left());
+    }
+
+    return _status;
+}
+
+void NBIoT_BC95_CoAP::set_block_size(const uint16_t block_size) {
+    uint8_t szx = 0;
+
+    while (szx < BC95_COAP_BLOCK_SZX && (16U << szx) < block_size) {
+        szx++;
+    }
+    _szx = szx;
+}
+
+uint8_t NBIoT_BC95_CoAP::_socket_handle(void) {
+    return (_socket == BC95_INVALID_SOCKET) ? _bc95->get_default_socket() : _socket;
+}
+
+uint32_t NBIoT_BC95_CoAP::_time_left(void) {
+    uint32_t elapsed = _bc95->get_millis() - _sent_at;
+
+    // until the next retransmission, or the response is given up
+    return (_stage == STAGE_SEND || elapsed >= _timeout) ? 0 : _timeout - elapsed;
+}
+
+uint32_t NBIoT_BC95_CoAP::_random(void) {
+    // xorshift32: unpredictable enough for message ids and tokens against off-path guessing, not cryptographic
+    _random_state ^= _random_state << 13;
+    _random_state ^= _random_state >> 17;
+    _random_state ^= _random_state << 5;
+
+    return _random_state;
+}
+
+void NBIoT_BC95_CoAP::_next_message(void) {
+    uint32_t token = _random();
+
+    // every block is an exchange of its own, a late response to the one before cannot match it
+    _message_id++;
+    for (uint8_t i = 0; i < BC95_COAP_TOKEN_SIZE; i++) {
+        _token[i] = (uint8_t)(token >> (8 * (i % 4)));
+    }
+    _transmissions = 0;
+    _stage = STAGE_SEND;
+}
+
+uint16_t NBIoT_BC95_CoAP::_encode(void) {
+    bc95_coap_writer_t w = { 0, 0, 0 };
+    const char *query = strchr(_path, '?');
+    const char *path_end = (query != NULL) ? query : _path + strlen(_path);
+    uint16_t block_size = 16U << _block1_szx;
+    uint8_t header[BC95_COAP_HEADER_SIZE];
+    uint8_t block1 = 0, more = 0;
+    const uint8_t *payload = _payload;
+    uint16_t payload_size = _payload_size;
+
+    if (_block2_offset > 0) {
+        // asking for the rest of the response: no request payload any more
+        payload_size = 0;
+    } else if (_payload_size > (16U << _szx)) {
+        block1 = 1;
+        payload = _payload + _block1_offset;
+        payload_size = _payload_size - _block1_offset;
+        more = payload_size > block_size;
+        if (more) {
+            payload_size = block_size;
+        }
+    }
+
+    header[0] = (BC95_COAP_VERSION << 6) | (_type << 4) | BC95_COAP_TOKEN_SIZE;
+    header[1] = _method;
+    header[2] = (uint8_t)(_message_id >> 8);
+    header[3] = (uint8_t)_message_id;
+    _put(&w, header, sizeof(header));
+    _put(&w, _token, BC95_COAP_TOKEN_SIZE);
+
+    // options in ascending number order, deltas from the one before
+    _put_path_options(&w, BC95_COAP_OPTION_URI_PATH, _path, path_end, '/');
+    if (payload_size > 0 && _content_format != BC95_COAP_FORMAT_NONE) {
+        _put_uint_option(&w, BC95_COAP_OPTION_CONTENT_FORMAT, _content_format);
+    }
+    if (query != NULL) {
+        _put_path_options(&w, BC95_COAP_OPTION_URI_QUERY, query + 1, query + strlen(query), '&');
+    }
+    if (!more) {
+        // the block wanted, the block size the client suggests on the first request
+        _put_uint_option(&w, BC95_COAP_OPTION_BLOCK2, ((_block2_offset >> (_block2_szx + 4)) << 4) | _block2_szx);
+    }
+    if (block1) {
+        _put_uint_option(&w, BC95_COAP_OPTION_BLOCK1,
+                         ((uint32_t)(_block1_offset >> (_block1_szx + 4)) << 4) | (more << 3) | _block1_szx);
+        _put_uint_option(&w, BC95_COAP_OPTION_SIZE1, _payload_size);
+    }
+
+    if (payload_size > 0) {
+        header[0] = BC95_COAP_PAYLOAD_MARKER;
+        _put(&w, header, 1);
+        _put(&w, payload, payload_size);
+    }
+
+    return w.overflow ? 0 : w.size;
+}
+
+void NBIoT_BC95_CoAP::_put(bc95_coap_writer_t *w, const uint8_t *data, const uint16_t size) {
+    if (w->overflow || size > sizeof(_buffer) - w->size) {
+        w->overflow = 1;
+        return;
+    }
+
+    memcpy(&_buffer[w->size], data, size);
+    w->size += size;
+}
+
+void NBIoT_BC95_CoAP::_put_option(bc95_coap_writer_t *w, const uint16_t number, const uint8_t *value, const uint16_t size) {
+    uint8_t header[5];
+    uint8_t len = 1;
+    uint16_t fields[2] = { (uint16_t)(number - w->last), size };
+
+    header[0] = 0;
+    // option delta and length: 0-12 in the nibble, 13 + one extended byte, 14 + two extended bytes
+    for (uint8_t i = 0; i < 2; i++) {
+        uint8_t nibble;
+
+        if (fields[i] < 13) {
+            nibble = fields[i];
+        } else if (fields[i] < 269) {
+            nibble = 13;
+            header[len++] = fields[i] - 13;
+        } else {
+            nibble = 14;
+            header[len++] = (uint8_t)((fields[i] - 269) >> 8);
+            header[len++] = (uint8_t)(fields[i] - 269);
+        }
+        header[0] |= (i == 0) ? (nibble << 4) : nibble;
+    }
+
+    _put(w, header, len);
+    _put(w, value, size);
+    w->last = number;
+}
+
+void NBIoT_BC95_CoAP::_put_uint_option(bc95_coap_writer_t *w, const uint16_t number, const uint32_t value) {
+    uint8_t bytes[4];
+    uint8_t size = 0;
+
+    // big endian without leading zero bytes, zero is empty
+    for (int8_t shift = 24; shift >= 0; shift -= 8) {
+        if (size > 0 || (value >> shift) != 0) {
+            bytes[size++] = (uint8_t)(value >> shift);
+        }
+    }
+
+    _put_option(w, number, bytes, size);
+}
+
+void NBIoT_BC95_CoAP::_put_path_options(
+        bc95_coap_writer_t *w,
+        const uint16_t number,
+        const char *start,
+        const char *end,
+        const char separator)
+{
+    while (start < end) {
+        const char *segment_end = start;
+
+        while (segment_end < end && *segment_end != separator) {
+            segment_end++;
+        }
+        // "/a//b/" is a/b, the leading and doubled separators add no empty segment
+        if (segment_end > start) {
+            _put_option(w, number, (const uint8_t *)start, segment_end - start);
+        }
+        start = segment_end + 1;
+    }
+}
+
+uint8_t NBIoT_BC95_CoAP::_transmit(void) {
+    uint16_t size = _encode();
+    uint16_t sent;
+
+    if (size == 0) {
+        _finish(BC95_OP_FAILED);
+        return 0;
+    }
+
+    // the response comes later as a downlink, poll() reads it
+    sent = _bc95->send_UDP_datagram(_socket_handle(), _remote_host, _remote_port, _buffer, size, NULL, 0);
+
+    if (_transmissions == 0) {
+        _timeout = (_type == BC95_COAP_CON) ?
+            BC95_COAP_ACK_TIMEOUT + _random() % (BC95_COAP_ACK_TIMEOUT / 2) : BC95_COAP_RESPONSE_TIMEOUT;
+    } else {
+        _timeout <<= 1;
+        _retransmissions++;
+    }
+    if (sent == size) {
+        _sent_messages++;
+    }
+
+    _transmissions++;
+    _sent_at = _bc95->get_millis();
+    _stage = (_type == BC95_COAP_CON) ? STAGE_ACK : STAGE_RESPONSE;
+
+    return sent == size;
+}
+
+void NBIoT_BC95_CoAP::_send_empty(const bc95_coap_type_t type, const uint16_t message_id) {
+    uint8_t message[BC95_COAP_HEADER_SIZE];
+
+    message[0] = (BC95_COAP_VERSION << 6) | (type << 4);
+    message[1] = BC95_COAP_EMPTY;
+    message[2] = (uint8_t)(message_id >> 8);
+    message[3] = (uint8_t)message_id;
+
+    _bc95->send_UDP_datagram(_socket_handle(), _remote_host, _remote_port, message, sizeof(message), NULL, 0);
+}
+
+uint8_t NBIoT_BC95_CoAP::_seen_before(const uint16_t message_id) {
+    for (uint8_t i = 0; i < _seen_count; i++) {
+        if (_seen[i] == message_id) {
+            return 1;
+        }
+    }
+
+    // the oldest id makes room
+    _seen[_seen_next] = message_id;
+    _seen_next = (_seen_next + 1) % BC95_COAP_DEDUP_SIZE;
+    if (_seen_count < BC95_COAP_DEDUP_SIZE) {
+        _seen_count++;
+    }
+
+    return 0;
+}
+
+void NBIoT_BC95_CoAP::_on_message(const uint8_t *message, const uint16_t size) {
+    bc95_coap_message_t m;
+    uint8_t confirmable, matches;
+
+    if (!_parse(message, size, &m)) {
+        // a malformed confirmable message is rejected, anything else unreadable is dropped
+        if (size >= BC95_COAP_HEADER_SIZE && (message[0] >> 6) == BC95_COAP_VERSION &&
+            ((message[0] >> 4) & 0x03) == BC95_COAP_CON)
+        {
+            _send_empty(BC95_COAP_RST, ((uint16_t)message[2] << 8) | message[3]);
+        }
+        return;
+    }
+
+    confirmable = (m.type == BC95_COAP_CON);
+    matches = _status == BC95_OP_PENDING && m.token_size == BC95_COAP_TOKEN_SIZE &&
+              memcmp(m.token, _token, BC95_COAP_TOKEN_SIZE) == 0;
+
+    if (m.type == BC95_COAP_ACK || m.type == BC95_COAP_RST) {
+        // only the message in flight is acknowledged, anything else is a late duplicate
+        if (_status != BC95_OP_PENDING || _stage != STAGE_ACK || m.message_id != _message_id) {
+            return;
+        }
+
+        if (m.type == BC95_COAP_RST) {
+            _finish(BC95_OP_FAILED);
+        } else if (m.code == BC95_COAP_EMPTY) {
+            // the response follows separately
+            _stage = STAGE_RESPONSE;
+            _sent_at = _bc95->get_millis();
+            _timeout = BC95_COAP_RESPONSE_TIMEOUT;
+        } else if (matches && !m.unknown_critical) {
+            _on_response(&m);
+        }
+        return;
+    }
+
+    // this client serves nothing: requests and pings are reset
+    if (BC95_COAP_CODE_CLASS(m.code) == 0) {
+        if (confirmable) {
+            _send_empty(BC95_COAP_RST, m.message_id);
+        }
+        return;
+    }
+
+    if (_seen_before(m.message_id)) {
+        // our ACK got lost, the response was handed over already
+        _duplicates++;
+        if (confirmable) {
+            _send_empty(BC95_COAP_ACK, m.message_id);
+        }
+        return;
+    }
+
+    if (!matches || m.unknown_critical) {
+        if (confirmable) {
+            _send_empty(BC95_COAP_RST, m.message_id);
+        }
+        return;
+    }
+
+    if (confirmable) {
+        _send_empty(BC95_COAP_ACK, m.message_id);
+    }
+    _on_response(&m);
+}
+
+void NBIoT_BC95_CoAP::_on_response(const bc95_coap_message_t *message) {
+    bc95_coap_response_t response;
+    uint8_t szx = 0;
+
+    _response_code = message->code;
+
+    if (message->code == BC95_COAP_CONTINUE && message->has_block1 && _block2_offset == 0 &&
+        _payload_size > (16U << _szx))
+    {
+        // the server may ask for smaller blocks, never for larger ones
+        szx = message->block1 & 0x07;
+        if (szx > _block1_szx) {
+            szx = _block1_szx;
+        }
+        uint32_t next = ((message->block1 >> 4) + 1) << (szx + 4);
+
+        if (next >= _payload_size) {
+            _finish(BC95_OP_FAILED);
+            return;
+        }
+        _block1_szx = szx;
+        _block1_offset = (uint16_t)next;
+        _next_message();
+        return;
+    }
+
+    response.code = message->code;
+    response.content_format = message->content_format;
+    response.offset = 0;
+    response.more = 0;
+    response.payload = message->payload;
+    response.payload_size = message->payload_size;
+
+    if (message->has_block2) {
+        szx = message->block2 & 0x07;
+        response.offset = (message->block2 >> 4) << (szx + 4);
+        response.more = (message->block2 >> 3) & 0x01;
+
+        // a reserved size or another block than the one asked for
+        if (szx == 7 || response.offset != _block2_offset) {
+            _finish(BC95_OP_FAILED);
+            return;
+        }
+    }
+
+    if (_handler != NULL) {
+        _handler(&response, _handler_ctx);
+    }
+
+    if (response.more && _status == BC95_OP_PENDING) {
+        _block2_szx = szx;
+        _block2_offset = response.offset + (16U << szx);
+        _next_message();
+    } else {
+        _finish(BC95_OP_DONE);
+    }
+}
+
+void NBIoT_BC95_CoAP::_finish(const bc95_op_status_t status) {
+    _status = status;
+}
+
+uint8_t NBIoT_BC95_CoAP::_parse(const uint8_t *message, const uint16_t size, bc95_coap_message_t *out) {
+    const uint8_t *p = message + BC95_COAP_HEADER_SIZE;
+    const uint8_t *end = message + size;
+    uint16_t number = 0;
+
+    if (size < BC95_COAP_HEADER_SIZE || (message[0] >> 6) != BC95_COAP_VERSION || (message[0] & 0x0F) > 8) {
+        return 0;
+    }
+
+    out->type = (bc95_coap_type_t)((message[0] >> 4) & 0x03);
+    out->token_size = message[0] & 0x0F;
+    out->code = message[1];
+    out->message_id = ((uint16_t)message[2] << 8) | message[3];
+    out->token = p;
+    out->content_format = BC95_COAP_FORMAT_NONE;
+    out->has_block1 = 0;
+    out->has_block2 = 0;
+    out->unknown_critical = 0;
+    out->payload = NULL;
+    out->payload_size = 0;
+
+    p += out->token_size;
+    if (p > end || (out->code == BC95_COAP_EMPTY && size != BC95_COAP_HEADER_SIZE)) {
+        return 0;
+    }
+
+    // options up to the payload marker, each value read where it is
+    while (p < end && *p != BC95_COAP_PAYLOAD_MARKER) {
+        uint16_t fields[2] = { (uint16_t)(*p >> 4), (uint16_t)(*p & 0x0F) };
+        uint32_t value = 0;
+
+        p++;
+        for (uint8_t i = 0; i < 2; i++) {
+            if (fields[i] == 13) {
+                if (p + 1 > end) {
+                    return 0;
+                }
+                fields[i] = 13 + p[0];
+                p += 1;
+            } else if (fields[i] == 14) {
+                if (p + 2 > end) {
+                    return 0;
+                }
+                fields[i] = 269 + (((uint16_t)p[0] << 8) | p[1]);
+                p += 2;
+            } else if (fields[i] == 15) {
+                return 0;
+            }
+        }
+        if (fields[1] > end - p) {
+            return 0;
+        }
+
+        number += fields[0];
+        for (uint16_t i = 0; i < fields[1] && i < 4; i++) {
+            value = (value << 8) | p[i];
+        }
+
+        if (number == BC95_COAP_OPTION_CONTENT_FORMAT) {
+            out->content_format = (uint16_t)value;
+        } else if (number == BC95_COAP_OPTION_BLOCK2) {
+            out->block2 = value;
+            out->has_block2 = 1;
+        } else if (number == BC95_COAP_OPTION_BLOCK1) {
+            out->block1 = value;
+            out->has_block1 = 1;
+        } else if (number & 0x01) {
+            // an odd option number is critical: a response carrying one this client does not know is rejected
+            out->unknown_critical = 1;
+        }
+        p += fields[1];
+    }
+
+    if (p < end) {
+        // a marker with nothing after it is a format error
+        if (++p == end) {
+            return 0;
+        }
+        out->payload = p;
+        out->payload_size = end - p;
+    }
+
+    return 1;
+}
+
+void NBIoT_BC95_CoAP::_on_datagram(const uint8_t *payload, uint16_t payload_size, void *ctx) {
+    ((NBIoT_BC95_CoAP *)ctx)->_on_message(payload, payload_size);
+}
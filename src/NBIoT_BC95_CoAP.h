@@ -0,0 +1,296 @@
+#ifndef __NBIoT_BC95_COAP_H__
+#define __NBIoT_BC95_COAP_H__
+
+#include <NBIoT_BC95.h>
+
+/******* Defines *******/
+#define BC95_COAP_PORT                          (5683)
+#define BC95_COAP_VERSION                       (1)
+#define BC95_COAP_HEADER_SIZE                   (4)
+#define BC95_COAP_TOKEN_SIZE                    (4)
+#define BC95_COAP_PAYLOAD_MARKER                (0xFF)
+// Block size of Block1/Block2 transfers, a power of two from 16 to 1024
+#ifndef BC95_COAP_BLOCK_SIZE
+#define BC95_COAP_BLOCK_SIZE                    (128)
+#endif
+#define BC95_COAP_BLOCK_SZX                     ((BC95_COAP_BLOCK_SIZE >= 1024) ? 6 : (BC95_COAP_BLOCK_SIZE >= 512) ? 5 : \
+                                                 (BC95_COAP_BLOCK_SIZE >= 256) ? 4 : (BC95_COAP_BLOCK_SIZE >= 128) ? 3 : \
+                                                 (BC95_COAP_BLOCK_SIZE >= 64) ? 2 : (BC95_COAP_BLOCK_SIZE >= 32) ? 1 : 0)
+// Message buffer, a block plus header, token and options. Requests are encoded in it and responses read into it
+#ifndef BC95_COAP_BUFFER_SIZE
+#define BC95_COAP_BUFFER_SIZE                   (BC95_COAP_BLOCK_SIZE + 64)
+#endif
+// Message ids of received messages remembered to tell retransmissions apart
+#ifndef BC95_COAP_DEDUP_SIZE
+#define BC95_COAP_DEDUP_SIZE                    (4)
+#endif
+// Confirmable message transmission (RFC 7252 4.8), in ms: the first timeout is random between
+// ACK_TIMEOUT and 1.5 times that, doubled after every retransmission
+#ifndef BC95_COAP_ACK_TIMEOUT
+#define BC95_COAP_ACK_TIMEOUT                   (2000)
+#endif
+#define BC95_COAP_MAX_RETRANSMIT                (4)
+// Wait for a separate response, or for the response to a non-confirmable request
+#ifndef BC95_COAP_RESPONSE_TIMEOUT
+#define BC95_COAP_RESPONSE_TIMEOUT              (BC95_CONNECTION_TIMEOUT)
+#endif
+#if (BC95_COAP_BLOCK_SIZE & (BC95_COAP_BLOCK_SIZE - 1)) || BC95_COAP_BLOCK_SIZE < 16 || BC95_COAP_BLOCK_SIZE > 1024
+#error "BC95_COAP_BLOCK_SIZE must be a power of two from 16 to 1024"
+#endif
+#if BC95_COAP_BUFFER_SIZE > BC95_NSOST_MAX_PAYLOAD_SIZE
+#error "BC95_COAP_BUFFER_SIZE does not fit in a datagram"
+#endif
+
+// Response codes, class.detail as in RFC 7252 ("2.05" is BC95_COAP_CODE(2, 5))
+#define BC95_COAP_CODE(c, d)                    ((uint8_t)(((c) << 5) | (d)))
+#define BC95_COAP_CODE_CLASS(code)              ((code) >> 5)
+#define BC95_COAP_CODE_DETAIL(code)             ((code) & 0x1F)
+#define BC95_COAP_EMPTY                         (0)
+#define BC95_COAP_CONTINUE                      BC95_COAP_CODE(2, 31)
+
+// Option numbers
+#define BC95_COAP_OPTION_URI_PATH               (11)
+#define BC95_COAP_OPTION_CONTENT_FORMAT         (12)
+#define BC95_COAP_OPTION_URI_QUERY              (15)
+#define BC95_COAP_OPTION_BLOCK2                 (23)
+#define BC95_COAP_OPTION_BLOCK1                 (27)
+#define BC95_COAP_OPTION_SIZE1                  (60)
+
+// Content formats, BC95_COAP_FORMAT_NONE leaves the option out
+#define BC95_COAP_FORMAT_TEXT                   (0)
+#define BC95_COAP_FORMAT_OCTET_STREAM           (42)
+#define BC95_COAP_FORMAT_JSON                   (50)
+#define BC95_COAP_FORMAT_CBOR                   (60)
+#define BC95_COAP_FORMAT_NONE                   (0xFFFF)
+
+// Message types
+enum bc95_coap_type_t {
+    BC95_COAP_CON                                               = 0,  // confirmable, acknowledged and retransmitted
+    BC95_COAP_NON                                                  ,  // non-confirmable, sent once
+    BC95_COAP_ACK                                                  ,
+    BC95_COAP_RST
+};
+
+// Request methods
+enum bc95_coap_method_t {
+    BC95_COAP_GET                                               = 1,
+    BC95_COAP_POST                                                 ,
+    BC95_COAP_PUT                                                  ,
+    BC95_COAP_DELETE
+};
+
+// Response, or one block of it
+typedef struct {
+    uint8_t         code;               // e.g. BC95_COAP_CODE(2, 5)
+    uint16_t        content_format;     // BC95_COAP_FORMAT_NONE if the option is absent
+    uint32_t        offset;             // of payload in the whole representation
+    uint8_t         more;               // more blocks follow
+    const uint8_t * payload;
+    uint16_t        payload_size;
+} bc95_coap_response_t;
+
+/*
+ * Response handler, called with the final response of a request, once per block of a Block2
+ * transfer. Error responses (4.xx, 5.xx) are handed over too.
+ * @param  response        [IN] Response, the payload is only valid during the call
+ * @param  ctx             [IN] User context given to set_response_handler()
+ */
+typedef void (*bc95_coap_response_handler_t)(const bc95_coap_response_t *response, void *ctx);
+
+
+/*
+ * CoAP client (RFC 7252) layered on the UDP socket functions of NBIoT_BC95. One request is in
+ * progress at a time (NSTART 1). Confirmable messages are retransmitted until acknowledged, responses
+ * are matched by token, piggy-backed on the ACK or separate, and retransmitted responses are
+ * acknowledged again but handed over once. Payloads larger than BC95_COAP_BLOCK_SIZE go out as a
+ * Block1 transfer and large responses come in as a Block2 transfer (RFC 7959), so neither side of a
+ * firmware image or configuration pull needs a whole-message buffer.
+ *
+ * Messages are encoded straight into one BC95_COAP_BUFFER_SIZE buffer, options included, and encoded
+ * again for a retransmission: the path and the request payload are read where they are.
+ *
+ *     NBIoT_BC95_CoAP coap(&bc95, "192.0.2.10");
+ *     coap.set_response_handler(on_block);
+ *     coap.request(BC95_COAP_GET, "fw/image?v=3");
+ */
+class NBIoT_BC95_CoAP {
+
+    public:
+
+        /**
+         * Class constructor
+         * @param bc95          [IN] Initialized modem with an open socket receiving messages
+         * @param remote_host   [IN] Server IP address or hostname, must stay valid
+         * @param remote_port   [IN] Server port
+         * @param socket        [IN] Socket handle, the default socket if omitted
+         */
+        NBIoT_BC95_CoAP(
+            NBIoT_BC95 *bc95,
+            const char *remote_host,
+            const uint16_t remote_port = BC95_COAP_PORT,
+            const uint8_t socket = BC95_INVALID_SOCKET) :
+                _bc95(bc95), _remote_host(remote_host), _remote_port(remote_port), _socket(socket) { }
+
+        /*
+         * Start a request, carried on by poll().
+         * @param  method          [IN] Request method
+         * @param  path            [IN] Resource path with an optional query, e.g. "fw/image?v=3&part=2".
+         *                              Must stay valid until the request completes
+         * @param  payload         [IN] Request payload, must stay valid until the request completes
+         * @param  payload_size    [IN] Size of payload, sent as a Block1 transfer above BC95_COAP_BLOCK_SIZE
+         * @param  content_format  [IN] Content format of payload, BC95_COAP_FORMAT_NONE to leave it out
+         * @param  type            [IN] BC95_COAP_CON or BC95_COAP_NON
+         * @return                 0 on failure (request in progress, options too long), 1 on success
+         */
+        uint8_t begin_request(
+            const bc95_coap_method_t method,
+            const char *path,
+            const uint8_t *payload = NULL,
+            const uint16_t payload_size = 0,
+            const uint16_t content_format = BC95_COAP_FORMAT_NONE,
+            const bc95_coap_type_t type = BC95_COAP_CON);
+
+        /*
+         * Read responses and send what is due: retransmissions and the next block. Call it from loop()
+         * while a request is in progress.
+         * @return                 BC95_OP_PENDING while the request is in progress, BC95_OP_DONE once
+         *                         the final response is handled, BC95_OP_FAILED on timeout or reset
+         */
+        bc95_op_status_t poll(void);
+
+        /*
+         * Blocking request, begin_request() and poll() until it completes. In between it waits through
+         * NBIoT_BC95::wait_for_downlink() until a datagram arrives or the next retransmission is due.
+         * @return                 BC95_OP_DONE or BC95_OP_FAILED, see get_response_code()
+         */
+        bc95_op_status_t request(
+            const bc95_coap_method_t method,
+            const char *path,
+            const uint8_t *payload = NULL,
+            const uint16_t payload_size = 0,
+            const uint16_t content_format = BC95_COAP_FORMAT_NONE,
+            const bc95_coap_type_t type = BC95_COAP_CON);
+
+        /* Give up the request in progress, its late responses are reset */
+        void cancel(void) { _status = BC95_OP_IDLE; }
+
+        /*
+         * Set the function called with responses.
+         * @param  handler         [IN] Response handler, NULL to drop them
+         * @param  ctx             [IN] User context passed to the handler
+         */
+        void set_response_handler(bc95_coap_response_handler_t handler, void *ctx = NULL) { _handler = handler; _handler_ctx = ctx; }
+
+        /*
+         * Block size of transfers, smaller blocks for a server or a path that needs them.
+         * @param  block_size      [IN] Power of two from 16 to BC95_COAP_BLOCK_SIZE
+         */
+        void set_block_size(const uint16_t block_size);
+
+        /* Last request */
+        bc95_op_status_t get_status(void) { return _status; }
+        uint8_t get_response_code(void) { return _response_code; }
+
+        /* Totals since construction */
+        uint32_t get_sent_messages(void) { return _sent_messages; }
+        uint32_t get_retransmissions(void) { return _retransmissions; }
+        uint32_t get_duplicates(void) { return _duplicates; }
+
+    private:
+
+        NBIoT_BC95 * _bc95;
+        const char * _remote_host;
+        uint16_t _remote_port;
+        uint8_t _socket;
+
+        /* request in progress */
+        enum bc95_coap_stage_t {
+            STAGE_SEND      = 0,        // next message due, sent by poll()
+            STAGE_ACK          ,        // confirmable message waiting for its ACK
+            STAGE_RESPONSE              // waiting for a separate or non-confirmable response
+        };
+        bc95_op_status_t _status = BC95_OP_IDLE;
+        bc95_coap_stage_t _stage = STAGE_SEND;
+        bc95_coap_method_t _method = BC95_COAP_GET;
+        bc95_coap_type_t _type = BC95_COAP_CON;
+        const char * _path = NULL;
+        const uint8_t * _payload = NULL;
+        uint16_t _payload_size = 0;
+        uint16_t _content_format = BC95_COAP_FORMAT_NONE;
+        uint8_t _response_code = BC95_COAP_EMPTY;
+
+        /* message in flight */
+        uint16_t _message_id = 0;
+        uint8_t _token[BC95_COAP_TOKEN_SIZE] = {};
+        uint8_t _transmissions = 0;
+        uint32_t _sent_at = 0;
+        uint32_t _timeout = 0;
+
+        /* block transfers, the block size exponent is log2(size) - 4 */
+        uint8_t _szx = BC95_COAP_BLOCK_SZX;
+        uint8_t _block1_szx = 0;
+        uint16_t _block1_offset = 0;
+        uint8_t _block2_szx = 0;
+        uint32_t _block2_offset = 0;
+
+        /* message ids of received confirmable and non-confirmable messages */
+        uint16_t _seen[BC95_COAP_DEDUP_SIZE] = {};
+        uint8_t _seen_count = 0;
+        uint8_t _seen_next = 0;
+
+        uint32_t _random_state = 0;
+
+        uint32_t _sent_messages = 0;
+        uint32_t _retransmissions = 0;
+        uint32_t _duplicates = 0;
+
+        bc95_coap_response_handler_t _handler = NULL;
+        void *_handler_ctx = NULL;
+
+        uint8_t _buffer[BC95_COAP_BUFFER_SIZE];
+
+        /* option writer, appends to _buffer in ascending option number order */
+        typedef struct {
+            uint16_t size;
+            uint16_t last;
+            uint8_t  overflow;
+        } bc95_coap_writer_t;
+
+        /* fields of a received message, pointing into _buffer */
+        typedef struct {
+            bc95_coap_type_t type;
+            uint8_t          code;
+            uint16_t         message_id;
+            const uint8_t *  token;
+            uint8_t          token_size;
+            uint16_t         content_format;
+            uint32_t         block1;
+            uint32_t         block2;
+            uint8_t          has_block1;
+            uint8_t          has_block2;
+            uint8_t          unknown_critical;
+            const uint8_t *  payload;
+            uint16_t         payload_size;
+        } bc95_coap_message_t;
+
+        uint8_t _socket_handle(void);
+        uint32_t _time_left(void);
+        uint32_t _random(void);
+        void _next_message(void);
+        uint16_t _encode(void);
+        void _put(bc95_coap_writer_t *w, const uint8_t *data, const uint16_t size);
+        void _put_option(bc95_coap_writer_t *w, const uint16_t number, const uint8_t *value, const uint16_t size);
+        void _put_uint_option(bc95_coap_writer_t *w, const uint16_t number, const uint32_t value);
+        void _put_path_options(bc95_coap_writer_t *w, const uint16_t number, const char *start, const char *end, const char separator);
+        uint8_t _transmit(void);
+        void _send_empty(const bc95_coap_type_t type, const uint16_t message_id);
+        uint8_t _seen_before(const uint16_t message_id);
+        void _on_message(const uint8_t *message, const uint16_t size);
+        void _on_response(const bc95_coap_message_t *message);
+        void _finish(const bc95_op_status_t status);
+        static uint8_t _parse(const uint8_t *message, const uint16_t size, bc95_coap_message_t *out);
+        static void _on_datagram(const uint8_t *payload, uint16_t payload_size, void *ctx);
+};
+
+
+#endif // __NBIoT_BC95_COAP_H__
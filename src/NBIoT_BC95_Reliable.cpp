@@ -0,0 +1,211 @@
+#include <NBIoT_BC95_Reliable.h>
+
+uint8_t NBIoT_BC95_Reliable::send(const uint8_t *payload, const uint16_t payload_size, uint16_t *message_id) {
+    bc95_reliable_slot_t *slot = NULL;
+
+    if (payload_size > BC95_RELIABLE_MAX_PAYLOAD || !can_send()) {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < BC95_RELIABLE_WINDOW && slot == NULL; i++) {
+        if (_slots[i].state == SLOT_FREE) {
+            slot = &_slots[i];
+        }
+    }
+
+    slot->state = SLOT_IN_FLIGHT;
+    slot->transmissions = 0;
+    slot->id = _next_id++;
+    slot->datagram[0] = BC95_RELIABLE_DATA;
+    slot->datagram[1] = (uint8_t)slot->id;
+    memcpy(&slot->datagram[BC95_RELIABLE_DATA_HEADER_SIZE], payload, payload_size);
+    slot->size = BC95_RELIABLE_DATA_HEADER_SIZE + payload_size;
+    _in_flight++;
+
+    if (message_id != NULL) {
+        *message_id = slot->id;
+    }
+
+    // a datagram that did not even leave is sent again like a lost one
+    _transmit(slot);
+
+    return 1;
+}
+
+uint8_t NBIoT_BC95_Reliable::poll(void) {
+    uint8_t completed = _receive();
+    uint32_t now;
+
+    // reported before the retransmissions so that the callback can fill the window again
+    for (uint8_t i = 0; i < BC95_RELIABLE_WINDOW; i++) {
+        if (_slots[i].state == SLOT_ACKED) {
+            _complete(&_slots[i], BC95_OP_DONE);
+        }
+    }
+
+    now = _bc95->get_millis();
+    for (uint8_t i = 0; i < BC95_RELIABLE_WINDOW; i++) {
+        bc95_reliable_slot_t *slot = &_slots[i];
+
+        if (slot->state != SLOT_IN_FLIGHT || (int32_t)(now - slot->due) < 0) {
+            continue;
+        }
+
+        if (slot->transmissions >= BC95_RELIABLE_MAX_TRANSMISSIONS) {
+            _complete(slot, BC95_OP_FAILED);
+            completed++;
+        } else {
+            _transmit(slot);
+        }
+    }
+
+    return completed;
+}
+
+uint8_t NBIoT_BC95_Reliable::_receive(void) {
+    uint8_t socket = (_socket == BC95_INVALID_SOCKET) ? _bc95->get_default_socket() : _socket;
+    uint8_t acked = 0;
+
+    // +NSONMI reports, read by any earlier command or right here, tell whether there is anything to read
+    _bc95->process_urcs();
+    if (_bc95->get_pending_bytes(socket) > 0) {
+        _bc95->receive_UDP_datagrams(socket, _on_datagram, _rx, sizeof(_rx), this);
+    }
+
+    for (uint8_t i = 0; i < BC95_RELIABLE_WINDOW; i++) {
+        acked += (_slots[i].state == SLOT_ACKED);
+    }
+
+    return acked;
+}
+
+uint8_t NBIoT_BC95_Reliable::_oldest_seq(void) {
+    uint8_t next = (uint8_t)_next_id;
+    uint8_t oldest = next;
+
+    // the message sent longest ago is the one farthest behind the next sequence number
+    for (uint8_t i = 0; i < BC95_RELIABLE_WINDOW; i++) {
+        if (_slots[i].state != SLOT_FREE && (uint8_t)(next - _slots[i].datagram[1]) > (uint8_t)(next - oldest)) {
+            oldest = _slots[i].datagram[1];
+        }
+    }
+
+    return oldest;
+}
+
+uint8_t NBIoT_BC95_Reliable::_transmit(bc95_reliable_slot_t *slot) {
+    uint8_t socket = (_socket == BC95_INVALID_SOCKET) ? _bc95->get_default_socket() : _socket;
+    uint32_t rto = _rto;
+    uint16_t sent;
+
+    // the ack comes later as a downlink, poll() reads it
+    sent = _bc95->send_UDP_datagram(socket, _remote_host, _remote_port, slot->datagram, slot->size, NULL, 0);
+
+    if (slot->transmissions > 0) {
+        _retransmissions++;
+    }
+    if (sent == slot->size) {
+        _sent_datagrams++;
+    }
+
+    // exponential backoff per message
+    for (uint8_t i = 0; i < slot->transmissions && rto < BC95_RELIABLE_MAX_RTO; i++) {
+        rto <<= 1;
+    }
+    if (rto > BC95_RELIABLE_MAX_RTO) {
+        rto = BC95_RELIABLE_MAX_RTO;
+    }
+
+    slot->transmissions++;
+    slot->sent_at = _bc95->get_millis();
+    slot->due = slot->sent_at + rto;
+
+    return sent == slot->size;
+}
+
+void NBIoT_BC95_Reliable::_complete(bc95_reliable_slot_t *slot, const bc95_op_status_t status) {
+    slot->state = SLOT_FREE;
+    _in_flight--;
+
+    if (status == BC95_OP_DONE) {
+        _acknowledged++;
+    } else {
+        _failed++;
+    }
+
+    if (_callback != NULL) {
+        _callback(slot->id, status, _callback_ctx);
+    }
+}
+
+void NBIoT_BC95_Reliable::_on_ack(const uint8_t next, const uint8_t sack) {
+    uint32_t now = _bc95->get_millis();
+    uint32_t newest = 0;
+    uint8_t any = 0;
+
+    for (uint8_t i = 0; i < BC95_RELIABLE_WINDOW; i++) {
+        bc95_reliable_slot_t *slot = &_slots[i];
+        uint8_t seq = slot->datagram[1];
+        uint8_t behind = (uint8_t)(next - 1 - seq);
+        uint8_t ahead = (uint8_t)(seq - next - 1);
+
+        if (slot->state != SLOT_IN_FLIGHT) {
+            continue;
+        }
+
+        // an ack older than the window acknowledges nothing
+        if (behind < BC95_RELIABLE_MAX_WINDOW || (ahead < 8 && (sack & (1 << ahead)))) {
+            // Karn: the round trip of a message sent more than once is ambiguous
+            if (slot->transmissions == 1) {
+                _rtt_sample(now - slot->sent_at);
+            }
+            if (!any || (int32_t)(slot->sent_at - newest) > 0) {
+                newest = slot->sent_at;
+            }
+            any = 1;
+            slot->state = SLOT_ACKED;
+        }
+    }
+
+    // sent before a message that has arrived and still missing: lost, no need to wait for the timer
+    for (uint8_t i = 0; i < BC95_RELIABLE_WINDOW && any; i++) {
+        if (_slots[i].state == SLOT_IN_FLIGHT && (int32_t)(newest - _slots[i].sent_at) > 0) {
+            _slots[i].due = now;
+        }
+    }
+}
+
+void NBIoT_BC95_Reliable::_rtt_sample(const uint32_t rtt) {
+    uint32_t r = (rtt > 0) ? rtt : 1;
+    uint32_t delta;
+
+    if (_srtt == 0) {
+        _srtt = r;
+        _rttvar = r / 2;
+    } else {
+        delta = (_srtt > r) ? _srtt - r : r - _srtt;
+        _rttvar = (3 * _rttvar + delta) / 4;
+        _srtt = (7 * _srtt + r) / 8;
+    }
+
+    _rto = _srtt + 4 * _rttvar;
+    if (_rto < BC95_RELIABLE_MIN_RTO) {
+        _rto = BC95_RELIABLE_MIN_RTO;
+    } else if (_rto > BC95_RELIABLE_MAX_RTO) {
+        _rto = BC95_RELIABLE_MAX_RTO;
+    }
+}
+
+void NBIoT_BC95_Reliable::_on_datagram(const uint8_t *payload, uint16_t payload_size, void *ctx) {
+    NBIoT_BC95_Reliable *self = (NBIoT_BC95_Reliable *)ctx;
+
+    if (payload_size >= BC95_RELIABLE_ACK_HEADER_SIZE && payload[0] == BC95_RELIABLE_ACK) {
+        self->_on_ack(payload[1], payload[2]);
+        payload += BC95_RELIABLE_ACK_HEADER_SIZE;
+        payload_size -= BC95_RELIABLE_ACK_HEADER_SIZE;
+    }
+
+    if (payload_size > 0 && self->_downlink != NULL) {
+        self->_downlink(payload, payload_size, self->_downlink_ctx);
+    }
+}
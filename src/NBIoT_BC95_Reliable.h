@@ -0,0 +1,190 @@
+#ifndef __NBIoT_BC95_RELIABLE_H__
+#define __NBIoT_BC95_RELIABLE_H__
+
+#include <NBIoT_BC95.h>
+
+/******* Defines *******/
+/*
+ * Datagram format, one byte fields:
+ *   data     BC95_RELIABLE_DATA <seq> <payload>
+ *   ack      BC95_RELIABLE_ACK <next> <sack> [<payload>]
+ *     next   every seq before it has been received (cumulative acknowledgement)
+ *     sack   bit i set: seq next + 1 + i has been received too (selective acknowledgement)
+ * Sequence numbers count modulo 256. The receiver answers every data datagram with an ack, which may
+ * carry its own downlink payload. Data beyond next + 8 moves next up to 8 before it: the sender only
+ * goes that far once it has given up on the older messages.
+ */
+#define BC95_RELIABLE_DATA                      (0xD1)
+#define BC95_RELIABLE_ACK                       (0xA1)
+#define BC95_RELIABLE_DATA_HEADER_SIZE          (2)
+#define BC95_RELIABLE_ACK_HEADER_SIZE           (3)
+// Largest payload of a message, the datagram is this plus the header
+#ifndef BC95_RELIABLE_MAX_PAYLOAD
+#define BC95_RELIABLE_MAX_PAYLOAD               (64)
+#endif
+// Messages in flight, up to the 8 sequence numbers a sack covers plus the cumulative one
+#ifndef BC95_RELIABLE_WINDOW
+#define BC95_RELIABLE_WINDOW                    (4)
+#endif
+#define BC95_RELIABLE_MAX_WINDOW                (9)
+// Retransmission timer (RFC 6298), in ms. NB-IoT round trips take seconds, not milliseconds
+#define BC95_RELIABLE_INITIAL_RTO               (3000)
+#define BC95_RELIABLE_MIN_RTO                   (1000)
+#define BC95_RELIABLE_MAX_RTO                   (60000)
+// Transmissions of a message before it is reported as failed
+#define BC95_RELIABLE_MAX_TRANSMISSIONS         (5)
+#if BC95_RELIABLE_WINDOW > BC95_RELIABLE_MAX_WINDOW
+#error "BC95_RELIABLE_WINDOW must be at most BC95_RELIABLE_MAX_WINDOW"
+#endif
+#if BC95_RELIABLE_MAX_PAYLOAD + BC95_RELIABLE_DATA_HEADER_SIZE > BC95_NSOST_MAX_PAYLOAD_SIZE
+#error "BC95_RELIABLE_MAX_PAYLOAD does not fit in a datagram"
+#endif
+
+/*
+ * Message delivery callback, called once per message when the receiver has acknowledged it or when
+ * it has been sent BC95_RELIABLE_MAX_TRANSMISSIONS times without acknowledgement.
+ * @param  message_id      [IN] Identifier returned by NBIoT_BC95_Reliable::send()
+ * @param  status          [IN] BC95_OP_DONE (acknowledged) or BC95_OP_FAILED
+ * @param  ctx             [IN] User context given to set_delivery_callback()
+ */
+typedef void (*bc95_delivery_callback_t)(uint16_t message_id, bc95_op_status_t status, void *ctx);
+
+
+/*
+ * Acknowledged delivery layered on NBIoT_BC95::send_UDP_datagram(). Messages get a sequence
+ * number and stay queued until the receiver acknowledges them; up to a window of them is in
+ * flight at once, so one RRC connection carries several instead of one send/wait round trip each.
+ * Unacknowledged messages are sent again after the retransmission timeout, estimated from the
+ * measured round trips, or as soon as an acknowledgement of a later message shows them missing.
+ *
+ *     NBIoT_BC95_Reliable link(&bc95, "collector.example.com", 5000);
+ *     link.send(reading, sizeof(reading));
+ *     ...
+ *     link.poll();    // from loop()
+ */
+class NBIoT_BC95_Reliable {
+
+    public:
+
+        /**
+         * Class constructor
+         * @param bc95          [IN] Initialized modem with an open socket receiving messages
+         * @param remote_host   [IN] Remote host IP address or hostname, must stay valid
+         * @param remote_port   [IN] Remote host port
+         * @param socket        [IN] Socket handle, the default socket if omitted
+         */
+        NBIoT_BC95_Reliable(
+            NBIoT_BC95 *bc95,
+            const char *remote_host,
+            const uint16_t remote_port,
+            const uint8_t socket = BC95_INVALID_SOCKET) :
+                _bc95(bc95), _remote_host(remote_host), _remote_port(remote_port), _socket(socket) { }
+
+        /*
+         * Queue a message and send it right away. Fails while the window is full: call poll() until
+         * a message is acknowledged (or failed).
+         * @param  payload         [IN]  Message data
+         * @param  payload_size    [IN]  Size of message, up to BC95_RELIABLE_MAX_PAYLOAD
+         * @param  message_id      [OUT] Identifier reported to the delivery callback
+         * @return                 0 on failure (window full, message too long), 1 on success
+         */
+        uint8_t send(const uint8_t *payload, const uint16_t payload_size, uint16_t *message_id = NULL);
+
+        /*
+         * Read acknowledgements and send again what is due. Call it from loop(). Issues AT commands
+         * only when a downlink is pending or a retransmission is due.
+         * @return                 Messages acknowledged or failed by this call
+         */
+        uint8_t poll(void);
+
+        /*
+         * Set the function called with the delivery status of each message.
+         * @param  callback        [IN] Delivery callback, NULL to disable
+         * @param  ctx             [IN] User context passed to the callback
+         */
+        void set_delivery_callback(bc95_delivery_callback_t callback, void *ctx = NULL) { _callback = callback; _callback_ctx = ctx; }
+
+        /*
+         * Set the function called with downlink payloads: the data carried by acknowledgements and
+         * any other datagram received on the socket as it is.
+         * @param  handler         [IN] Downlink handler, NULL to drop them
+         * @param  ctx             [IN] User context passed to the handler
+         */
+        void set_downlink_handler(bc95_datagram_handler_t handler, void *ctx = NULL) { _downlink = handler; _downlink_ctx = ctx; }
+
+        /*
+         * Messages in flight at most, 1 for stop-and-wait.
+         * @param  window          [IN] 1 to BC95_RELIABLE_WINDOW
+         */
+        void set_window(const uint8_t window) { _window = (window < 1) ? 1 : (window > BC95_RELIABLE_WINDOW ? BC95_RELIABLE_WINDOW : window); }
+
+        /* Queue state */
+        uint8_t get_in_flight(void) { return _in_flight; }
+        uint8_t can_send(void) { return _in_flight < _window && (uint8_t)((uint8_t)_next_id - _oldest_seq()) < _window; }
+
+        /* Round trip estimate and retransmission timeout in ms */
+        uint32_t get_srtt(void) { return _srtt; }
+        uint32_t get_rto(void) { return _rto; }
+
+        /* Totals since construction */
+        uint32_t get_sent_datagrams(void) { return _sent_datagrams; }
+        uint32_t get_retransmissions(void) { return _retransmissions; }
+        uint32_t get_acknowledged(void) { return _acknowledged; }
+        uint32_t get_failed(void) { return _failed; }
+
+    private:
+
+        NBIoT_BC95 * _bc95;
+        const char * _remote_host;
+        uint16_t _remote_port;
+        uint8_t _socket;
+
+        /* message in flight, kept as the datagram to send again */
+        enum bc95_slot_state_t {
+            SLOT_FREE       = 0,
+            SLOT_IN_FLIGHT     ,
+            SLOT_ACKED                  // reported by poll() once the downlinks are read
+        };
+        struct bc95_reliable_slot_t {
+            bc95_slot_state_t   state;
+            uint8_t             transmissions;
+            uint16_t            id;
+            uint32_t            sent_at;        // last transmission
+            uint32_t            due;            // next transmission
+            uint16_t            size;
+            uint8_t             datagram[BC95_RELIABLE_DATA_HEADER_SIZE + BC95_RELIABLE_MAX_PAYLOAD];
+        };
+        bc95_reliable_slot_t _slots[BC95_RELIABLE_WINDOW] = {};
+        uint8_t _in_flight = 0;
+        uint8_t _window = BC95_RELIABLE_WINDOW;
+        uint16_t _next_id = 0;      // the sequence number is its low byte
+
+        /* RFC 6298 estimator, no sample yet while _srtt is 0 */
+        uint32_t _srtt = 0;
+        uint32_t _rttvar = 0;
+        uint32_t _rto = BC95_RELIABLE_INITIAL_RTO;
+
+        uint32_t _sent_datagrams = 0;
+        uint32_t _retransmissions = 0;
+        uint32_t _acknowledged = 0;
+        uint32_t _failed = 0;
+
+        bc95_delivery_callback_t _callback = NULL;
+        void *_callback_ctx = NULL;
+        bc95_datagram_handler_t _downlink = NULL;
+        void *_downlink_ctx = NULL;
+
+        /* receive buffer, an ack with its payload */
+        uint8_t _rx[BC95_RELIABLE_ACK_HEADER_SIZE + BC95_RELIABLE_MAX_PAYLOAD];
+
+        uint8_t _oldest_seq(void);
+        uint8_t _transmit(bc95_reliable_slot_t *slot);
+        void _complete(bc95_reliable_slot_t *slot, const bc95_op_status_t status);
+        uint8_t _receive(void);
+        void _on_ack(const uint8_t next, const uint8_t sack);
+        void _rtt_sample(const uint32_t rtt);
+        static void _on_datagram(const uint8_t *payload, uint16_t payload_size, void *ctx);
+};
+
+
+#endif // __NBIoT_BC95_RELIABLE_H__
@@ -0,0 +1,286 @@
+#include <NBIoT_BC95_Store.h>
+
+uint8_t NBIoT_BC95_Store::begin(void) {
+    uint32_t size = _storage->size();
+    uint32_t erase = _storage->erase_size();
+    uint32_t seq, newest = 0, oldest_pending = 0;
+    uint16_t newest_slot = 0, oldest_slot = 0, depth = 0;
+    uint32_t slots;
+
+    if (erase > 0) {
+        // whole erase blocks only, each holding whole slots
+        if (erase % BC95_STORE_SLOT_SIZE != 0) {
+            return 0;
+        }
+        slots = (size / erase) * (erase / BC95_STORE_SLOT_SIZE);
+        _slots_per_erase = erase / BC95_STORE_SLOT_SIZE;
+    } else {
+        slots = size / BC95_STORE_SLOT_SIZE;
+        _slots_per_erase = 0;
+    }
+    _slots = (slots < 0xFFFF) ? slots : 0xFFFF;
+    if (_slots < 2) {
+        _slots = 0;
+        return 0;
+    }
+
+    // the newest record is followed by the head, the oldest pending one is the tail
+    for (uint16_t s = 0; s < _slots; s++) {
+        if (!_read_slot(s, &seq)) {
+            continue;
+        }
+        if (seq > newest) {
+            newest = seq;
+            newest_slot = s;
+        }
+        if (_slot[0] == BC95_STORE_STATE_PENDING) {
+            depth++;
+            if (oldest_pending == 0 || seq < oldest_pending) {
+                oldest_pending = seq;
+                oldest_slot = s;
+            }
+        }
+    }
+
+    _next_seq = newest + 1;
+    _boot_seq = _next_seq;
+    _begun_at = _bc95->get_millis();
+    _head = (newest > 0) ? (newest_slot + 1) % _slots : 0;
+    _tail = (depth > 0) ? oldest_slot : _head;
+    _depth = depth;
+    _oldest_queued_at = _begun_at;
+    _failed = 0;
+
+    // flash: a write torn by a power cut left the slot after the newest record programmed, skip it
+    while (_slots_per_erase > 0 && _head % _slots_per_erase != 0) {
+        uint8_t blank = 1;
+
+        if (!_storage->read((uint32_t)_head * BC95_STORE_SLOT_SIZE, _slot, sizeof(_slot))) {
+            return 0;
+        }
+        for (uint16_t i = 0; i < sizeof(_slot) && blank; i++) {
+            blank = (_slot[i] == BC95_STORE_STATE_ERASED);
+        }
+        if (blank) {
+            break;
+        }
+        _head = (_head + 1) % _slots;
+    }
+
+    return 1;
+}
+
+uint8_t NBIoT_BC95_Store::send(const uint8_t *record, const uint16_t record_size) {
+    if (record_size > BC95_STORE_MAX_RECORD_SIZE || _slots == 0) {
+        return 0;
+    }
+
+    // straight out while nothing is waiting, stored behind the backlog otherwise to keep the order
+    if (_depth == 0) {
+        _datagram[0] = record_size;
+        memcpy(&_datagram[BC95_BATCH_RECORD_HEADER_SIZE], record, record_size);
+
+        if (_send(BC95_BATCH_RECORD_HEADER_SIZE + record_size, _release)) {
+            _sent_records++;
+            return 1;
+        }
+    }
+
+    return _append(record, record_size);
+}
+
+uint16_t NBIoT_BC95_Store::poll(void) {
+    if (_depth == 0 || (_failed && _bc95->get_millis() - _failed_at < _retry_interval)) {
+        return 0;
+    }
+
+    return flush();
+}
+
+uint16_t NBIoT_BC95_Store::flush(void) {
+    uint16_t sent = 0;
+    uint32_t seq;
+
+    while (_depth > 0) {
+        uint16_t size = 0, records = 0, slot = _tail;
+
+        // oldest first, as many as fit. Slots torn by a power cut are passed over
+        while (records < _depth) {
+            uint8_t length;
+
+            if (!_read_slot(slot, &seq) || _slot[0] != BC95_STORE_STATE_PENDING) {
+                slot = (slot + 1) % _slots;
+                if (slot == _head) {
+                    break;
+                }
+                continue;
+            }
+            length = _slot[1];
+            if (size + BC95_BATCH_RECORD_HEADER_SIZE + length > BC95_STORE_DATAGRAM_SIZE) {
+                break;
+            }
+            _datagram[size++] = length;
+            memcpy(&_datagram[size], &_slot[BC95_STORE_SLOT_HEADER_SIZE], length);
+            size += length;
+            records++;
+            slot = (slot + 1) % _slots;
+        }
+
+        if (records == 0) {
+            // unreadable now, it was written fine: the storage is failing
+            _drop_tail();
+            continue;
+        }
+
+        if (!_send(size, (records == _depth) ? _release : BC95_RELEASE_NONE)) {
+            break;
+        }
+        _replayed_datagrams++;
+
+        for (uint16_t i = 0; i < records; i++) {
+            uint8_t state = BC95_STORE_STATE_SENT;
+
+            _storage->write((uint32_t)_tail * BC95_STORE_SLOT_SIZE, &state, 1);
+            _advance_tail();
+        }
+        sent += records;
+    }
+
+    _sent_records += sent;
+    _replayed_records += sent;
+
+    return sent;
+}
+
+uint8_t NBIoT_BC95_Store::_read_slot(const uint16_t slot, uint32_t *seq) {
+    uint32_t address = (uint32_t)slot * BC95_STORE_SLOT_SIZE;
+    uint8_t length;
+    uint16_t crc;
+
+    if (!_storage->read(address, _slot, BC95_STORE_SLOT_HEADER_SIZE) ||
+        (_slot[0] != BC95_STORE_STATE_PENDING && _slot[0] != BC95_STORE_STATE_SENT) ||
+        _slot[1] > BC95_STORE_MAX_RECORD_SIZE)
+    {
+        return 0;
+    }
+    length = _slot[1];
+    if (length > 0 && !_storage->read(address + BC95_STORE_SLOT_HEADER_SIZE, &_slot[BC95_STORE_SLOT_HEADER_SIZE], length)) {
+        return 0;
+    }
+
+    crc = NBIoT_BC95::crc16(&_slot[1], 1);
+    crc = NBIoT_BC95::crc16(&_slot[4], BC95_STORE_SLOT_HEADER_SIZE - 4 + length, crc);
+    if (crc != (_slot[2] | ((uint16_t)_slot[3] << 8))) {
+        return 0;
+    }
+
+    *seq = _get_u32(&_slot[4]);
+
+    return *seq != 0;
+}
+
+uint8_t NBIoT_BC95_Store::_append(const uint8_t *record, const uint16_t record_size) {
+    uint32_t address = (uint32_t)_head * BC95_STORE_SLOT_SIZE;
+    uint32_t now = _bc95->get_millis();
+    uint8_t state;
+    uint16_t crc;
+
+    if (_slots_per_erase > 0 && _head % _slots_per_erase == 0) {
+        // the block ahead holds the oldest records
+        while (_depth > 0 && (uint16_t)(_tail - _head) < _slots_per_erase) {
+            _drop_tail();
+        }
+        if (!_storage->erase(address)) {
+            return 0;
+        }
+    } else if (_depth > 0 && _tail == _head) {
+        _drop_tail();
+    }
+
+    _slot[1] = record_size;
+    _put_u32(&_slot[4], _next_seq);
+    _put_u32(&_slot[8], now);
+    memcpy(&_slot[BC95_STORE_SLOT_HEADER_SIZE], record, record_size);
+    crc = NBIoT_BC95::crc16(&_slot[1], 1);
+    crc = NBIoT_BC95::crc16(&_slot[4], BC95_STORE_SLOT_HEADER_SIZE - 4 + record_size, crc);
+    _slot[2] = (uint8_t)crc;
+    _slot[3] = (uint8_t)(crc >> 8);
+
+    // the state goes in last. Without an erase the old record is retired first: torn halfway, the
+    // slot must not read as the old record pending again
+    state = BC95_STORE_STATE_SENT;
+    if ((_slots_per_erase == 0 && !_storage->write(address, &state, 1)) ||
+        !_storage->write(address + 1, &_slot[1], BC95_STORE_SLOT_HEADER_SIZE - 1 + record_size))
+    {
+        return 0;
+    }
+    state = BC95_STORE_STATE_PENDING;
+    if (!_storage->write(address, &state, 1)) {
+        return 0;
+    }
+
+    if (_depth == 0) {
+        _tail = _head;
+        _oldest_queued_at = now;
+    }
+    _head = (_head + 1) % _slots;
+    _depth++;
+    _next_seq++;
+    _stored_records++;
+
+    return 1;
+}
+
+void NBIoT_BC95_Store::_drop_tail(void) {
+    _dropped_records++;
+    _advance_tail();
+}
+
+void NBIoT_BC95_Store::_advance_tail(void) {
+    uint32_t seq;
+
+    _tail = (_tail + 1) % _slots;
+    _depth--;
+
+    // on to the next pending record, past slots torn by a power cut
+    while (_depth > 0 && !(_read_slot(_tail, &seq) && _slot[0] == BC95_STORE_STATE_PENDING)) {
+        _tail = (_tail + 1) % _slots;
+        if (_tail == _head) {
+            // pending records lost from the storage
+            _dropped_records += _depth;
+            _depth = 0;
+        }
+    }
+
+    if (_depth > 0) {
+        _oldest_queued_at = (seq < _boot_seq) ? _begun_at : _get_u32(&_slot[8]);
+    }
+}
+
+uint8_t NBIoT_BC95_Store::_send(const uint16_t size, const bc95_release_t release) {
+    uint16_t sent;
+
+    if (_socket == BC95_INVALID_SOCKET) {
+        sent = _bc95->send_UDP_datagram(_remote_host, _remote_port, _datagram, size, NULL, 0, release);
+    } else {
+        sent = _bc95->send_UDP_datagram(_socket, _remote_host, _remote_port, _datagram, size, NULL, 0, release);
+    }
+
+    _failed = (sent != size);
+    if (_failed) {
+        _failed_at = _bc95->get_millis();
+    }
+
+    return !_failed;
+}
+
+uint32_t NBIoT_BC95_Store::_get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void NBIoT_BC95_Store::_put_u32(uint8_t *p, const uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
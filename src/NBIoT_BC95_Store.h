@@ -0,0 +1,241 @@
+#ifndef __NBIoT_BC95_STORE_H__
+#define __NBIoT_BC95_STORE_H__
+
+#include <NBIoT_BC95.h>
+#include <NBIoT_BC95_Batch.h>
+
+/******* Defines *******/
+/*
+ * Storage layout: fixed size slots used as a ring, one record per slot
+ *   [state][length][crc16][seq][queued_at][payload]
+ *     state      BC95_STORE_STATE_PENDING until the record has been sent, then BC95_STORE_STATE_SENT
+ *     crc16      NBIoT_BC95::crc16() of length, seq, queued_at and payload
+ *     seq        counts up from 1 over all records ever stored, little endian like queued_at
+ *     queued_at  NBIoT_BC95::get_millis() when the record was stored
+ * Records are only ever appended. The one change in place is the state going from pending to sent,
+ * which only clears bits and so needs no flash erase. A record torn by a power cut fails its CRC.
+ */
+#ifndef BC95_STORE_SLOT_SIZE
+#define BC95_STORE_SLOT_SIZE                    (32)
+#endif
+#define BC95_STORE_SLOT_HEADER_SIZE             (12)
+#define BC95_STORE_MAX_RECORD_SIZE              (BC95_STORE_SLOT_SIZE - BC95_STORE_SLOT_HEADER_SIZE)
+#define BC95_STORE_STATE_ERASED                 (0xFF)
+#define BC95_STORE_STATE_PENDING                (0x5A)
+#define BC95_STORE_STATE_SENT                   (0x00)
+// Replay datagrams, records framed as by NBIoT_BC95_Batch: <length><record><length><record>...
+#ifndef BC95_STORE_DATAGRAM_SIZE
+#define BC95_STORE_DATAGRAM_SIZE                (BC95_MAX_PACKET_SIZE)
+#endif
+// Wait after a failed send before poll() tries again
+#define BC95_STORE_RETRY_INTERVAL               (30000)
+#if BC95_STORE_SLOT_SIZE <= BC95_STORE_SLOT_HEADER_SIZE || BC95_STORE_MAX_RECORD_SIZE > BC95_BATCH_MAX_RECORD_SIZE
+#error "BC95_STORE_SLOT_SIZE must leave room for a record of up to BC95_BATCH_MAX_RECORD_SIZE bytes"
+#endif
+#if BC95_STORE_DATAGRAM_SIZE < BC95_BATCH_RECORD_HEADER_SIZE + BC95_STORE_MAX_RECORD_SIZE || \
+    BC95_STORE_DATAGRAM_SIZE > BC95_NSOST_MAX_PAYLOAD_SIZE
+#error "BC95_STORE_DATAGRAM_SIZE must hold a record and fit in a datagram"
+#endif
+
+
+/*
+ * Block storage behind NBIoT_BC95_Store: EEPROM, flash or, on a host, a file.
+ * Flash reports its erase size; the store erases a block before writing its first slot and
+ * otherwise only programs erased bytes or clears bits.
+ */
+class NBIoT_BC95_Storage {
+
+    public:
+
+        virtual ~NBIoT_BC95_Storage() { }
+
+        /* Usable bytes, from address 0 */
+        virtual uint32_t size(void) = 0;
+
+        /*
+         * @param  address         [IN]  Start address
+         * @param  data            [OUT] Bytes read / [IN] Bytes to write
+         * @param  data_size       [IN]  Number of bytes
+         * @return                 0 on failure, 1 on success
+         */
+        virtual uint8_t read(const uint32_t address, uint8_t *data, const uint16_t data_size) = 0;
+        virtual uint8_t write(const uint32_t address, const uint8_t *data, const uint16_t data_size) = 0;
+
+        /* Bytes erased at once, aligned, 0 if bytes can be written over without an erase */
+        virtual uint32_t erase_size(void) { return 0; }
+        virtual uint8_t erase(const uint32_t /* address */) { return 1; }
+};
+
+#if defined(__AVR__)
+#include <EEPROM.h>
+
+/* AVR EEPROM, or part of it. Unchanged bytes are not written again */
+class NBIoT_BC95_EEPROM_Storage : public NBIoT_BC95_Storage {
+
+    public:
+
+        /**
+         * Class constructor
+         * @param offset        [IN] First EEPROM address used
+         * @param size          [IN] Bytes used, the rest of the EEPROM if 0
+         */
+        NBIoT_BC95_EEPROM_Storage(const uint16_t offset = 0, const uint16_t size = 0) : _offset(offset), _size(size) { }
+
+        uint32_t size(void) { return (_size > 0) ? _size : EEPROM.length() - _offset; }
+
+        uint8_t read(const uint32_t address, uint8_t *data, const uint16_t data_size) {
+            for (uint16_t i = 0; i < data_size; i++) {
+                data[i] = EEPROM.read(_offset + address + i);
+            }
+            return 1;
+        }
+
+        uint8_t write(const uint32_t address, const uint8_t *data, const uint16_t data_size) {
+            for (uint16_t i = 0; i < data_size; i++) {
+                EEPROM.update(_offset + address + i, data[i]);
+            }
+            return 1;
+        }
+
+    private:
+
+        uint16_t _offset;
+        uint16_t _size;
+};
+#endif
+
+
+/*
+ * Store-and-forward queue in front of NBIoT_BC95::send_UDP_datagram(). A record is sent right away
+ * while nothing is queued. If the send fails, for example because the modem is not registered or
+ * not attached, the record is stored in a ring log on the given storage instead. poll() sends the
+ * backlog once the link is back, as many records per datagram as fit, oldest first.
+ *
+ * The log survives resets: begin() recovers it. Records are marked sent once their datagram has been
+ * handed to the modem, so a reset in between sends them again (at least once delivery). When the
+ * storage is full the oldest record is dropped for the new one.
+ *
+ *     NBIoT_BC95_EEPROM_Storage eeprom;
+ *     NBIoT_BC95_Store store(&bc95, &eeprom, "collector.example.com", 5000);
+ *     store.begin();
+ *     store.send(reading, sizeof(reading));
+ *     ...
+ *     store.poll();   // from loop()
+ */
+class NBIoT_BC95_Store {
+
+    public:
+
+        /**
+         * Class constructor
+         * @param bc95          [IN] Initialized modem with an open socket
+         * @param storage       [IN] Storage holding the log, used by this store only
+         * @param remote_host   [IN] Remote host IP address or hostname, must stay valid
+         * @param remote_port   [IN] Remote host port
+         * @param socket        [IN] Socket handle, the default socket if omitted
+         */
+        NBIoT_BC95_Store(
+            NBIoT_BC95 *bc95,
+            NBIoT_BC95_Storage *storage,
+            const char *remote_host,
+            const uint16_t remote_port,
+            const uint8_t socket = BC95_INVALID_SOCKET) :
+                _bc95(bc95), _storage(storage), _remote_host(remote_host), _remote_port(remote_port), _socket(socket) { }
+
+        /*
+         * Recover the log from storage: records still pending are sent by poll(). Storage holding no log
+         * (blank or other data) starts empty.
+         * @return                 0 on failure (storage unreadable or smaller than two slots), 1 on success
+         */
+        uint8_t begin(void);
+
+        /*
+         * Send a record, or store it if that fails or older records are still waiting.
+         * @param  record          [IN] Record data
+         * @param  record_size     [IN] Size of record, up to BC95_STORE_MAX_RECORD_SIZE
+         * @return                 0 on failure (record too long, storage write failed), 1 if sent or stored
+         */
+        uint8_t send(const uint8_t *record, const uint16_t record_size);
+
+        /*
+         * Send the backlog if the retry interval has passed since the last failed send.
+         * @return                 Records sent by this call
+         */
+        uint16_t poll(void);
+
+        /*
+         * Send the backlog now, for example once a +CEREG report shows the modem registered again.
+         * @return                 Records sent by this call
+         */
+        uint16_t flush(void);
+
+        /*
+         * Release assistance sent with the last datagram of a replay and with records sent right away.
+         * @param  release         [IN] BC95_RELEASE_AFTER_UPLINK (default), BC95_RELEASE_NONE to disable
+         */
+        void set_release(const bc95_release_t release) { _release = release; }
+
+        /*
+         * Wait after a failed send before poll() tries again.
+         * @param  interval        [IN] Retry interval in milliseconds
+         */
+        void set_retry_interval(const uint32_t interval) { _retry_interval = interval; }
+
+        /* Backlog: stored records not sent yet, and how long the oldest one has waited in ms.
+         * Records recovered by begin() count as stored when begin() ran */
+        uint16_t get_depth(void) { return _depth; }
+        uint32_t get_oldest_age(void) { return (_depth > 0) ? _bc95->get_millis() - _oldest_queued_at : 0; }
+        uint16_t get_capacity(void) { return _slots; }
+
+        /* Totals since construction */
+        uint32_t get_sent_records(void) { return _sent_records; }
+        uint32_t get_stored_records(void) { return _stored_records; }
+        uint32_t get_replayed_records(void) { return _replayed_records; }
+        uint32_t get_replayed_datagrams(void) { return _replayed_datagrams; }
+        uint32_t get_dropped_records(void) { return _dropped_records; }
+
+    private:
+
+        NBIoT_BC95 * _bc95;
+        NBIoT_BC95_Storage * _storage;
+        const char * _remote_host;
+        uint16_t _remote_port;
+        uint8_t _socket;
+
+        /* ring of slots, the backlog runs from _tail up to _head */
+        uint16_t _slots = 0;
+        uint16_t _slots_per_erase = 0;  // 0 without erase
+        uint16_t _head = 0;
+        uint16_t _tail = 0;
+        uint16_t _depth = 0;
+        uint32_t _next_seq = 1;
+        uint32_t _boot_seq = 1;         // records before it were stored before begin()
+        uint32_t _begun_at = 0;
+        uint32_t _oldest_queued_at = 0;
+
+        bc95_release_t _release = BC95_RELEASE_AFTER_UPLINK;
+        uint32_t _retry_interval = BC95_STORE_RETRY_INTERVAL;
+        uint32_t _failed_at = 0;
+        uint8_t _failed = 0;
+
+        uint32_t _sent_records = 0;
+        uint32_t _stored_records = 0;
+        uint32_t _replayed_records = 0;
+        uint32_t _replayed_datagrams = 0;
+        uint32_t _dropped_records = 0;
+
+        /* one slot, then the datagram being assembled */
+        uint8_t _slot[BC95_STORE_SLOT_SIZE];
+        uint8_t _datagram[BC95_STORE_DATAGRAM_SIZE];
+
+        uint8_t _read_slot(const uint16_t slot, uint32_t *seq);
+        uint8_t _append(const uint8_t *record, const uint16_t record_size);
+        void _drop_tail(void);
+        void _advance_tail(void);
+        uint8_t _send(const uint16_t size, const bc95_release_t release);
+        static uint32_t _get_u32(const uint8_t *p);
+        static void _put_u32(uint8_t *p, const uint32_t value);
+};
+
+
+#endif // __NBIoT_BC95_STORE_H__
@@ -0,0 +1,112 @@
+#include <NBIoT_BC95_Trace.h>
+
+int NBIoT_BC95_Trace::available(void) {
+    return _uart->available();
+}
+
+int NBIoT_BC95_Trace::read(void) {
+    int c = _uart->read();
+
+    if (c >= 0) {
+        uint8_t b = c;
+        _record(BC95_TRACE_FROM_MODEM, &b, 1);
+    }
+
+    return c;
+}
+
+int NBIoT_BC95_Trace::peek(void) {
+    return _uart->peek();
+}
+
+size_t NBIoT_BC95_Trace::write(uint8_t c) {
+    size_t written = _uart->write(c);
+
+    _record(BC95_TRACE_TO_MODEM, &c, written);
+
+    return written;
+}
+
+size_t NBIoT_BC95_Trace::write(const uint8_t *buffer, size_t size) {
+    size_t written = _uart->write(buffer, size);
+
+    _record(BC95_TRACE_TO_MODEM, buffer, written);
+
+    return written;
+}
+
+void NBIoT_BC95_Trace::flush(void) {
+    _uart->flush();
+
+    // the library flushes at the end of every command, the command becomes one record
+    if (_run_dir == BC95_TRACE_TO_MODEM) {
+        _write_record();
+    }
+}
+
+void NBIoT_BC95_Trace::sync(void) {
+    _write_record();
+    _trace->flush();
+}
+
+void NBIoT_BC95_Trace::_record(const uint8_t direction, const uint8_t *data, size_t size) {
+    uint32_t now = _millis();
+    size_t chunk;
+
+    if (!_enabled) {
+        return;
+    }
+
+    while (size > 0) {
+        if (_run_len > 0 &&
+           (direction != _run_dir || now - _run_last >= BC95_TRACE_RUN_GAP || _run_len == BC95_TRACE_MAX_RUN))
+        {
+            _write_record();
+        }
+        if (_run_len == 0) {
+            _run_dir = direction;
+            _run_time = now;
+        }
+
+        chunk = BC95_TRACE_MAX_RUN - _run_len;
+        if (chunk > size) {
+            chunk = size;
+        }
+        memcpy(&_run[_run_len], data, chunk);
+        _run_len += chunk;
+        _run_last = now;
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+void NBIoT_BC95_Trace::_write_record(void) {
+    uint32_t delta;
+    uint8_t b;
+
+    if (_run_len == 0) {
+        return;
+    }
+
+    if (!_started) {
+        _trace_size += _trace->write((const uint8_t *)BC95_TRACE_MAGIC, BC95_TRACE_MAGIC_LEN);
+        _trace_size += _trace->write((uint8_t)BC95_TRACE_VERSION);
+        _last_record = _run_time;
+        _started = 1;
+    }
+
+    _trace_size += _trace->write((uint8_t)(_run_dir | (_run_len - 1)));
+
+    // LEB128, 7 bits at a time, least significant first
+    delta = _run_time - _last_record;
+    do {
+        b = delta & 0x7F;
+        delta >>= 7;
+        _trace_size += _trace->write((uint8_t)(b | (delta ? 0x80 : 0x00)));
+    } while (delta);
+
+    _trace_size += _trace->write(_run, _run_len);
+
+    _last_record = _run_time;
+    _run_len = 0;
+}
@@ -0,0 +1,109 @@
+#ifndef __NBIoT_BC95_TRACE_H__
+#define __NBIoT_BC95_TRACE_H__
+
+#include <NBIoT_BC95.h>
+
+/******* Defines *******/
+/*
+ * Trace format, all multi-byte values little endian:
+ *   header   'B' 'C' '9' '5' 'T' <version>
+ *   record   <tag> <delta> <data>
+ *     tag    bit 7 direction (BC95_TRACE_TO_MODEM, BC95_TRACE_FROM_MODEM), bits 0..6 data length - 1
+ *     delta  milliseconds since the previous record, unsigned LEB128 (one byte below 128 ms)
+ *     data   1 to BC95_TRACE_MAX_RUN bytes as written to or read from the UART
+ */
+#define BC95_TRACE_MAGIC                        "BC95T"
+#define BC95_TRACE_MAGIC_LEN                    (5)
+#define BC95_TRACE_VERSION                      (1)
+#define BC95_TRACE_HEADER_LEN                   (BC95_TRACE_MAGIC_LEN + 1)
+#define BC95_TRACE_TO_MODEM                     (0x00)
+#define BC95_TRACE_FROM_MODEM                   (0x80)
+#define BC95_TRACE_LEN_MASK                     (0x7F)
+// Bytes of one direction less than BC95_TRACE_RUN_GAP ms apart share a record, up to 128 bytes
+#ifndef BC95_TRACE_MAX_RUN
+#define BC95_TRACE_MAX_RUN                      (32)
+#endif
+#define BC95_TRACE_RUN_GAP                      (5)
+#if BC95_TRACE_MAX_RUN > 128
+#error "BC95_TRACE_MAX_RUN must be at most 128"
+#endif
+
+
+/*
+ * UART session recorder. Wraps the Stream given to NBIoT_BC95 and writes every byte it passes in
+ * either direction, with its time, to a trace sink (SD card file, spare UART, ...):
+ *
+ *     NBIoT_BC95_Trace trace(&Serial1, &trace_file);
+ *     NBIoT_BC95 bc95(&trace);
+ *
+ * Received bytes are recorded when the library reads them, a record carries the time of its first
+ * byte. The extras/host replay harness feeds a trace back into the library.
+ */
+class NBIoT_BC95_Trace : public Stream {
+
+    public:
+
+        /**
+         * Class constructor
+         * @param uart          [IN] Modem UART
+         * @param trace         [IN] Trace sink, the header is written on first use
+         */
+        NBIoT_BC95_Trace(Stream *uart, Print *trace) : _uart(uart), _trace(trace) { }
+
+        /* Stream interface, forwarded to the UART */
+        int available(void);
+        int read(void);
+        int peek(void);
+        size_t write(uint8_t c);
+        size_t write(const uint8_t *buffer, size_t size);
+        void flush(void);
+
+        /*
+         * Write the bytes still held in the current record to the trace sink.
+         * Called before the sink is closed, records are otherwise completed as traffic goes on.
+         */
+        void sync(void);
+
+        /*
+         * Stop or resume recording. Traffic goes on untouched in between, the next record
+         * carries the time elapsed meanwhile.
+         * @param  enabled         [IN] 1 to record, 0 to pause
+         */
+        void set_enabled(const uint8_t enabled) { if (!enabled) sync(); _enabled = enabled; }
+
+        /*
+         * Clock of the record times. Give it the time source of the NBIoT_BC95 instance, see
+         * NBIoT_BC95::set_time_source(), so the trace follows the timeline the library sees.
+         * @param  millis_fn       [IN] Milliseconds since any origin, NULL for millis()
+         * @param  ctx             [IN] User context passed to it
+         */
+        void set_time_source(bc95_millis_t millis_fn, void *ctx = NULL) { _millis_fn = millis_fn; _time_ctx = ctx; }
+
+        /* Trace bytes written to the sink since construction */
+        uint32_t get_trace_size(void) { return _trace_size; }
+
+    private:
+
+        Stream * _uart;
+        Print * _trace;
+        uint8_t _enabled = 1;
+        uint8_t _started = 0;               // header written
+        uint32_t _trace_size = 0;
+        uint32_t _last_record = 0;          // time of the last record written
+        bc95_millis_t _millis_fn = NULL;
+        void *_time_ctx = NULL;
+
+        /* record being assembled */
+        uint8_t _run[BC95_TRACE_MAX_RUN];
+        uint8_t _run_len = 0;
+        uint8_t _run_dir = BC95_TRACE_TO_MODEM;
+        uint32_t _run_time = 0;             // first byte
+        uint32_t _run_last = 0;             // last byte
+
+        void _record(const uint8_t direction, const uint8_t *data, size_t size);
+        void _write_record(void);
+        uint32_t _millis(void) { return _millis_fn != NULL ? _millis_fn(_time_ctx) : millis(); }
+};
+
+
+#endif // __NBIoT_BC95_TRACE_H__